@@ -7,6 +7,9 @@ namespace ekstazi
 // User directory for storing Ekstazi files
 std::string const EKSTAZI_DIRNAME = ".ekstazi";
 
+// Name of the file with the user's symbol exclusion rules
+std::string const SYMBOL_RULES_FNAME = "symbol-rules.txt";
+
 // Name of the type hierarchy file
 std::string const TYPE_HIERARCHY_FNAME = "types.txt";
 
@@ -16,6 +19,21 @@ std::string const COUNT_FNAME = "count.ekstazi";
 // Name for the dependnency graph file
 std::string const DEPGRAPH_FNAME = "depgraph.txt";
 
+// Name for the binary image of the dependency graph
+std::string const DEPGRAPH_IMAGE_FNAME = "depgraph.bin";
+
+// Name for the dependency graph delta log
+std::string const DEPGRAPH_LOG_FNAME = "depgraph.log";
+
+// Name for the function-to-test index file
+std::string const TEST_INDEX_FNAME = "test-index.txt";
+
+// Name for the transitive test digests file
+std::string const TEST_DIGESTS_FNAME = "test-digests.txt";
+
+// Name for the dispatch summaries file
+std::string const DISPATCHERS_FNAME = "dispatchers.txt";
+
 // Name for the function checksums file
 std::string const FUNCTIONS_FNAME = "functions.txt";
 
@@ -25,6 +43,9 @@ std::string const CONSTRUCTORS_FNAME = "constructors.txt";
 // Name for modified functions file
 std::string const MODIFIED_FUNS_FNAME = "modified-functions.txt";
 
+// Name for the file of test functions selected through the test index or test digests
+std::string const SELECTED_TESTS_FNAME = "selected-tests.txt";
+
 // Name for the modified tests file
 std::string const TESTS_FNAME = "modified-tests.txt";
 
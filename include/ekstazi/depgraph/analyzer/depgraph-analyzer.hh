@@ -1,6 +1,7 @@
 #pragma once
 
 #include "ekstazi/depgraph/depgraph.hh"
+#include "ekstazi/depgraph/depgraph-union.hh"
 #include "ekstazi/depgraph/function.hh"
 
 #include <string>
@@ -19,7 +20,8 @@ public:
     void load();
 
     /**
-     * Get all of the functions that depend on a function.
+     * Get all of the functions that depend on a function in either the old or the new
+     * dependency graph. Without an old graph, these are the dependents in the new one.
      */
     std::unordered_set<std::string> get_dependents(std::string const & fun_name);
 
@@ -34,8 +36,13 @@ protected:
     ekstazi::DependencyGraph new_depgraph;
     ekstazi::DependencyGraph old_depgraph;
 
-    std::map<std::string, ekstazi::Function> new_functions;
-    std::map<std::string, ekstazi::Function> old_functions;
+    // Union view of both graphs, used to find dependents in a single traversal. Built on
+    // the first query and reused until the graphs are loaded again.
+    ekstazi::DepgraphUnion depgraph_union;
+    bool depgraph_union_built;
+
+    ekstazi::FunctionMap new_functions;
+    ekstazi::FunctionMap old_functions;
 };
 
 }
@@ -0,0 +1,140 @@
+#pragma once
+
+#include <vector>
+#include <unordered_map>
+#include <unordered_set>
+#include <cstdint>
+#include <cstddef>
+
+#include "ekstazi/depgraph/csr-graph.hh"
+#include "ekstazi/utils/symbol-table.hh"
+
+namespace ekstazi
+{
+
+/**
+ * Condensation of a dependency graph into its strongly connected components.
+ *
+ * Recursive and mutually recursive functions form cycles in the dependency graph.
+ * Collapsing every cycle into a single component leaves a DAG, so traversals never
+ * explore a cycle more than once, and per-component results (closures, distances,
+ * test sets) can be computed with one pass in topological order.
+ *
+ * Components are numbered in reverse topological order: every successor of a
+ * component has a smaller number than the component itself. Both the members of
+ * the components and the DAG edges are stored in CSR form.
+ *
+ * Closures of components that are queried repeatedly ("hot" components) are
+ * memoized, up to closure_capacity components in all closures together.
+ */
+class CondensedGraph
+{
+public:
+    /**
+     * Number of queries after which the closure of a component is memoized.
+     */
+    static uint32_t const hot_threshold;
+
+    /**
+     * Maximum number of components held by all memoized closures together. Closures are
+     * evicted to make room for new ones, so memory stays bounded on large graphs.
+     */
+    static size_t const closure_capacity;
+
+    CondensedGraph();
+
+    /**
+     * Condenses a frozen dependency graph.
+     */
+    explicit CondensedGraph(CsrGraph const & graph);
+
+    /**
+     * Returns the number of components.
+     */
+    uint32_t num_components() const;
+
+    /**
+     * Returns the component of a symbol, or CsrGraph::invalid_index if the symbol is not in the graph.
+     */
+    uint32_t component_of(symbol_id symbol) const;
+
+    /**
+     * Returns whether or not a component is a cycle, i.e. every member depends on every other member.
+     */
+    bool is_cyclic(uint32_t component) const;
+
+    /**
+     * Returns the offset of the first member of a component in the member array.
+     * The members of component c are members()[member_begin(c)] up to members()[member_begin(c + 1)].
+     */
+    uint32_t member_begin(uint32_t component) const;
+
+    /**
+     * Returns the members of all components.
+     */
+    std::vector<symbol_id> const & members() const;
+
+    /**
+     * Returns the offset of the first successor of a component in the successor array.
+     * The successors of component c are successors()[successor_begin(c)] up to
+     * successors()[successor_begin(c + 1)].
+     */
+    uint32_t successor_begin(uint32_t component) const;
+
+    /**
+     * Returns the successors (dependent components) of all components.
+     */
+    std::vector<uint32_t> const & successors() const;
+
+    /**
+     * Returns all components reachable from the given component, not including the
+     * component itself. The closure is memoized once the component is hot.
+     */
+    std::vector<uint32_t> get_closure(uint32_t component) const;
+
+    /**
+     * Finds the union of all dependents of the given start nodes and appends them to the
+     * given vector. Same results as CsrGraph::get_all_dependents.
+     */
+    void get_all_dependents(std::vector<symbol_id> const & start_nodes, std::vector<symbol_id> & dependents) const;
+
+    /**
+     * Finds all dependents for the given start node.
+     */
+    std::unordered_set<symbol_id> get_all_dependents(symbol_id start_node) const;
+
+    /**
+     * Finds the union of all dependents of the given start nodes.
+     */
+    std::unordered_set<symbol_id> get_all_dependents(std::vector<symbol_id> const & start_nodes) const;
+
+protected:
+    /**
+     * Appends the components reachable from the given components to the given vector,
+     * with a single traversal over the DAG.
+     */
+    void reachable_components(std::vector<uint32_t> const & start_components, std::vector<uint32_t> & reached) const;
+
+    // Symbol -> component. Symbol ids are dense, so this is a flat table.
+    std::vector<uint32_t> m_components;
+
+    // Members of every component
+    std::vector<uint32_t> m_member_offsets;
+    std::vector<symbol_id> m_members;
+
+    // Deduplicated DAG edges between components
+    std::vector<uint32_t> m_successor_offsets;
+    std::vector<uint32_t> m_successors;
+
+    // Memoized closures of hot components, the number of components they hold, and how
+    // often each component was queried
+    mutable std::unordered_map<uint32_t, std::vector<uint32_t>> m_closures;
+    mutable size_t m_num_memoized;
+    mutable std::vector<uint32_t> m_queries;
+
+    // Scratch space reused by every traversal
+    mutable std::vector<uint64_t> m_visited;
+    mutable std::vector<uint32_t> m_queue;
+};
+
+}
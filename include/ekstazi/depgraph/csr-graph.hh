@@ -0,0 +1,165 @@
+#pragma once
+
+#include <vector>
+#include <unordered_set>
+#include <cstdint>
+
+#include "ekstazi/utils/graph.hh"
+#include "ekstazi/utils/thread-pool.hh"
+#include "ekstazi/utils/symbol-table.hh"
+
+namespace ekstazi
+{
+
+/**
+ * Immutable compressed sparse row (CSR) representation of a dependency graph.
+ *
+ * The dependents of node i are stored in m_edges[m_offsets[i]] up to (but not
+ * including) m_edges[m_offsets[i + 1]]. Nodes are renumbered in breadth-first
+ * order starting from the roots of the graph, so that a node and its
+ * dependents end up close to each other in memory.
+ *
+ * Traversals use a flat visited bitmap and a queue that are kept between
+ * calls, so a search does not allocate once the graph has been built.
+ */
+class CsrGraph
+{
+public:
+    /**
+     * Index returned for symbols that are not part of the graph.
+     */
+    static uint32_t const invalid_index;
+
+    /**
+     * Minimum number of nodes for which traversals with a thread pool are worth it.
+     */
+    static uint32_t const parallel_threshold;
+
+    CsrGraph();
+
+    /**
+     * Builds the CSR graph from an adjacency list.
+     */
+    explicit CsrGraph(AdjacencyList const & adj_list);
+
+    /**
+     * Builds the CSR graph from arrays that are already in CSR form, e.g. from a
+     * saved image. symbols[i] is the symbol of node i.
+     */
+    CsrGraph(std::vector<symbol_id> symbols, std::vector<uint32_t> offsets, std::vector<uint32_t> edges);
+
+    /**
+     * Returns the number of nodes in the graph.
+     */
+    uint32_t num_nodes() const;
+
+    /**
+     * Returns the number of edges in the graph.
+     */
+    uint32_t num_edges() const;
+
+    /**
+     * Returns the node index of a symbol, or invalid_index if the symbol is not in the graph.
+     */
+    uint32_t index_of(symbol_id symbol) const;
+
+    /**
+     * Returns the symbol of a node index.
+     */
+    symbol_id symbol_of(uint32_t index) const;
+
+    /**
+     * Finds all dependents for the given start node and appends them to the given vector.
+     * The start node is only included if it depends on itself through a cycle.
+     */
+    void get_all_dependents(symbol_id start_node, std::vector<symbol_id> & dependents) const;
+
+    /**
+     * Finds all dependents for the given start node.
+     */
+    std::unordered_set<symbol_id> get_all_dependents(symbol_id start_node) const;
+
+    /**
+     * Finds the union of all dependents of the given start nodes with a single traversal
+     * and appends them to the given vector. A start node is only included if it depends
+     * on one of the start nodes.
+     */
+    void get_all_dependents(std::vector<symbol_id> const & start_nodes, std::vector<symbol_id> & dependents) const;
+
+    /**
+     * Finds the union of all dependents of the given start nodes with a single traversal.
+     */
+    std::unordered_set<symbol_id> get_all_dependents(std::vector<symbol_id> const & start_nodes) const;
+
+    /**
+     * Finds the union of all dependents of the given start nodes with a level-synchronous
+     * parallel traversal on the given pool, and appends them to the given vector in no
+     * particular order. Levels with a large frontier are expanded bottom-up.
+     */
+    void get_all_dependents(ThreadPool & pool, std::vector<symbol_id> const & start_nodes, std::vector<symbol_id> & dependents) const;
+
+    /**
+     * Computes the strongly connected components of the graph with Tarjan's algorithm.
+     * components[i] is set to the component of node i. Components are numbered in
+     * reverse topological order: every dependent of a component is either in the
+     * component itself or in a component with a smaller number.
+     *
+     * @return the number of components.
+     */
+    uint32_t strongly_connected_components(std::vector<uint32_t> & components) const;
+
+    /**
+     * Returns the offset of the first dependent of a node in the edge array.
+     * The dependents of node i are edges()[begin(i)] up to edges()[begin(i + 1)].
+     */
+    uint32_t begin(uint32_t index) const;
+
+    /**
+     * Returns the dependents of all nodes, as node indices.
+     */
+    std::vector<uint32_t> const & edges() const;
+
+    /**
+     * Returns the graph with all edges reversed. Nodes keep their indices.
+     */
+    CsrGraph transpose() const;
+
+protected:
+    /**
+     * Assigns node indices in breadth-first order from the roots of the graph.
+     */
+    void number_nodes(AdjacencyList const & adj_list);
+
+    // Offsets into m_edges for every node, with one extra entry at the end
+    std::vector<uint32_t> m_offsets;
+
+    // Dependents of every node, as node indices
+    std::vector<uint32_t> m_edges;
+
+    // Node index -> symbol
+    std::vector<symbol_id> m_symbols;
+
+    // Symbol -> node index. Symbol ids are dense, so this is a flat table.
+    std::vector<uint32_t> m_indices;
+
+    /**
+     * Builds the reverse edges used by bottom-up levels of parallel traversals.
+     */
+    void build_reverse_edges() const;
+
+    /**
+     * Expands one level bottom-up: every node that is not visited yet checks whether
+     * any node it depends on is in the frontier.
+     */
+    void expand_bottom_up(ThreadPool & pool, std::vector<uint32_t> const & frontier, std::vector<uint32_t> & next) const;
+
+    // Scratch space reused by every traversal
+    mutable std::vector<uint64_t> m_visited;
+    mutable std::vector<uint32_t> m_queue;
+
+    // Reverse edges in CSR form, only built for parallel traversals
+    mutable std::vector<uint32_t> m_reverse_offsets;
+    mutable std::vector<uint32_t> m_reverse_edges;
+};
+
+}
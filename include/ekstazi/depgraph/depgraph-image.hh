@@ -0,0 +1,53 @@
+#pragma once
+
+#include <string>
+#include <cstdint>
+
+#include "ekstazi/depgraph/csr-graph.hh"
+
+namespace ekstazi
+{
+
+/**
+ * Binary image format of a frozen dependency graph. The image holds the CSR arrays of
+ * the graph and of its reverse, so loading it is a bulk read of every section into the
+ * arrays of a CsrGraph: no text is parsed and nothing is inserted edge by edge.
+ *
+ * The image consists of a fixed header followed by 32-bit arrays and the string table,
+ * all in native byte order:
+ *
+ * header          magic "EKDG", version, number of nodes, number of edges, size of the string table
+ * offsets         CSR offsets into edges, one per node plus one
+ * edges           dependents of every node, as node indices
+ * reverse offsets CSR offsets into reverse edges, one per node plus one
+ * reverse edges   dependencies of every node, as node indices
+ * name offsets    offsets into the string table, one per node plus one
+ * names           the names of all nodes, back to back without terminators
+ */
+class DepgraphImage
+{
+public:
+    /**
+     * Version of the image format. Images with any other version are rejected.
+     */
+    static uint32_t const version;
+
+    /**
+     * Returns whether or not a file starts with the image magic.
+     */
+    static bool is_image(std::string const & fname);
+
+    /**
+     * Writes a frozen dependency graph to a file in the image format.
+     */
+    static bool write(CsrGraph const & graph, std::string const & fname);
+
+    /**
+     * Reads an image into a frozen dependency graph and its reverse, interning the node
+     * names. Returns false and leaves both graphs untouched if the file cannot be read or
+     * is not a valid image.
+     */
+    static bool read(std::string const & fname, CsrGraph & graph, CsrGraph & reverse_graph);
+};
+
+}
@@ -0,0 +1,100 @@
+#pragma once
+
+#include <string>
+#include <cstdint>
+
+#include "ekstazi/depgraph/depgraph.hh"
+
+namespace ekstazi
+{
+
+/**
+ * Append-only persistence for the dependency graph. Rather than writing the whole graph
+ * on every run, a run appends only the difference to the previous generation to a log,
+ * on top of a base snapshot in one of the regular dependency graph formats. The log is
+ * periodically compacted by writing a new snapshot. Compaction keeps the generation of
+ * the last run in the log, so the graphs of the last two runs can always be rebuilt.
+ *
+ * Every generation in the log starts with a header line, followed by its entries:
+ *
+ * generation;<number>
+ * !;<node>          the node and all of its dependencies were removed
+ * -;<src>;<dst>     the dependency was removed
+ * +;<src>;<dst>     the dependency was added
+ *
+ * Nodes are only added implicitly, through the dependencies they take part in.
+ */
+class DepgraphLog
+{
+public:
+    DepgraphLog();
+    DepgraphLog(std::string const & snapshot_fname, std::string const & log_fname);
+
+    /**
+     * Loads the base snapshot into the given graph and replays every generation of the log.
+     */
+    void load(DependencyGraph & depgraph);
+
+    /**
+     * Loads the graphs of the last two runs: the new graph replays every generation of the
+     * log, and the old graph every generation but the last. The old graph is left empty
+     * when the log has no generations.
+     */
+    void load(DependencyGraph & old_depgraph, DependencyGraph & new_depgraph);
+
+    /**
+     * Appends the difference between the old and the new graph to the log as a new
+     * generation. Both graphs are expected to be free of duplicate dependencies. Nothing
+     * is appended while there is no snapshot, since the log must be compacted first.
+     *
+     * @return the number of entries written.
+     */
+    uint32_t append(DependencyGraph const & old_depgraph, DependencyGraph const & new_depgraph);
+
+    /**
+     * Returns whether or not the log should be compacted: there is no snapshot yet, the
+     * log has reached the given number of generations, or it has more entries than the
+     * snapshot has dependencies.
+     */
+    bool should_compact(uint32_t max_generations) const;
+
+    /**
+     * Writes a new base snapshot and rewrites the log. If a generation was appended, the
+     * old graph becomes the snapshot and the log keeps only that generation; otherwise
+     * the new graph becomes the snapshot and the log is emptied.
+     */
+    void compact(DependencyGraph & old_depgraph, DependencyGraph & new_depgraph, bool binary);
+
+    /**
+     * Returns the number of generations in the log.
+     */
+    uint32_t num_generations() const;
+
+    /**
+     * Returns the number of entries in the log, over all generations.
+     */
+    uint32_t num_entries() const;
+
+protected:
+    /**
+     * Loads the base snapshot into the given graph and replays the given number of
+     * generations of the log.
+     */
+    void replay(DependencyGraph & depgraph, uint32_t num_generations);
+
+    std::string m_snapshot_fname;
+    std::string m_log_fname;
+
+    bool m_has_snapshot;
+    uint32_t m_snapshot_edges;
+
+    uint32_t m_generations;
+    uint32_t m_entries;
+
+    // Entries of the generation appended by this run, kept for compaction
+    bool m_appended;
+    std::string m_last_generation;
+    uint32_t m_last_entries;
+};
+
+}
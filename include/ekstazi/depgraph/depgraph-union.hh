@@ -0,0 +1,94 @@
+#pragma once
+
+#include <vector>
+#include <unordered_set>
+#include <cstdint>
+
+#include "ekstazi/depgraph/csr-graph.hh"
+#include "ekstazi/utils/symbol-table.hh"
+
+namespace ekstazi
+{
+
+/**
+ * Union view over the old and the new dependency graph, so the dependents in both
+ * generations are found with a single traversal.
+ *
+ * Both graphs are stored in CSR form over one shared node numbering. A traversal keeps a
+ * separate visited bit per graph and only follows the edges of the graph a node was
+ * reached in, so the result is exactly the union of traversing each graph on its own:
+ * paths that mix old and new edges, which exist in neither generation, are not followed.
+ */
+class DepgraphUnion
+{
+public:
+    DepgraphUnion();
+
+    /**
+     * Builds the union view of two frozen dependency graphs.
+     */
+    DepgraphUnion(CsrGraph const & old_graph, CsrGraph const & new_graph);
+
+    /**
+     * Sets the thread pool used to traverse large unions in parallel, or nullptr to always
+     * traverse on the calling thread. The pool is not owned by the view.
+     */
+    void set_thread_pool(ThreadPool * pool);
+
+    /**
+     * Returns the number of nodes in either graph.
+     */
+    uint32_t num_nodes() const;
+
+    /**
+     * Finds the union of all dependents of the given start nodes in both graphs and appends
+     * them to the given vector. Every dependent is appended once.
+     */
+    void get_all_dependents(std::vector<symbol_id> const & start_nodes, std::vector<symbol_id> & dependents) const;
+
+    /**
+     * Finds the union of all dependents of the given start nodes in both graphs.
+     */
+    std::unordered_set<symbol_id> get_all_dependents(std::vector<symbol_id> const & start_nodes) const;
+
+    /**
+     * Finds all dependents of the given start node in both graphs.
+     */
+    std::unordered_set<symbol_id> get_all_dependents(symbol_id start_node) const;
+
+protected:
+    /**
+     * Adds the edges of one graph, translated to the shared node numbering.
+     */
+    void add_graph(CsrGraph const & graph, std::vector<uint32_t> & offsets, std::vector<uint32_t> & edges);
+
+    /**
+     * Parallel version of get_all_dependents. Node i of the old graph is state i and node i
+     * of the new graph is state i + num_nodes(), so both graphs share one visited bitmap.
+     */
+    void get_all_dependents_parallel(std::vector<symbol_id> const & start_nodes, std::vector<symbol_id> & dependents) const;
+
+    // Shared node index -> symbol
+    std::vector<symbol_id> m_symbols;
+
+    // Symbol -> shared node index. Symbol ids are dense, so this is a flat table.
+    std::vector<uint32_t> m_indices;
+
+    // Edges of both graphs in CSR form over the shared numbering
+    std::vector<uint32_t> m_old_offsets;
+    std::vector<uint32_t> m_old_edges;
+    std::vector<uint32_t> m_new_offsets;
+    std::vector<uint32_t> m_new_edges;
+
+    // Scratch space reused by every traversal. Bit i of m_visited[0] and m_visited[1]
+    // marks node i as visited in the old and the new graph respectively. Queue entries
+    // hold the node index shifted left by one, with the graph in the lowest bit.
+    mutable std::vector<uint64_t> m_visited[2];
+    mutable std::vector<uint32_t> m_queue;
+
+    // Pool for parallel traversals, if any, and the visited bitmap over both graphs' states
+    ThreadPool * m_thread_pool;
+    mutable std::vector<uint64_t> m_parallel_visited;
+};
+
+}
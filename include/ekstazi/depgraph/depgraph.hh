@@ -3,7 +3,12 @@
 #include <string>
 #include <unordered_map>
 #include <unordered_set>
-#include <list>
+#include <vector>
+
+#include "ekstazi/depgraph/csr-graph.hh"
+#include "ekstazi/depgraph/condensed-graph.hh"
+#include "ekstazi/utils/graph.hh"
+#include "ekstazi/utils/symbol-table.hh"
 
 namespace ekstazi
 {
@@ -22,6 +27,9 @@ namespace ekstazi
  * A -> B
  * 
  * Function B calls function A, so A is depended on by B.
+ *
+ * Nodes are stored as ids interned in the process-wide SymbolTable, so
+ * the old and new graphs of a run share the same ids.
  */
 class DependencyGraph
 {
@@ -34,6 +42,32 @@ public:
      * until there are no more nodes.
      */
     std::unordered_set<std::string> get_all_dependents(std::string const & start_node);
+    std::unordered_set<symbol_id> get_all_dependents(symbol_id start_node);
+
+    /**
+     * Finds the union of all dependents of the given start nodes. The graph is
+     * traversed once with a shared visited set, rather than once per start node.
+     */
+    std::unordered_set<symbol_id> get_all_dependents(std::vector<symbol_id> const & start_nodes);
+
+    /**
+     * Sets the thread pool used to traverse large frozen graphs in parallel, or nullptr
+     * to always traverse on the calling thread. The pool is not owned by the graph.
+     */
+    void set_thread_pool(ThreadPool * pool);
+
+    /**
+     * Finds all dependencies of the given start node, i.e. every node it (transitively)
+     * depends on. The reverse adjacency is maintained alongside the forward adjacency, so
+     * this is a direct traversal rather than a traversal of a reversed copy.
+     */
+    std::unordered_set<std::string> get_all_dependencies(std::string const & start_node);
+    std::unordered_set<symbol_id> get_all_dependencies(symbol_id start_node);
+
+    /**
+     * Finds the union of all dependencies of the given start nodes with a single traversal.
+     */
+    std::unordered_set<symbol_id> get_all_dependencies(std::vector<symbol_id> const & start_nodes);
 
     /**
      * Adds a dependency relationship to the current graph. The relationship is that
@@ -41,31 +75,85 @@ public:
      * depends on the src function.
      */
     void add_dependency(std::string const & function_src, std::string const & function_dst);
+    void add_dependency(symbol_id function_src, symbol_id function_dst);
 
     /**
-     * Returns whether or not the dependency graph is empty.
+     * Removes a dependency relationship from the current graph.
      */
-    bool empty();
+    void remove_dependency(symbol_id function_src, symbol_id function_dst);
 
     /**
-     * Reverses a dependency graph and returns it (original remains unchanged).
+     * Removes the given nodes and every dependency from or to them, with a single pass
+     * over the graph.
      */
-    DependencyGraph reverse();
+    void remove_nodes(std::unordered_set<symbol_id> const & nodes);
+
+    /**
+     * Returns the adjacency list of the graph.
+     */
+    AdjacencyList const & get_adjacency_list() const;
+
+    /**
+     * Returns the reverse adjacency list of the graph, which maps every node to the nodes
+     * it depends on.
+     */
+    AdjacencyList const & get_reverse_adjacency_list() const;
+
+    /**
+     * Builds an immutable CSR copy of the graph that is used for all following
+     * traversals. Adding a dependency afterwards discards the frozen copy.
+     */
+    void freeze();
+
+    /**
+     * Returns whether or not the graph has been frozen.
+     */
+    bool is_frozen() const;
+
+    /**
+     * Returns the frozen CSR copy of the graph. Only valid once the graph is frozen.
+     */
+    CsrGraph const & get_frozen_graph() const;
+
+    /**
+     * Condenses the strongly connected components of the graph into a DAG, which is used
+     * for all following traversals so cycles are only explored once. Freezes the graph if
+     * it is not frozen yet. Adding a dependency afterwards discards the condensation.
+     */
+    void condense();
+
+    /**
+     * Returns whether or not the graph has been condensed.
+     */
+    bool is_condensed() const;
+
+    /**
+     * Returns the condensation of the graph. Only valid once the graph is condensed.
+     */
+    CondensedGraph const & get_condensed_graph() const;
+
+    /**
+     * Returns whether or not the dependency graph is empty.
+     */
+    bool empty();
 
     /**
-     * Removes duplicates from the dependency graph.
+     * Reverses a dependency graph and returns it (original remains unchanged). Both
+     * directions are maintained, so this only swaps them in the copy.
      */
-    void remove_duplicates();
+    DependencyGraph reverse();
 
     /**
-     * Returns whether or not a dependency relation exists.
+     * Returns whether or not a dependency relation exists. Constant time, since the
+     * adjacency sets of high fan-out nodes are hashed.
      */
     bool exists_dependency(std::string const & function_src, std::string const & function_dst);
+    bool exists_dependency(symbol_id function_src, symbol_id function_dst);
 
     /**
      * Loads the dependency graph from a file. The format of the file should be a list of
      * functions followed by their dependencies on each line, similar to the structure
-     * of an adjacency list.
+     * of an adjacency list. Binary images are detected and loaded with load_binary_file.
      */
     void load_file(std::string const & fname);
 
@@ -74,10 +162,52 @@ public:
      */
     void save_file(std::string const & fname);
 
+    /**
+     * Loads the dependency graph from a binary image (see DepgraphImage). The graph and
+     * its reverse are frozen with the CSR arrays read from the image, so no text is
+     * parsed, and only the node names are interned. The adjacency lists are built from the CSR graph on first
+     * use, which traversals of the frozen graph never need.
+     */
+    bool load_binary_file(std::string const & fname);
+
+    /**
+     * Saves the dependency graph as a binary image (see DepgraphImage). Freezes the graph
+     * if it is not frozen yet.
+     */
+    bool save_binary_file(std::string const & fname);
+
     void print();
 protected:
+    /**
+     * Builds the adjacency lists from the frozen CSR graph of a graph loaded from a binary
+     * image, if they have not been built yet.
+     */
+    void materialize() const;
+
+    // The adjacency lists are built lazily for graphs loaded from a binary image, and are
+    // only valid while m_materialized is set
+    mutable AdjacencyList m_adj_list;
+
+    // Reverse of m_adj_list, maintained on every change: node -> nodes it depends on
+    mutable AdjacencyList m_reverse_adj_list;
+
+    mutable bool m_materialized;
+
+    // Frozen CSR copy of m_adj_list, valid while m_frozen is set
+    CsrGraph m_csr;
+    bool m_frozen;
+
+    // Condensation of m_csr, valid while m_condensed is set
+    CondensedGraph m_condensation;
+    bool m_condensed;
+
+    // Frozen CSR copy of m_reverse_adj_list, built on the first dependency query of a
+    // frozen graph and valid while m_reverse_frozen is set
+    CsrGraph m_reverse_csr;
+    bool m_reverse_frozen;
 
-    std::unordered_map<std::string, std::list<std::string>> m_adj_list;
+    // Pool for parallel traversals of the frozen graph, if any
+    ThreadPool * m_thread_pool;
 
 };
 
@@ -0,0 +1,86 @@
+#pragma once
+
+#include <string>
+#include <unordered_map>
+#include <cstdint>
+
+#include "ekstazi/utils/hash-policy.hh"
+#include "ekstazi/utils/symbol-table.hh"
+
+namespace ekstazi
+{
+
+class DispatchSummary;
+
+/**
+ * Table of dispatch summaries keyed by the id of the function's (demangled) name.
+ */
+using DispatchSummaryMap = std::unordered_map<symbol_id, DispatchSummary>;
+
+/**
+ * Block-level digests of a dispatcher, i.e. a function whose entry block ends in a switch
+ * on one of its arguments.
+ *
+ * A call into a dispatcher runs the entry block and then only the blocks reachable from the
+ * case it selects. The summary keeps a digest of the entry block (and the signature) and
+ * one of the blocks reachable from every case, so an edit behind some cases only affects
+ * the call sites that may select them: call sites passing a non-constant argument, or a
+ * constant whose case (or the default) has a different digest than before.
+ */
+class DispatchSummary
+{
+public:
+    static DispatchSummaryMap load_file(std::string const & fname);
+    static void save_file(DispatchSummaryMap const & summaries, std::string const & fname);
+
+    /**
+     * Creates an empty summary, for functions that are not dispatchers.
+     */
+    DispatchSummary();
+
+    DispatchSummary(uint32_t arg_no, Hash128 const & entry, Hash128 const & default_case);
+
+    /**
+     * Adds the digest of the blocks reachable from a case.
+     */
+    void add_case(uint64_t value, Hash128 const & digest);
+
+    /**
+     * Returns whether or not the function is not a dispatcher.
+     */
+    bool empty() const;
+
+    /**
+     * Returns the number of the argument the function switches on.
+     */
+    uint32_t arg_no() const;
+
+    /**
+     * Returns the digest of the entry block and the signature.
+     */
+    Hash128 const & entry() const;
+
+    /**
+     * Returns the digest of the blocks a call passing the given value runs after the entry
+     * block: those of its case, or of the default.
+     */
+    Hash128 const & get_case(uint64_t value) const;
+
+    /**
+     * Returns whether a call passing the given value runs the same code as it did with the
+     * old summary.
+     */
+    bool same_case(DispatchSummary const & old_summary, uint64_t value) const;
+
+protected:
+    bool m_empty;
+    uint32_t m_arg_no;
+
+    Hash128 m_entry;
+    Hash128 m_default;
+
+    // Case value -> digest
+    std::unordered_map<uint64_t, Hash128> m_cases;
+};
+
+}
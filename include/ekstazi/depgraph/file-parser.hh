@@ -13,7 +13,7 @@ class FileParser
 {
 public:
     FileParser(std::string const & fname);
-    void parse_dependencies(DependencyGraph & graph, std::map<std::string, ekstazi::Function> & hashes);
+    void parse_dependencies(DependencyGraph & graph, ekstazi::FunctionMap & hashes);
 
 protected:
     std::string m_fname;
@@ -1,17 +1,26 @@
 #pragma once
 
 #include <string>
-#include <map>
 #include <unordered_set>
+#include <unordered_map>
+
+#include "ekstazi/utils/symbol-table.hh"
 
 namespace ekstazi
 {
 
+class Function;
+
+/**
+ * Table of functions keyed by the id of their (demangled) name.
+ */
+using FunctionMap = std::unordered_map<symbol_id, Function>;
+
 class Function
 {
 public:
-    static std::map<std::string, Function> load_file(std::string const & fname);
-    static void save_file(std::map<std::string, Function> const & functions, std::string const & fname);
+    static FunctionMap load_file(std::string const & fname);
+    static void save_file(FunctionMap const & functions, std::string const & fname);
 
     /**
      * Returns whether or not a given function is a constructor.
@@ -32,9 +41,12 @@ public:
      * Returns a set of functions that have been modified given a set of old and new functions. Modified means that either 
      * the functions don't exist from old to new and vice versa (similar to set XOR), or the computed hash changed.
      */
-    static std::unordered_set<std::string> get_modified_functions(std::map<std::string, Function> const & old_funs, std::map<std::string, Function> const & new_funs);
+    static std::unordered_set<symbol_id> get_modified_functions(FunctionMap const & old_funs, FunctionMap const & new_funs);
 
     Function(std::string const & name, std::string const & fname, std::string const & checksum);
+    Function(symbol_id id, std::string const & fname, std::string const & checksum);
+
+    symbol_id id() const;
 
     std::string const & name() const;
 
@@ -42,13 +54,21 @@ public:
 
     std::string const & filename() const;
 
+    /**
+     * Returns the signature of the direct callees of the function, or an empty string if
+     * it is unknown. Used to reuse the dependencies of unchanged functions.
+     */
+    std::string const & callee_signature() const;
+    void set_callee_signature(std::string const & callee_signature);
+
     bool operator==(Function const & fun) const;
 
 protected:
-    std::string m_name;
+    symbol_id m_id;
 
     std::string m_filename;
     std::string m_checksum;
+    std::string m_callee_signature;
 };
 
 
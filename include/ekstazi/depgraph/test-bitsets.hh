@@ -0,0 +1,59 @@
+#pragma once
+
+#include <string>
+#include <vector>
+#include <unordered_map>
+#include <functional>
+#include <cstdint>
+
+#include "ekstazi/depgraph/condensed-graph.hh"
+#include "ekstazi/utils/symbol-table.hh"
+
+namespace ekstazi
+{
+
+/**
+ * Helpers for sets of tests stored as bitsets, as used by TestIndex and VirtualCallPruner.
+ *
+ * Tests are numbered densely, and test number t is bit t % 64 of word t / 64. Bitsets of
+ * the same number of words are stored back to back in a single vector.
+ */
+
+/**
+ * Numbers the tests among the functions densely. Functions that are already in
+ * test_numbers keep their number; new tests are numbered after the tests so far and
+ * appended to tests.
+ *
+ * @return the test number of every function, or CsrGraph::invalid_index if the function
+ * is not a test.
+ */
+std::vector<uint32_t> number_tests(std::vector<symbol_id> const & functions, std::function<bool(std::string const &)> const & is_test,
+                                   std::unordered_map<symbol_id, uint32_t> & test_numbers, std::vector<symbol_id> & tests);
+
+/**
+ * Returns the number of 64-bit words of a bitset over the given number of tests.
+ */
+uint32_t num_bitset_words(uint32_t num_tests);
+
+/**
+ * Returns a pointer to the first word of a bitset.
+ */
+uint64_t* bitset(std::vector<uint64_t> & bitsets, uint32_t index, uint32_t words);
+uint64_t const * bitset(std::vector<uint64_t> const & bitsets, uint32_t index, uint32_t words);
+
+/**
+ * ORs one bitset into another.
+ *
+ * @return true if the target bitset changed.
+ */
+bool merge_bitsets(uint64_t* bits, uint64_t const * other_bits, uint32_t words);
+
+/**
+ * Sets the bitset of every component of a condensed graph to the tests reaching it: the
+ * tests among its members, and the tests reaching the components that depend on it.
+ * member_test_numbers[k] is the test number of graph.members()[k], as returned by
+ * number_tests. bitsets must hold at least graph.num_components() cleared bitsets.
+ */
+void propagate_test_bitsets(CondensedGraph const & graph, std::vector<uint32_t> const & member_test_numbers, uint32_t words, std::vector<uint64_t> & bitsets);
+
+}
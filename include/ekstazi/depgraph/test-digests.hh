@@ -0,0 +1,79 @@
+#pragma once
+
+#include <string>
+#include <vector>
+#include <unordered_map>
+#include <functional>
+#include <cstdint>
+
+#include "ekstazi/depgraph/condensed-graph.hh"
+#include "ekstazi/depgraph/function.hh"
+#include "ekstazi/utils/hash-policy.hh"
+#include "ekstazi/utils/symbol-table.hh"
+
+namespace ekstazi
+{
+
+/**
+ * Transitive (Merkle) digests of the tests in a dependency graph.
+ *
+ * The digest of a function covers its name and checksum and the digests of everything
+ * it (transitively) depends on, so a test's digest changes exactly when a function it
+ * reaches changes or the dependencies between them do. Selecting tests then compares one
+ * digest per test with the last run instead of traversing the old and new graphs.
+ *
+ * The digests are computed bottom-up over the strongly connected components of the
+ * graph, in topological order, so every component is hashed once. The members of a
+ * component and the digests of the components it depends on are combined by adding
+ * them up, which does not depend on the order they are stored in. Edges inside a
+ * component are not part of the digest; the functions a test reaches and their
+ * checksums are.
+ */
+class TestDigests
+{
+public:
+    /**
+     * Predicate deciding whether a (demangled) function name is a test.
+     */
+    using TestPredicate = std::function<bool(std::string const &)>;
+
+    TestDigests();
+
+    /**
+     * Computes the digests of the tests in a condensed dependency graph, with the
+     * checksums of the functions in it.
+     */
+    void build(CondensedGraph const & graph, FunctionMap const & functions, TestPredicate const & is_test);
+
+    /**
+     * Returns the tests whose digest differs from the one in the given (old) digests,
+     * including tests that are not in them.
+     */
+    std::vector<symbol_id> get_changed_tests(TestDigests const & old_digests) const;
+
+    /**
+     * Returns whether or not there are no tests.
+     */
+    bool empty() const;
+
+    /**
+     * Returns the number of tests.
+     */
+    uint32_t num_tests() const;
+
+    /**
+     * Loads the digests from a file.
+     */
+    void load_file(std::string const & fname);
+
+    /**
+     * Saves the digests to a file, one test per line.
+     */
+    void save_file(std::string const & fname) const;
+
+protected:
+    // Test -> digest
+    std::unordered_map<symbol_id, Hash128> m_digests;
+};
+
+}
@@ -0,0 +1,86 @@
+#pragma once
+
+#include <string>
+#include <vector>
+#include <unordered_map>
+#include <unordered_set>
+#include <functional>
+#include <cstdint>
+
+#include "ekstazi/depgraph/condensed-graph.hh"
+#include "ekstazi/depgraph/test-bitsets.hh"
+#include "ekstazi/utils/symbol-table.hh"
+
+namespace ekstazi
+{
+
+/**
+ * The test index maps every function in a dependency graph to the set of tests that
+ * (transitively) depend on it, so test selection becomes a lookup instead of a
+ * traversal of the graph.
+ *
+ * Tests are numbered densely and the tests reaching a function are stored as a
+ * bitset. The bitsets are propagated once over the strongly connected components
+ * of the graph in reverse topological order: the bitset of a component is the OR of the bitsets of its
+ * dependents' components, plus the tests inside the component itself.
+ *
+ * Functions with identical bitsets share a single copy, which keeps the index small
+ * since most functions of a component chain reach the same tests.
+ */
+class TestIndex
+{
+public:
+    /**
+     * Predicate deciding whether a (demangled) function name is a test.
+     */
+    using TestPredicate = std::function<bool(std::string const &)>;
+
+    TestIndex();
+
+    /**
+     * Builds the index for a condensed dependency graph.
+     */
+    void build(CondensedGraph const & graph, TestPredicate const & is_test);
+
+    /**
+     * Returns the tests that depend on any of the given functions, including functions
+     * that are tests themselves.
+     */
+    std::unordered_set<symbol_id> get_tests(std::vector<symbol_id> const & functions) const;
+
+    /**
+     * Returns whether or not the index is empty.
+     */
+    bool empty() const;
+
+    /**
+     * Returns the number of tests in the index.
+     */
+    uint32_t num_tests() const;
+
+    /**
+     * Loads the index from a file.
+     */
+    void load_file(std::string const & fname);
+
+    /**
+     * Saves the index to a file. The file lists the tests, followed by the distinct
+     * bitsets and then every function with the bitset it maps to.
+     */
+    void save_file(std::string const & fname) const;
+
+protected:
+    // Test number -> test function
+    std::vector<symbol_id> m_tests;
+
+    // Number of 64-bit words in every bitset
+    uint32_t m_words;
+
+    // All distinct bitsets, stored back to back
+    std::vector<uint64_t> m_bitsets;
+
+    // Function -> bitset. Functions that no test depends on are left out.
+    std::unordered_map<symbol_id, uint32_t> m_function_bitsets;
+};
+
+}
@@ -0,0 +1,149 @@
+#pragma once
+
+#include <string>
+#include <vector>
+#include <unordered_map>
+#include <functional>
+#include <cstdint>
+
+#include "ekstazi/depgraph/csr-graph.hh"
+#include "ekstazi/depgraph/condensed-graph.hh"
+#include "ekstazi/depgraph/test-bitsets.hh"
+#include "ekstazi/utils/symbol-table.hh"
+
+namespace ekstazi
+{
+
+/**
+ * Decides which virtual calls to add to the dependency graph with the constructor
+ * optimization: a call to a virtual function of a class is only kept if some test both
+ * (transitively) makes the call and constructs the class.
+ *
+ * The tests reaching every function are computed with one labelled propagation instead
+ * of a traversal per class and per call. Tests are numbered densely and the tests
+ * reaching a strongly connected component of the old and of the new dependency graph are
+ * stored as bitsets, as in TestIndex; the tests constructing a class are the OR of the
+ * bitsets of its constructors. A call is then decided by intersecting two bitsets.
+ *
+ * Every kept call adds an edge to the new graph, so more tests may reach the callee, the
+ * functions it calls and the constructors among them. The new bitsets are propagated
+ * along the added edges and the calls are decided again until no more calls are kept.
+ * As in DepgraphUnion, paths that mix old and new edges are not followed.
+ *
+ * In per-test mode (rapid type analysis per test), a kept call is only live for the tests
+ * that both reach the caller and construct the class, rather than for every test reaching
+ * the caller. Instead of the edge to the caller, the callee gets an edge to each of those
+ * tests, so a change to an override only selects the tests that can dispatch to it.
+ */
+class VirtualCallPruner
+{
+public:
+    /**
+     * Predicate deciding whether a (demangled) function name is a test.
+     */
+    using TestPredicate = std::function<bool(std::string const &)>;
+
+    /**
+     * Condenses the old and the new dependency graph, before any virtual calls are added.
+     */
+    VirtualCallPruner(CsrGraph const & old_graph, CsrGraph const & new_graph);
+
+    /**
+     * Sets whether calls are decided per test. Off by default.
+     */
+    void set_per_test(bool per_test);
+
+    /**
+     * Adds a constructor of a class.
+     */
+    void add_constructor(symbol_id class_id, symbol_id constructor);
+
+    /**
+     * Adds a virtual call from a caller to a virtual function of a class.
+     */
+    void add_virtual_call(symbol_id caller, symbol_id callee, symbol_id class_id);
+
+    /**
+     * Decides all virtual calls.
+     *
+     * @return the indices of the calls to keep, in the order they were added.
+     */
+    std::vector<uint32_t> prune(TestPredicate const & is_test);
+
+    /**
+     * Returns the number of classes constructed by any test, after prune().
+     */
+    uint32_t num_constructed_classes() const;
+
+    /**
+     * Returns the tests that both reach the caller of a kept call and construct its class,
+     * after prune(). In per-test mode, these are the tests the callee gets edges to.
+     */
+    std::vector<symbol_id> get_live_tests(uint32_t call) const;
+
+protected:
+    struct VirtualCall
+    {
+        symbol_id caller;
+        symbol_id callee;
+        uint32_t class_index;
+    };
+
+    /**
+     * Returns the node of a symbol in the new graph. Symbols that are not in the graph get
+     * nodes of their own after its components.
+     */
+    uint32_t node_of(symbol_id symbol);
+
+    /**
+     * Returns the index of a class, adding it if it is new.
+     */
+    uint32_t class_index_of(symbol_id class_id);
+
+    /**
+     * Adds an edge to the new graph and propagates the tests reaching the dependent node to
+     * everything the node depends on.
+     */
+    void add_edge(uint32_t node, uint32_t dependent_node);
+
+    CondensedGraph m_old_graph;
+    CondensedGraph m_new_graph;
+
+    bool m_per_test;
+
+    std::vector<VirtualCall> m_calls;
+
+    // Test number -> test function
+    std::vector<symbol_id> m_tests;
+
+    // Class -> index, and constructors of every class
+    std::unordered_map<symbol_id, uint32_t> m_class_indices;
+    std::vector<std::vector<symbol_id>> m_class_constructors;
+
+    // Symbols that are not in the new graph -> their node
+    std::unordered_map<symbol_id, uint32_t> m_extra_nodes;
+    std::vector<symbol_id> m_extra_symbols;
+
+    // Number of 64-bit words in every bitset
+    uint32_t m_words;
+
+    // Tests reaching every component of the old graph and every node of the new graph,
+    // and tests constructing every class
+    std::vector<uint64_t> m_old_bitsets;
+    std::vector<uint64_t> m_new_bitsets;
+    std::vector<uint64_t> m_class_bitsets;
+
+    // Tests every call is live for
+    std::vector<uint64_t> m_live_bitsets;
+
+    // Nodes of the new graph -> nodes they depend on, for the components of the graph in
+    // CSR form, and for the edges of kept calls
+    std::vector<uint32_t> m_predecessor_offsets;
+    std::vector<uint32_t> m_predecessors;
+    std::unordered_map<uint32_t, std::vector<uint32_t>> m_added_predecessors;
+
+    // Node of the new graph -> classes it has a constructor of
+    std::unordered_map<uint32_t, std::vector<uint32_t>> m_node_classes;
+};
+
+}
@@ -1,19 +1,78 @@
-
 #pragma once
 
+#include "ekstazi/utils/hash-policy.hh"
+#include "ekstazi/depgraph/dispatch-summary.hh"
+
 #include "llvm/Transforms/Utils/FunctionComparator.h"
 
+#include <vector>
+#include <unordered_map>
+#include <shared_mutex>
+
 namespace ekstazi
 {
 
 class FunctionComparator : private llvm::FunctionComparator
 {
 public:
+    /**
+     * 128-bit function hash. The high half is 0 for 64-bit hash policies.
+     */
+    using FunctionHash = Hash128;
+
+    /**
+     * Digest of the initializer of a global variable. Globals without an initializer and
+     * gtest internals have none and are not folded into the functions referencing them.
+     */
+    struct GlobalDigest
+    {
+        bool has_digest;
+        FunctionHash hash;
+    };
+
+    /**
+     * Digests of global variable initializers, shared by all functions hashed in a run,
+     * so a large constant table referenced from many functions is hashed only once.
+     *
+     * Functions may be hashed concurrently, so lookups take a shared lock. Two threads
+     * may compute the same digest; the digest is deterministic, so either is kept.
+     */
+    template <typename HashPolicy = Xxh128HashPolicy>
+    class GlobalDigestCache
+    {
+    public:
+        GlobalDigestCache();
+
+        /**
+         * Looks up the digest of a global variable.
+         *
+         * @return false if the digest has not been computed yet.
+         */
+        bool find(llvm::GlobalVariable const * global_var, GlobalDigest & digest) const;
+
+        void insert(llvm::GlobalVariable const * global_var, GlobalDigest const & digest);
+
+        size_t size() const;
+
+    protected:
+        mutable std::shared_mutex m_mutex;
+        std::unordered_map<llvm::GlobalVariable const *, GlobalDigest> m_digests;
+    };
+
+    /**
+     * Accumulates a function hash. The hash policy (see hash-policy.hh) decides how the
+     * values added are mixed; instantiations exist for Mix64HashPolicy and
+     * Xxh128HashPolicy.
+     */
+    template <typename HashPolicy>
     class HashAccumulator
     {
     public:
-        // Initialize to random constant, so the state isn't zero.
-        HashAccumulator();
+        /**
+         * Digests of referenced global variables are looked up in and added to the cache,
+         * if there is one.
+         */
+        explicit HashAccumulator(GlobalDigestCache<HashPolicy>* cache = nullptr);
         
         void add(uint64_t v);
 
@@ -22,16 +81,42 @@ public:
         // Hash LLVM constant values
         void add(llvm::Constant const * const_val);
 
-        template <typename T>
-        void add(T & v);
-        
-        // No finishing is required, because the entire hash value is used.
-        uint64_t get_hash();
+        FunctionHash get_hash();
 
     protected:
-        uint64_t hash;
+        /**
+         * Adds the digest of a global variable's initializer, computing it if it is not
+         * cached.
+         */
+        void add_global(llvm::GlobalVariable const * global_var);
+
+        /**
+         * Hashes the initializer of a global variable on its own. The digest is cached
+         * unless the initializer refers back to itself or to a global whose initializer
+         * is still being hashed further up. The digest of a global on such a cycle
+         * depends on where the hashing entered the cycle.
+         */
+        GlobalDigest compute_digest(llvm::GlobalVariable const * global_var);
+
+        HashPolicy m_policy;
+        GlobalDigestCache<HashPolicy>* m_cache;
+
+        // Globals whose initializers are being hashed, outermost first, and the
+        // outermost of them referred back to since the innermost one started
+        std::vector<llvm::GlobalVariable const *> m_globals_in_progress;
+        uint32_t m_low_link;
     };
-    static FunctionComparator::FunctionHash functionHash(llvm::Function &F);
+
+    template <typename HashPolicy = Xxh128HashPolicy>
+    static FunctionHash functionHash(llvm::Function &F, GlobalDigestCache<HashPolicy>* cache = nullptr);
+
+    /**
+     * Returns the dispatch summary of a function whose entry block ends in a switch on one
+     * of its arguments, or an empty summary for other functions. The blocks are hashed as
+     * in functionHash().
+     */
+    template <typename HashPolicy = Xxh128HashPolicy>
+    static DispatchSummary dispatchSummary(llvm::Function &F, GlobalDigestCache<HashPolicy>* cache = nullptr);
 };
 
 }
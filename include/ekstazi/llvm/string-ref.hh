@@ -0,0 +1,19 @@
+#pragma once
+
+#include <string_view>
+
+#include "llvm/ADT/StringRef.h"
+
+namespace ekstazi
+{
+
+/**
+ * Returns a view of the same characters as an LLVM string reference, so IR names can
+ * be passed to ekstazi without copying them into a std::string.
+ */
+inline std::string_view to_string_view(llvm::StringRef str)
+{
+    return std::string_view{ str.data(), str.size() };
+}
+
+}
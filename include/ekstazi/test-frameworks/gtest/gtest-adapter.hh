@@ -1,6 +1,7 @@
 #pragma once
 
 #include <string>
+#include <string_view>
 #include <unordered_set>
 #include <unordered_map>
 #include <memory>
@@ -24,11 +25,12 @@ public:
     /**
      * Returns whether or not a function name in IR is an internal
      * googletest function. We will skip adding these to the dependency
-     * graph and function set.
+     * graph and function set. Most names are classified from their
+     * mangled prefix, without demangling them.
      * 
      * @param fun_name the mangled function name
      */
-    static bool is_internal_function(std::string const & fun_name);
+    static bool is_internal_function(std::string_view fun_name);
 
     /**
      * Returns whether or not a function name in IR is a
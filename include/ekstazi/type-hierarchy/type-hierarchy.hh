@@ -1,12 +1,13 @@
 #pragma once
 
-#include <list>
 #include <unordered_map>
 #include <unordered_set>
 #include <string>
 #include <memory>
 #include <iostream>
 
+#include "ekstazi/utils/graph.hh"
+#include "ekstazi/utils/symbol-table.hh"
 
 namespace ekstazi
 {
@@ -37,10 +38,13 @@ public:
      * Add an inheritance relationship for two types. The base type is the base of the derived type.
      */
     void add_inheritance_relationship(std::string const & base_type_name, std::string const & derived_type_name);
+    void add_inheritance_relationship(symbol_id base_type, symbol_id derived_type);
 
     std::unordered_set<std::string> get_derived_types(std::string const & base_type_name);
+    std::unordered_set<symbol_id> get_derived_types(symbol_id base_type);
 
     std::unordered_set<std::string> get_super_types(std::string const & derived_type_name);
+    std::unordered_set<symbol_id> get_super_types(symbol_id derived_type);
 
     std::unordered_set<std::string> get_all_related_types(std::string const & type_name);
 
@@ -64,11 +68,6 @@ public:
      */
     uint32_t num_derived_types() const;
 
-    /**
-     * Removes duplicates from adjacency list.
-     */
-    void remove_duplicates();
-
     /**
      * Prints the type hierarchy.
      */
@@ -85,27 +84,28 @@ public:
     void load_file(std::string const & fname);
 
     bool contains(std::string const & class_name);
+    bool contains(symbol_id class_id);
 
 protected:
     /**
      * Traverses an adjacency list and returns all children.
      */
-    std::unordered_set<std::string> get_all_children(std::string const & name, std::unordered_map<std::string, std::list<std::string>> const & adj_list);
+    std::unordered_set<symbol_id> get_all_children(symbol_id start_node, AdjacencyList const & adj_list);
 
     /**
-     * Removes duplicates from adjacency list.
+     * Converts a set of type ids to their names.
      */
-    void remove_duplicates(std::unordered_map<std::string, std::list<std::string>> & adj_list);
+    static std::unordered_set<std::string> to_names(std::unordered_set<symbol_id> const & ids);
 
     /**
      * We maintain two adjacency lists, one to represent supertype relationships
      * and one to represent derived relationships.
      */
     // Represents derived relationships where node1 -(IS_BASE_OF) -> node2
-    std::unordered_map<std::string, std::list<std::string>> m_derived_adj_list;
+    AdjacencyList m_derived_adj_list;
 
     // Represents supertype relationships where node1 -(INHERITS_FROM)-> node2
-    std::unordered_map<std::string, std::list<std::string>> m_super_adj_list;
+    AdjacencyList m_super_adj_list;
     
 };
 
@@ -0,0 +1,98 @@
+#pragma once
+
+#include <vector>
+#include <unordered_set>
+#include <cstdint>
+#include <cstddef>
+
+#include "ekstazi/utils/symbol-table.hh"
+
+namespace ekstazi
+{
+
+/**
+ * Set of the nodes adjacent to one node of a graph, which rejects duplicates on insert.
+ *
+ * Most nodes only have a handful of neighbors, which are stored inline and looked up by
+ * a linear scan. Larger sets move to the heap, and once they grow past hash_threshold an
+ * open-addressing hash table over the stored ids is built as well, so inserting into or
+ * looking up the set of a hub node with tens of thousands of callers stays O(1).
+ *
+ * Nodes are iterated in insertion order.
+ */
+class AdjacencySet
+{
+public:
+    using const_iterator = symbol_id const *;
+
+    /**
+     * Number of nodes stored without a heap allocation.
+     */
+    static constexpr uint32_t inline_capacity = 4;
+
+    /**
+     * Size above which lookups go through a hash table instead of a linear scan.
+     */
+    static constexpr uint32_t hash_threshold = 16;
+
+    AdjacencySet();
+
+    /**
+     * Inserts a node.
+     *
+     * @return true if the node was inserted, false if it was already in the set.
+     */
+    bool insert(symbol_id node);
+
+    /**
+     * Removes a node.
+     *
+     * @return true if the node was removed, false if it was not in the set.
+     */
+    bool erase(symbol_id node);
+
+    /**
+     * Removes all of the given nodes with a single pass over the set.
+     */
+    void erase(std::unordered_set<symbol_id> const & nodes);
+
+    /**
+     * Returns whether the node is in the set.
+     */
+    bool contains(symbol_id node) const;
+
+    size_t size() const;
+    bool empty() const;
+
+    const_iterator begin() const;
+    const_iterator end() const;
+
+protected:
+    /**
+     * Returns the stored nodes, inline or on the heap.
+     */
+    symbol_id * data();
+    symbol_id const * data() const;
+
+    /**
+     * Returns the table slot holding the node, or the empty slot it would go in.
+     */
+    size_t find_slot(symbol_id node) const;
+
+    /**
+     * Rebuilds the hash table for the current nodes, or drops it for small sets.
+     */
+    void rebuild_table();
+
+    // Nodes in insertion order. The first inline_capacity nodes live in m_inline until
+    // the set outgrows it, after which all of them live in m_heap.
+    symbol_id m_inline[inline_capacity];
+    uint32_t m_size;
+    std::vector<symbol_id> m_heap;
+
+    // Open-addressing table with linear probing over the stored nodes, with
+    // SymbolTable::invalid_id marking empty slots. Empty for small sets.
+    std::vector<symbol_id> m_table;
+};
+
+}
@@ -4,34 +4,55 @@
 #include <string>
 #include <unordered_set>
 #include <unordered_map>
-#include <list>
+#include <vector>
+
+#include "ekstazi/utils/symbol-table.hh"
+#include "ekstazi/utils/adjacency-set.hh"
 
 namespace ekstazi
 {
 
-std::unordered_set<std::string> bfs(std::string const & start_node, std::unordered_map<std::string, std::list<std::string>> const & adj_list);
+/**
+ * Adjacency list of a directed graph over interned symbols. Adjacent nodes are kept in
+ * an AdjacencySet, so the graph never holds duplicate edges.
+ */
+using AdjacencyList = std::unordered_map<symbol_id, AdjacencySet>;
+
+std::unordered_set<symbol_id> bfs(symbol_id start_node, AdjacencyList const & adj_list);
+
+/**
+ * Conducts a single breadth-first search from several nodes at once and returns
+ * the union of the nodes reachable from each of them.
+ */
+std::unordered_set<symbol_id> bfs(std::vector<symbol_id> const & start_nodes, AdjacencyList const & adj_list);
+
+std::unordered_set<symbol_id> dfs(symbol_id start_node, AdjacencyList const & adj_list);
+std::unordered_set<symbol_id> dfs(symbol_id start_node, AdjacencyList const & adj_list, std::unordered_set<symbol_id> const & visited);
 
-std::unordered_set<std::string> dfs(std::string const & start_node, std::unordered_map<std::string, std::list<std::string>> const & adj_list);
-std::unordered_set<std::string> dfs(std::string const & start_node, std::unordered_map<std::string, std::list<std::string>> const & adj_list, std::unordered_set<std::string> const & visited);
+/**
+ * Returns the strongly connected components of the graph, in reverse topological order:
+ * every node reachable from a component is in the component itself or in a later one.
+ */
+std::vector<std::vector<symbol_id>> strongly_connected_components(AdjacencyList const & adj_list);
 
 /**
  * Returns the maximum distance of the graph between any 2 nodes.
  */
-uint32_t max_distance(std::unordered_map<std::string, std::list<std::string>> const & adj_list);
+uint32_t max_distance(AdjacencyList const & adj_list);
 
 /**
  * Returns the average distance of the graph from all leaf nodes.
  */
-double average_distance(std::unordered_map<std::string, std::list<std::string>> const & adj_list);
+double average_distance(AdjacencyList const & adj_list);
 
 /**
  * Returns the number of nodes in the graph.
  */
-uint32_t num_nodes(std::unordered_map<std::string, std::list<std::string>> const & adj_list);
+uint32_t num_nodes(AdjacencyList const & adj_list);
 
 /**
  * Returns the number of non-root nodes in the graph.
  */
-uint32_t num_nonroot_nodes(std::unordered_map<std::string, std::list<std::string>> const & adj_list);
+uint32_t num_nonroot_nodes(AdjacencyList const & adj_list);
 
 }
@@ -0,0 +1,112 @@
+#pragma once
+
+#include <string>
+#include <cstdint>
+#include <cstddef>
+
+namespace ekstazi
+{
+
+/**
+ * 128-bit hash value.
+ */
+struct Hash128
+{
+    uint64_t low;
+    uint64_t high;
+
+    bool operator==(Hash128 const & other) const;
+    bool operator!=(Hash128 const & other) const;
+
+    /**
+     * Returns the hash as 32 hexadecimal digits, high half first.
+     */
+    std::string to_string() const;
+
+    /**
+     * Parses a hash written by to_string().
+     *
+     * @return false if the string is not 32 hexadecimal digits.
+     */
+    static bool from_string(std::string const & str, Hash128 & hash);
+};
+
+/**
+ * Hash policies for streaming hashes, e.g. FunctionComparator::HashAccumulator.
+ *
+ * A policy is fed 64-bit words and byte strings in order and returns a Hash128 at the
+ * end. Policies are plugged in as template arguments, so the choice costs nothing at
+ * run time; src/tools/hash-benchmark.cc compares them.
+ */
+
+/**
+ * The original 64-bit scheme: every word is mixed into the state with the 16-byte hash
+ * of CityHash (llvm::hashing::detail::hash_16_bytes), and byte strings are hashed on
+ * their own and added to the state. Adding makes byte strings commutative with each
+ * other. The high half of the result is always 0.
+ */
+class Mix64HashPolicy
+{
+public:
+    Mix64HashPolicy();
+
+    void add_word(uint64_t word);
+    void add_bytes(char const * data, size_t size);
+
+    Hash128 finish() const;
+
+protected:
+    uint64_t m_hash;
+};
+
+/**
+ * Streaming 128-bit hash in the style of XXH3.
+ *
+ * The input is consumed in 64-byte stripes. Every stripe is folded into 8 64-bit
+ * accumulator lanes: each lane adds the 32x32-bit product of the two halves of its
+ * input word XORed with a secret, and the input word of its neighbouring lane. The
+ * lanes are independent, so a stripe is a few SIMD instructions (SSE2 or AVX2 where
+ * available), and long byte strings such as constant tables are hashed straight from
+ * memory. The lanes are scrambled after every 8 stripes and merged into two 64-bit
+ * halves at the end.
+ *
+ * Words and byte strings are appended to one stream, every byte string preceded by its
+ * length, so the hash depends on the order and the boundaries of everything added.
+ */
+class Xxh128HashPolicy
+{
+public:
+    static constexpr size_t stripe_size = 64;
+    static constexpr size_t num_lanes = 8;
+    static constexpr size_t stripes_per_block = 8;
+
+    Xxh128HashPolicy();
+
+    void add_word(uint64_t word);
+    void add_bytes(char const * data, size_t size);
+
+    Hash128 finish() const;
+
+protected:
+    /**
+     * Appends bytes to the stream, consuming every complete stripe.
+     */
+    void append(unsigned char const * data, size_t size);
+
+    /**
+     * Folds a stripe into the accumulators, and scrambles them at the end of a block.
+     */
+    void consume_stripe(unsigned char const * stripe);
+
+    alignas(32) uint64_t m_acc[num_lanes];
+
+    // Incomplete stripe at the end of the stream
+    alignas(32) unsigned char m_buffer[stripe_size];
+    size_t m_buffer_size;
+
+    // Stripes consumed in the current block, and bytes in the whole stream
+    size_t m_block_stripes;
+    uint64_t m_total_size;
+};
+
+}
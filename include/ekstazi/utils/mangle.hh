@@ -1,11 +1,82 @@
 #pragma once
 
 #include <string>
+#include <string_view>
+#include <unordered_map>
+#include <vector>
+#include <memory>
+#include <shared_mutex>
 #include <cxxabi.h>
 
 namespace ekstazi
 {
 
-std::string demangle(std::string const & name);
+/**
+ * Cache of demangled names keyed by mangled name.
+ *
+ * The pass asks for the demangled name of the same function many times (to filter it,
+ * to intern it, to split its class name, ...), and every call to abi::__cxa_demangle
+ * allocates and frees a buffer. The cache demangles each name once. Both the mangled
+ * and the demangled names are copied into a bump-allocated arena, so the views handed
+ * out stay valid for the lifetime of the cache and cost no allocation per entry.
+ *
+ * The cache is process-wide and thread-safe. Looking up a cached name takes a shared
+ * lock; only a name seen for the first time takes the exclusive lock to be stored. The
+ * pass demangles every function and global name of a module before hashing its
+ * functions on several threads, so the hashing workers only ever take the shared lock.
+ */
+class DemangleCache
+{
+public:
+    /**
+     * Returns the process-wide demangle cache.
+     */
+    static DemangleCache & instance();
+
+    DemangleCache();
+
+    DemangleCache(DemangleCache const &) = delete;
+    DemangleCache & operator=(DemangleCache const &) = delete;
+
+    /**
+     * Returns the demangled name, or the name itself if it is not a mangled name.
+     */
+    std::string_view demangle(std::string_view name);
+
+    /**
+     * Returns the number of cached names.
+     */
+    size_t size() const;
+
+protected:
+    /**
+     * Copies a string into the arena and returns a view of the copy.
+     */
+    std::string_view store(std::string_view str);
+
+    // Arena blocks. Strings never straddle two blocks, and strings larger than a block
+    // get a block of their own.
+    std::vector<std::unique_ptr<char[]>> m_blocks;
+    size_t m_block_used;
+
+    // Mangled -> demangled name, both pointing into the arena
+    std::unordered_map<std::string_view, std::string_view> m_names;
+
+    // Guards the arena and m_names
+    mutable std::shared_mutex m_mutex;
+};
+
+/**
+ * Demangles a name through the process-wide DemangleCache. The returned view stays
+ * valid for the lifetime of the process.
+ */
+std::string_view demangle(std::string_view name);
+
+/**
+ * Returns whether the demangled form of a name contains "std::" or "__gnu_cxx::", i.e.
+ * whether it belongs to or involves the standard library. Most names are classified
+ * from their mangled form; only the ambiguous ones are demangled.
+ */
+bool is_std_name(std::string_view name);
 
 }
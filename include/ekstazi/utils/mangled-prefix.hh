@@ -0,0 +1,114 @@
+#pragma once
+
+#include <string_view>
+#include <array>
+#include <cstddef>
+
+namespace ekstazi
+{
+
+/**
+ * Helpers to classify Itanium mangled names by their prefix, without demangling them.
+ *
+ * Everything here is constexpr and works on views of the mangled name, so the pattern
+ * tables are built at compile time and a lookup never allocates. The helpers only give
+ * definite answers; callers fall back to demangling the names they cannot classify.
+ */
+
+/**
+ * Returns whether the name starts with the given prefix.
+ */
+constexpr bool starts_with(std::string_view name, std::string_view prefix)
+{
+    return name.size() >= prefix.size() && name.compare(0, prefix.size(), prefix) == 0;
+}
+
+/**
+ * Returns whether the name starts with any of the given prefixes.
+ */
+template <size_t N>
+constexpr bool starts_with_any(std::string_view name, std::array<std::string_view, N> const & prefixes)
+{
+    for (std::string_view prefix : prefixes)
+    {
+        if (starts_with(name, prefix))
+        {
+            return true;
+        }
+    }
+    return false;
+}
+
+/**
+ * Returns whether the name contains any of the given strings.
+ */
+template <size_t N>
+constexpr bool contains_any(std::string_view name, std::array<std::string_view, N> const & parts)
+{
+    for (std::string_view part : parts)
+    {
+        if (name.find(part) != std::string_view::npos)
+        {
+            return true;
+        }
+    }
+    return false;
+}
+
+/**
+ * Returns the index-th component of the nested name a mangled name starts with, e.g.
+ * "internal" for index 1 of _ZN7testing8internal6FormatEv. Returns an empty view if
+ * the name is not a nested name, or if a substitution or template argument list comes
+ * before the requested component.
+ */
+constexpr std::string_view nested_component(std::string_view name, size_t index)
+{
+    if (!starts_with(name, "_ZN"))
+    {
+        return {};
+    }
+
+    // Skip the cv- and ref-qualifiers of member functions
+    size_t pos = 3;
+    while (pos < name.size() && (name[pos] == 'r' || name[pos] == 'V' || name[pos] == 'K'))
+    {
+        ++pos;
+    }
+    if (pos < name.size() && (name[pos] == 'R' || name[pos] == 'O'))
+    {
+        ++pos;
+    }
+
+    // Every component is a <source-name>: its length in decimal, then the identifier
+    for (size_t i = 0; ; ++i)
+    {
+        size_t length = 0;
+        size_t digits_begin = pos;
+        while (pos < name.size() && name[pos] >= '0' && name[pos] <= '9')
+        {
+            length = length * 10 + (name[pos] - '0');
+            ++pos;
+        }
+        if (pos == digits_begin || length > name.size() - pos)
+        {
+            return {};
+        }
+        if (i == index)
+        {
+            return name.substr(pos, length);
+        }
+        pos += length;
+    }
+}
+
+/**
+ * Returns whether the demangled form of a name could start with a return type. Only
+ * function template specializations are demangled with their return type, and those
+ * always contain a template argument list ('I').
+ */
+constexpr bool may_have_return_type(std::string_view name)
+{
+    return name.find('I') != std::string_view::npos;
+}
+
+}
@@ -0,0 +1,82 @@
+#pragma once
+
+#include <vector>
+#include <mutex>
+#include <cstdint>
+
+#include "ekstazi/utils/thread-pool.hh"
+
+namespace ekstazi
+{
+
+/**
+ * Number of frontier nodes a worker expands at once during a parallel search.
+ */
+size_t const PARALLEL_BFS_GRAIN = 256;
+
+/**
+ * Atomically marks a node as visited in a bitmap shared between threads.
+ *
+ * @return true if this call marked the node, false if it was already visited.
+ */
+inline bool try_visit(std::vector<uint64_t> & visited, uint32_t node)
+{
+    uint64_t mask = uint64_t{ 1 } << (node % 64);
+    uint64_t* word = &visited[node / 64];
+    if (__atomic_load_n(word, __ATOMIC_RELAXED) & mask)
+    {
+        return false;
+    }
+    return !(__atomic_fetch_or(word, mask, __ATOMIC_RELAXED) & mask);
+}
+
+/**
+ * Expands one level of a breadth-first search top-down, with the frontier split across
+ * the pool. Every neighbor of a frontier node that is not visited yet is marked visited
+ * and appended to next, in no particular order.
+ *
+ * for_each_neighbor(node, visit) must call visit(neighbor) for every neighbor of node.
+ */
+template <typename ForEachNeighbor>
+void expand_top_down(ThreadPool & pool, std::vector<uint32_t> const & frontier, std::vector<uint64_t> & visited, std::vector<uint32_t> & next, ForEachNeighbor const & for_each_neighbor)
+{
+    std::mutex next_mutex;
+    pool.parallel_for(frontier.size(), [&](size_t begin, size_t end) {
+        std::vector<uint32_t> local_next;
+        for (size_t i = begin; i < end; ++i)
+        {
+            for_each_neighbor(frontier[i], [&](uint32_t neighbor) {
+                if (try_visit(visited, neighbor))
+                {
+                    local_next.push_back(neighbor);
+                }
+            });
+        }
+
+        std::lock_guard<std::mutex> lock{ next_mutex };
+        next.insert(next.end(), local_next.begin(), local_next.end());
+    }, PARALLEL_BFS_GRAIN);
+}
+
+/**
+ * Level-synchronous parallel breadth-first search from the given frontier. Each level is
+ * expanded with expand_top_down. The start nodes are not marked visited, so they are only
+ * reached if a neighbor leads back to them.
+ *
+ * Every reached node is appended to reached and left marked in visited, so the caller
+ * can clear the bitmap through reached.
+ */
+template <typename ForEachNeighbor>
+void parallel_bfs(ThreadPool & pool, std::vector<uint32_t> frontier, std::vector<uint64_t> & visited, std::vector<uint32_t> & reached, ForEachNeighbor const & for_each_neighbor)
+{
+    std::vector<uint32_t> next;
+    while (!frontier.empty())
+    {
+        next.clear();
+        expand_top_down(pool, frontier, visited, next, for_each_neighbor);
+        reached.insert(reached.end(), next.begin(), next.end());
+        frontier.swap(next);
+    }
+}
+
+}
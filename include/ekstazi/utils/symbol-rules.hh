@@ -0,0 +1,90 @@
+#pragma once
+
+#include <string>
+#include <string_view>
+#include <vector>
+#include <cstdint>
+
+#include "ekstazi/utils/hash-policy.hh"
+
+namespace ekstazi
+{
+
+/**
+ * User-configurable rules that exclude functions from the dependency graph by their
+ * demangled name, e.g. the logging, metrics or allocator namespaces of a project, whose
+ * functions are called from everywhere and make every test depend on every change.
+ *
+ * Rules are read from a file with one rule per line, as "action;kind;pattern": action is
+ * exclude or include, and kind is prefix (the name starts with the pattern) or substring
+ * (the name contains it). A name is excluded if it matches an exclude rule and no include
+ * rule, so include rules carve exceptions out of excluded namespaces. Empty lines and
+ * lines starting with '#' are skipped.
+ *
+ * All patterns are compiled into a single Aho-Corasick automaton, so a name is checked
+ * against every rule with one scan over its characters.
+ */
+class SymbolRules
+{
+public:
+    SymbolRules();
+
+    /**
+     * Adds a rule. The rules are only applied after compile() is called.
+     */
+    void add_rule(bool exclude, bool prefix, std::string const & pattern);
+
+    /**
+     * Loads the rules from a file and compiles them. Malformed lines are skipped.
+     *
+     * @return the number of rules loaded, 0 if the file does not exist.
+     */
+    uint32_t load_file(std::string const & fname);
+
+    /**
+     * Builds the automaton for all rules added so far.
+     */
+    void compile();
+
+    /**
+     * Returns whether there are no rules.
+     */
+    bool empty() const;
+
+    /**
+     * Returns whether a demangled name is excluded by the rules.
+     */
+    bool is_excluded(std::string_view name) const;
+
+    /**
+     * Returns a digest of the rules. It changes whenever a rule is added, removed or
+     * changed, but not when the rules are only reordered.
+     */
+    Hash128 digest() const;
+
+protected:
+    struct Rule
+    {
+        std::string pattern;
+        bool exclude;
+        bool prefix;
+    };
+
+    std::vector<Rule> m_rules;
+    bool m_has_include;
+
+    // Characters that occur in any pattern are mapped to classes 1..m_num_classes - 1,
+    // all others to class 0, which leads back to the root from every state. Patterns can
+    // use all 256 byte values, so there can be 257 classes.
+    uint16_t m_char_class[256];
+    uint32_t m_num_classes;
+
+    // Transitions of the automaton as a full table, state * m_num_classes + class
+    std::vector<uint32_t> m_transitions;
+
+    // Rules matching at each state, including those of its suffix states, in CSR form
+    std::vector<uint32_t> m_output_offsets;
+    std::vector<uint32_t> m_outputs;
+};
+
+}
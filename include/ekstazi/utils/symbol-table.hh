@@ -0,0 +1,87 @@
+#pragma once
+
+#include <string>
+#include <string_view>
+#include <deque>
+#include <unordered_map>
+#include <cstdint>
+
+namespace ekstazi
+{
+
+/**
+ * Dense identifier for an interned symbol (function or type name).
+ */
+using symbol_id = uint32_t;
+
+/**
+ * The symbol table interns demangled function and type names into dense
+ * integer ids. All graphs and function tables in ekstazi key on these ids,
+ * and the names themselves are only kept once, in the side string table
+ * held here, for output.
+ *
+ * Symbols can additionally be registered under the 64-bit GUID that LLVM
+ * computes for every global value. This lets the pass resolve a function to
+ * its id without demangling its name again. Since the dependency graph is
+ * built on demangled names, several GUIDs (e.g. the C1 and C2 constructor
+ * variants) may map to the same id.
+ *
+ * The table is process-wide so ids are comparable between the old and new
+ * dependency graphs, the type hierarchies and the function tables.
+ */
+class SymbolTable
+{
+public:
+    /**
+     * Id returned for symbols that have not been interned.
+     */
+    static symbol_id const invalid_id;
+
+    /**
+     * Returns the process-wide symbol table.
+     */
+    static SymbolTable & instance();
+
+    SymbolTable();
+
+    /**
+     * Returns the id of a name, interning it if it has not been seen yet.
+     */
+    symbol_id intern(std::string const & name);
+
+    /**
+     * Interns a name and registers it under the given LLVM GUID.
+     */
+    symbol_id intern(uint64_t guid, std::string const & name);
+
+    /**
+     * Returns the id of a name, or invalid_id if it was never interned.
+     */
+    symbol_id find(std::string const & name) const;
+
+    /**
+     * Returns the id registered for a GUID, or invalid_id if there is none.
+     */
+    symbol_id find_guid(uint64_t guid) const;
+
+    /**
+     * Returns the name of an interned symbol.
+     */
+    std::string const & name(symbol_id id) const;
+
+    /**
+     * Returns the number of interned symbols. Ids are always smaller than this.
+     */
+    uint32_t size() const;
+
+protected:
+    // Names indexed by id. A deque keeps the strings in place as it grows,
+    // so the views used as keys below stay valid.
+    std::deque<std::string> m_names;
+
+    std::unordered_map<std::string_view, symbol_id> m_ids;
+
+    std::unordered_map<uint64_t, symbol_id> m_guid_ids;
+};
+
+}
@@ -0,0 +1,70 @@
+#pragma once
+
+#include <vector>
+#include <queue>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <functional>
+#include <cstdint>
+#include <cstddef>
+
+namespace ekstazi
+{
+
+/**
+ * Fixed-size pool of worker threads.
+ */
+class ThreadPool
+{
+public:
+    /**
+     * Starts the given number of worker threads. A pool of size 0 or 1 runs all work on
+     * the calling thread.
+     */
+    explicit ThreadPool(uint32_t num_threads);
+    ~ThreadPool();
+
+    ThreadPool(ThreadPool const &) = delete;
+    ThreadPool & operator=(ThreadPool const &) = delete;
+
+    /**
+     * Returns the number of worker threads.
+     */
+    uint32_t size() const;
+
+    /**
+     * Submits a task to be run by one of the workers.
+     */
+    void submit(std::function<void()> task);
+
+    /**
+     * Waits until all submitted tasks have finished.
+     */
+    void wait();
+
+    /**
+     * Calls fn(begin, end) on disjoint chunks covering [0, n) across the workers and waits
+     * for all chunks to finish. Ranges of at most grain elements run on the calling thread.
+     */
+    void parallel_for(size_t n, std::function<void(size_t, size_t)> const & fn, size_t grain = 1024);
+
+protected:
+    /**
+     * Main loop of a worker thread.
+     */
+    void work();
+
+    std::vector<std::thread> m_workers;
+    std::queue<std::function<void()>> m_tasks;
+
+    std::mutex m_mutex;
+    std::condition_variable m_task_available;
+    std::condition_variable m_tasks_done;
+
+    // Number of tasks submitted but not finished yet
+    size_t m_pending;
+    bool m_stop;
+};
+
+}
@@ -0,0 +1,104 @@
+#pragma once
+
+#include "llvm/IR/Function.h"
+
+#include <vector>
+#include <string>
+#include <unordered_map>
+#include <unordered_set>
+#include <memory>
+#include <cstdint>
+
+#include "ekstazi/vtable/vtable.hh"
+#include "ekstazi/type-hierarchy/type-hierarchy.hh"
+#include "ekstazi/utils/symbol-table.hh"
+
+namespace ekstazi
+{
+
+/**
+ * Cache of the functions a virtual call may dispatch to, keyed by the class whose vtable
+ * the call goes through and the vtable slot.
+ *
+ * The vtables of a class and of all classes derived from it are collected the first time a
+ * call through the class is seen, and the targets of a (class, slot) pair the first time a
+ * call through it is seen. Every further call site is a single lookup instead of a
+ * traversal of the type hierarchy and a scan over the derived vtables, and classes that
+ * are never called through cost nothing.
+ *
+ * Calls can also be keyed by a type identifier from the !type metadata of the vtables
+ * (https://llvm.org/docs/TypeMetadata.html), as tested by llvm.type.test or loaded by
+ * llvm.type.checked.load at the call site. The call then goes through every address
+ * point compatible with the type identifier, including those of the vtables of
+ * non-primary and virtual bases, and only through those.
+ */
+class VirtualTargetCache
+{
+public:
+    using VTableMap = std::unordered_map<symbol_id, std::shared_ptr<VTable>>;
+
+    VirtualTargetCache();
+
+    /**
+     * Collects, for every type identifier, the address points compatible with it. The
+     * vtables and the type hierarchy must outlive the cache.
+     */
+    VirtualTargetCache(VTableMap const & vtables, TypeHierarchy & type_hierarchy);
+
+    /**
+     * Returns the functions a virtual call through the given slot of the class' vtable
+     * may dispatch to: the class' own entry and those of all derived classes, without
+     * duplicates and pure virtual functions. Returns no targets if the class has no
+     * vtable or the slot is out of its range.
+     */
+    std::vector<llvm::Function*> const & get_targets(symbol_id class_id, uint64_t index);
+
+    /**
+     * Returns whether any vtable is compatible with the type identifier, and the address
+     * points of all compatible vtables are known. Otherwise calls through the type
+     * identifier have to be resolved through the type hierarchy.
+     */
+    bool has_type_id(std::string const & type_id) const;
+
+    /**
+     * Returns the functions a virtual call through the given slot of an address point
+     * compatible with the type identifier may dispatch to, without duplicates and pure
+     * virtual functions. Returns no targets unless has_type_id holds.
+     */
+    std::vector<llvm::Function*> const & get_targets(std::string const & type_id, uint64_t index);
+
+protected:
+    /**
+     * Returns the closure of a class' own vtable followed by the vtables of all classes
+     * derived from it, collecting it on first use.
+     */
+    uint32_t get_class_closure(symbol_id class_id, VTable const * vtable);
+
+    /**
+     * Returns the targets of a call through the given slot of the entries of a closure.
+     */
+    std::vector<llvm::Function*> const & get_closure_targets(uint32_t closure, uint64_t index);
+
+    VTableMap const * m_vtables;
+    TypeHierarchy * m_type_hierarchy;
+
+    // Sets of vtable entries a call may go through, each from an address point on
+    std::vector<std::vector<std::vector<llvm::Function*> const *>> m_closures;
+
+    // Class -> closure of its own vtable, followed by the vtables of all derived classes.
+    // Only holds the classes called through so far.
+    std::unordered_map<symbol_id, uint32_t> m_class_closures;
+
+    // Type identifier -> closure of the address points compatible with it
+    std::unordered_map<std::string, uint32_t> m_type_closures;
+
+    // Type identifiers some vtable has at an offset that is not an address point
+    std::unordered_set<std::string> m_unresolved_type_ids;
+
+    // (closure << 32 | slot) -> targets of calls through the slot
+    std::unordered_map<uint64_t, std::vector<llvm::Function*>> m_targets;
+
+    std::vector<llvm::Function*> m_no_targets;
+};
+
+}
@@ -81,7 +81,35 @@ public:
 
     std::vector<llvm::Function*> const & get_vfuns() const;
 
+    /**
+     * Type identifiers from the !type metadata of the vtable, each with the index of the
+     * address point it is compatible with (see get_address_point_vfuns). A vtable group
+     * has one address point per vtable it holds, and a type can be compatible with any
+     * of them, e.g. with the vtable of a non-primary base. Empty unless the module was
+     * compiled with -fwhole-program-vtables.
+     */
+    std::vector<std::pair<std::string, uint32_t>> const & get_type_ids() const;
+
+    /**
+     * Type identifiers from the !type metadata whose offset is not an address point of
+     * any vtable in the group. Calls through them cannot be resolved from this vtable.
+     */
+    std::vector<std::string> const & get_unresolved_type_ids() const;
+
+    /**
+     * Returns the entries of a vtable from one of its address points on. Entries that
+     * are not functions are nullptr, so the index of an entry is its slot.
+     */
+    std::vector<llvm::Function*> const & get_address_point_vfuns(uint32_t address_point) const;
+
 protected:
+    /**
+     * Returns the index of the address point at the given byte offset into the vtable
+     * group, adding it on first use, or UINT32_MAX if the offset is not in any of its
+     * vtables.
+     */
+    uint32_t find_address_point(llvm::GlobalVariable* vt, uint64_t offset);
+
     // Name of the type that this vtable is for
     std::string m_name;
 
@@ -89,6 +117,14 @@ protected:
     std::string m_rtti;
 
     std::vector<llvm::Function*> m_vfuns;
+
+    // Entries from every address point named by the !type metadata, and the byte offset
+    // of each address point into the vtable group
+    std::vector<std::vector<llvm::Function*>> m_address_points;
+    std::vector<uint64_t> m_address_point_offsets;
+
+    std::vector<std::pair<std::string, uint32_t>> m_type_ids;
+    std::vector<std::string> m_unresolved_type_ids;
 };
 
 
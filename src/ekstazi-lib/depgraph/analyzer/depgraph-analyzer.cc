@@ -1,26 +1,57 @@
 #include <iostream>
 #include <string>
 #include <set>
+#include <fstream>
 
 #include "ekstazi/depgraph/analyzer/depgraph-analyzer.hh"
+#include "ekstazi/depgraph/depgraph-log.hh"
 #include "ekstazi/constants.hh"
 
 namespace ekstazi
 {
 
 DepgraphAnalyzer::DepgraphAnalyzer(std::string const & module_name)
-: module_name{ module_name }
+: module_name{ module_name },
+depgraph_union_built{ false }
 {
     this->module_name = module_name + ".0.5.precodegen.bc";
 }
 
 void DepgraphAnalyzer::load()
 {
-    std::string new_depgraph_fname = ekstazi::EKSTAZI_DIRNAME + "/" + module_name + "." + ekstazi::DEPGRAPH_FNAME;
-    new_depgraph.load_file(new_depgraph_fname);
+    // Prefer the binary image if the pass was run with -binary-depgraph
+    std::string new_depgraph_fname = ekstazi::EKSTAZI_DIRNAME + "/" + module_name + "." + ekstazi::DEPGRAPH_IMAGE_FNAME;
+    if (!std::ifstream{ new_depgraph_fname })
+    {
+        new_depgraph_fname = ekstazi::EKSTAZI_DIRNAME + "/" + module_name + "." + ekstazi::DEPGRAPH_FNAME;
+    }
+
+    // With -depgraph-log the file above is only the base snapshot, and both
+    // graphs are rebuilt from it and the log
+    std::string depgraph_log_fname = ekstazi::EKSTAZI_DIRNAME + "/" + module_name + "." + ekstazi::DEPGRAPH_LOG_FNAME;
+    if (std::ifstream{ depgraph_log_fname })
+    {
+        ekstazi::DepgraphLog{ new_depgraph_fname, depgraph_log_fname }.load(old_depgraph, new_depgraph);
+    }
+    else
+    {
+        new_depgraph.load_file(new_depgraph_fname);
 
-    std::string old_depgraph_fname = new_depgraph_fname + '.' + ekstazi::OLD_SUFFIX;
-    old_depgraph.load_file(old_depgraph_fname);
+        std::string old_depgraph_fname = new_depgraph_fname + '.' + ekstazi::OLD_SUFFIX;
+        old_depgraph.load_file(old_depgraph_fname);
+    }
+
+    // The union view needs both graphs frozen, and is only built on the
+    // first query for dependents
+    if (!new_depgraph.is_frozen())
+    {
+        new_depgraph.freeze();
+    }
+    if (!old_depgraph.is_frozen())
+    {
+        old_depgraph.freeze();
+    }
+    depgraph_union_built = false;
 
     std::string new_functions_fname = ekstazi::EKSTAZI_DIRNAME + '/' + module_name + '.' + ekstazi::FUNCTIONS_FNAME;
     new_functions = ekstazi::Function::load_file(new_functions_fname);
@@ -30,16 +61,32 @@ void DepgraphAnalyzer::load()
 }
 
 /**
- * Get all of the functions that depend on a function.
+ * Get all of the functions that depend on a function in either the old
+ * or the new dependency graph. Without an old graph these are just the
+ * dependents in the new one. The union view is built once and reused
+ * by later queries.
  */
 std::unordered_set<std::string> DepgraphAnalyzer::get_dependents(std::string const & fun_name)
 {
-    if (old_depgraph.empty())
+    if (!depgraph_union_built)
+    {
+        depgraph_union = ekstazi::DepgraphUnion{ old_depgraph.get_frozen_graph(), new_depgraph.get_frozen_graph() };
+        depgraph_union_built = true;
+    }
+
+    SymbolTable const & symbols = SymbolTable::instance();
+    symbol_id fun = symbols.find(fun_name);
+    if (fun == SymbolTable::invalid_id)
+    {
+        return {};
+    }
+
+    std::unordered_set<std::string> dependents;
+    for (symbol_id dependent : depgraph_union.get_all_dependents(fun))
     {
-        std::cout << "Warning: no old dependency graph detected. Returning new dependents" << std::endl;
-        return new_depgraph.get_all_dependents(fun_name);
+        dependents.insert(symbols.name(dependent));
     }
-    return old_depgraph.get_all_dependents(fun_name);
+    return dependents;
 }
 
 /**
@@ -50,11 +97,9 @@ std::unordered_set<std::string> DepgraphAnalyzer::get_dependencies(std::string c
     if (old_depgraph.empty())
     {
         std::cout << "Warning: no old dependency graph detected. Returning new dependencies" << std::endl;
-        ekstazi::DependencyGraph reversed = new_depgraph.reverse();
-        return reversed.get_all_dependents(fun_name);
+        return new_depgraph.get_all_dependencies(fun_name);
     }
-    ekstazi::DependencyGraph reversed = old_depgraph.reverse();
-    return reversed.get_all_dependents(fun_name);
+    return old_depgraph.get_all_dependencies(fun_name);
 }
 
 
@@ -0,0 +1,320 @@
+#include "ekstazi/depgraph/condensed-graph.hh"
+
+#include <algorithm>
+
+namespace ekstazi
+{
+
+/**
+ * Number of queries after which the closure of a component is memoized.
+ */
+uint32_t const CondensedGraph::hot_threshold = 2;
+
+/**
+ * Maximum number of components held by all memoized closures together,
+ * i.e. 64 MiB of closures.
+ */
+size_t const CondensedGraph::closure_capacity = size_t{ 1 } << 24;
+
+CondensedGraph::CondensedGraph() :
+m_components{},
+m_member_offsets{ 0 },
+m_members{},
+m_successor_offsets{ 0 },
+m_successors{},
+m_closures{},
+m_num_memoized{ 0 },
+m_queries{},
+m_visited{},
+m_queue{}
+{
+
+}
+
+/**
+ * Condenses a frozen dependency graph.
+ */
+CondensedGraph::CondensedGraph(CsrGraph const & graph) :
+CondensedGraph()
+{
+    uint32_t n = graph.num_nodes();
+    std::vector<uint32_t> components;
+    uint32_t num_components = graph.strongly_connected_components(components);
+
+    // Group the members by component
+    m_member_offsets.assign(num_components + 1, 0);
+    symbol_id max_symbol = 0;
+    for (uint32_t i = 0; i < n; ++i)
+    {
+        ++m_member_offsets[components[i] + 1];
+        max_symbol = std::max(max_symbol, graph.symbol_of(i));
+    }
+    for (uint32_t c = 0; c < num_components; ++c)
+    {
+        m_member_offsets[c + 1] += m_member_offsets[c];
+    }
+
+    m_members.resize(n);
+    m_components.assign(n == 0 ? 0 : max_symbol + 1, CsrGraph::invalid_index);
+    std::vector<uint32_t> member_nodes(n);
+    std::vector<uint32_t> fill{ m_member_offsets.begin(), m_member_offsets.end() - 1 };
+    for (uint32_t i = 0; i < n; ++i)
+    {
+        uint32_t pos = fill[components[i]]++;
+        member_nodes[pos] = i;
+        m_members[pos] = graph.symbol_of(i);
+        m_components[graph.symbol_of(i)] = components[i];
+    }
+
+    // Collect the edges between components, dropping edges inside a
+    // component and duplicate edges between the same two components
+    std::vector<uint32_t> const & edges = graph.edges();
+    std::vector<uint32_t> last_seen(num_components, CsrGraph::invalid_index);
+    m_successor_offsets.assign(num_components + 1, 0);
+    for (uint32_t c = 0; c < num_components; ++c)
+    {
+        for (uint32_t k = m_member_offsets[c]; k < m_member_offsets[c + 1]; ++k)
+        {
+            uint32_t node = member_nodes[k];
+            for (uint32_t e = graph.begin(node); e < graph.begin(node + 1); ++e)
+            {
+                uint32_t dependent_component = components[edges[e]];
+                if (dependent_component == c || last_seen[dependent_component] == c)
+                {
+                    continue;
+                }
+                last_seen[dependent_component] = c;
+                m_successors.push_back(dependent_component);
+            }
+        }
+        m_successor_offsets[c + 1] = m_successors.size();
+        std::sort(m_successors.begin() + m_successor_offsets[c], m_successors.end());
+    }
+
+    m_queries.assign(num_components, 0);
+    m_visited.assign((num_components + 63) / 64, 0);
+    m_queue.reserve(num_components);
+}
+
+/**
+ * Returns the number of components.
+ */
+uint32_t CondensedGraph::num_components() const
+{
+    return m_member_offsets.size() - 1;
+}
+
+/**
+ * Returns the component of a symbol, or CsrGraph::invalid_index if the
+ * symbol is not in the graph.
+ */
+uint32_t CondensedGraph::component_of(symbol_id symbol) const
+{
+    if (symbol >= m_components.size())
+    {
+        return CsrGraph::invalid_index;
+    }
+    return m_components[symbol];
+}
+
+/**
+ * Returns whether or not a component is a cycle. Self dependencies are
+ * never added to the graph, so only components with several members
+ * are cycles.
+ */
+bool CondensedGraph::is_cyclic(uint32_t component) const
+{
+    return m_member_offsets[component + 1] - m_member_offsets[component] > 1;
+}
+
+/**
+ * Returns the offset of the first member of a component in the member array.
+ */
+uint32_t CondensedGraph::member_begin(uint32_t component) const
+{
+    return m_member_offsets[component];
+}
+
+/**
+ * Returns the members of all components.
+ */
+std::vector<symbol_id> const & CondensedGraph::members() const
+{
+    return m_members;
+}
+
+/**
+ * Returns the offset of the first successor of a component in the successor array.
+ */
+uint32_t CondensedGraph::successor_begin(uint32_t component) const
+{
+    return m_successor_offsets[component];
+}
+
+/**
+ * Returns the successors (dependent components) of all components.
+ */
+std::vector<uint32_t> const & CondensedGraph::successors() const
+{
+    return m_successors;
+}
+
+/**
+ * Appends the components reachable from the given components to the
+ * given vector. A start component is only included if it is reachable
+ * from another start component.
+ *
+ * Components with a memoized closure are not expanded: their closure
+ * is added as a whole, since it already contains everything reachable
+ * through them.
+ */
+void CondensedGraph::reachable_components(std::vector<uint32_t> const & start_components, std::vector<uint32_t> & reached) const
+{
+    size_t first_reached = reached.size();
+
+    auto visit = [this, &reached](uint32_t component) {
+        uint64_t mask = uint64_t{ 1 } << (component % 64);
+        if (m_visited[component / 64] & mask)
+        {
+            return false;
+        }
+        m_visited[component / 64] |= mask;
+        reached.push_back(component);
+        return true;
+    };
+
+    m_queue.assign(start_components.begin(), start_components.end());
+    for (size_t head = 0; head < m_queue.size(); ++head)
+    {
+        uint32_t cur_component = m_queue[head];
+
+        auto closure = m_closures.find(cur_component);
+        if (closure != m_closures.end())
+        {
+            for (uint32_t dependent : closure->second)
+            {
+                visit(dependent);
+            }
+            continue;
+        }
+
+        for (uint32_t i = m_successor_offsets[cur_component]; i < m_successor_offsets[cur_component + 1]; ++i)
+        {
+            if (visit(m_successors[i]))
+            {
+                m_queue.push_back(m_successors[i]);
+            }
+        }
+    }
+
+    for (size_t i = first_reached; i < reached.size(); ++i)
+    {
+        m_visited[reached[i] / 64] = 0;
+    }
+}
+
+/**
+ * Returns all components reachable from the given component, not
+ * including the component itself. The closure is memoized once the
+ * component has been queried hot_threshold times. If the memoized
+ * closures would then exceed closure_capacity, other closures are
+ * evicted first.
+ */
+std::vector<uint32_t> CondensedGraph::get_closure(uint32_t component) const
+{
+    auto it = m_closures.find(component);
+    if (it != m_closures.end())
+    {
+        return it->second;
+    }
+
+    std::vector<uint32_t> closure;
+    reachable_components(std::vector<uint32_t>{ component }, closure);
+
+    if (++m_queries[component] >= hot_threshold && closure.size() <= closure_capacity)
+    {
+        while (m_num_memoized + closure.size() > closure_capacity)
+        {
+            m_num_memoized -= m_closures.begin()->second.size();
+            m_closures.erase(m_closures.begin());
+        }
+        m_num_memoized += closure.size();
+        m_closures.insert({ component, closure });
+    }
+
+    return closure;
+}
+
+/**
+ * Finds the union of all dependents of the given start nodes and
+ * appends them to the given vector. The members of every reachable
+ * component are dependents, and so are the members of a start node's
+ * own component if that component is a cycle.
+ */
+void CondensedGraph::get_all_dependents(std::vector<symbol_id> const & start_nodes, std::vector<symbol_id> & dependents) const
+{
+    std::vector<uint32_t> start_components;
+    for (symbol_id start_node : start_nodes)
+    {
+        uint32_t component = component_of(start_node);
+        if (component != CsrGraph::invalid_index)
+        {
+            start_components.push_back(component);
+        }
+    }
+
+    std::vector<uint32_t> reached;
+    if (start_components.size() == 1)
+    {
+        reached = get_closure(start_components.front());
+    }
+    else
+    {
+        reachable_components(start_components, reached);
+    }
+
+    // Cyclic start components depend on themselves, but are only part
+    // of the reached components if another start component reaches them
+    for (uint32_t component : reached)
+    {
+        m_visited[component / 64] |= uint64_t{ 1 } << (component % 64);
+    }
+    for (uint32_t component : start_components)
+    {
+        uint64_t mask = uint64_t{ 1 } << (component % 64);
+        if (is_cyclic(component) && !(m_visited[component / 64] & mask))
+        {
+            m_visited[component / 64] |= mask;
+            reached.push_back(component);
+        }
+    }
+    for (uint32_t component : reached)
+    {
+        m_visited[component / 64] = 0;
+    }
+
+    for (uint32_t component : reached)
+    {
+        dependents.insert(dependents.end(), m_members.begin() + m_member_offsets[component], m_members.begin() + m_member_offsets[component + 1]);
+    }
+}
+
+/**
+ * Finds all dependents for the given start node.
+ */
+std::unordered_set<symbol_id> CondensedGraph::get_all_dependents(symbol_id start_node) const
+{
+    return get_all_dependents(std::vector<symbol_id>{ start_node });
+}
+
+/**
+ * Finds the union of all dependents of the given start nodes.
+ */
+std::unordered_set<symbol_id> CondensedGraph::get_all_dependents(std::vector<symbol_id> const & start_nodes) const
+{
+    std::vector<symbol_id> dependents;
+    get_all_dependents(start_nodes, dependents);
+    return std::unordered_set<symbol_id>(dependents.begin(), dependents.end());
+}
+
+}
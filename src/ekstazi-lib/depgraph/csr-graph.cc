@@ -0,0 +1,551 @@
+#include "ekstazi/depgraph/csr-graph.hh"
+#include "ekstazi/utils/parallel-bfs.hh"
+
+#include <algorithm>
+#include <limits>
+#include <mutex>
+
+namespace ekstazi
+{
+
+/**
+ * Index returned for symbols that are not part of the graph.
+ */
+uint32_t const CsrGraph::invalid_index = std::numeric_limits<uint32_t>::max();
+
+/**
+ * Minimum number of nodes for which traversals with a thread pool are
+ * worth it. Below this, synchronizing the levels costs more than the
+ * traversal itself.
+ */
+uint32_t const CsrGraph::parallel_threshold = 1 << 16;
+
+/**
+ * A level is expanded bottom-up once the frontier holds more than this
+ * fraction of all nodes, since most edges of the frontier then lead to
+ * nodes that are already visited.
+ */
+static uint32_t const bottom_up_divisor = 20;
+
+/**
+ * Reverses the edges of a graph in CSR form with a counting sort, keeping
+ * the node numbering. The sources of every node end up sorted.
+ */
+static void transpose_edges(std::vector<uint32_t> const & offsets, std::vector<uint32_t> const & edges, std::vector<uint32_t> & reverse_offsets, std::vector<uint32_t> & reverse_edges)
+{
+    uint32_t n = offsets.size() - 1;
+    reverse_offsets.assign(n + 1, 0);
+    for (uint32_t dependent : edges)
+    {
+        ++reverse_offsets[dependent + 1];
+    }
+    for (uint32_t i = 0; i < n; ++i)
+    {
+        reverse_offsets[i + 1] += reverse_offsets[i];
+    }
+
+    reverse_edges.resize(edges.size());
+    std::vector<uint32_t> fill{ reverse_offsets.begin(), reverse_offsets.end() - 1 };
+    for (uint32_t i = 0; i < n; ++i)
+    {
+        for (uint32_t e = offsets[i]; e < offsets[i + 1]; ++e)
+        {
+            reverse_edges[fill[edges[e]]++] = i;
+        }
+    }
+}
+
+CsrGraph::CsrGraph() :
+m_offsets{ 0 },
+m_edges{},
+m_symbols{},
+m_indices{},
+m_visited{},
+m_queue{},
+m_reverse_offsets{},
+m_reverse_edges{}
+{
+
+}
+
+/**
+ * Builds the CSR graph from an adjacency list.
+ */
+CsrGraph::CsrGraph(AdjacencyList const & adj_list) :
+CsrGraph()
+{
+    number_nodes(adj_list);
+
+    uint32_t n = m_symbols.size();
+    m_offsets.assign(n + 1, 0);
+
+    // Count the dependents of every node first, then fill in the edges
+    for (uint32_t i = 0; i < n; ++i)
+    {
+        auto it = adj_list.find(m_symbols[i]);
+        m_offsets[i + 1] = m_offsets[i] + (it == adj_list.end() ? 0 : it->second.size());
+    }
+
+    m_edges.resize(m_offsets[n]);
+    for (uint32_t i = 0; i < n; ++i)
+    {
+        auto it = adj_list.find(m_symbols[i]);
+        if (it == adj_list.end())
+        {
+            continue;
+        }
+
+        uint32_t pos = m_offsets[i];
+        for (symbol_id dependent : it->second)
+        {
+            m_edges[pos++] = m_indices[dependent];
+        }
+        // Sorted dependents give a sequential access pattern when traversing
+        std::sort(m_edges.begin() + m_offsets[i], m_edges.begin() + pos);
+    }
+
+    m_visited.assign((n + 63) / 64, 0);
+    m_queue.reserve(n);
+}
+
+/**
+ * Builds the CSR graph from arrays that are already in CSR form, e.g.
+ * from a saved image. symbols[i] is the symbol of node i.
+ */
+CsrGraph::CsrGraph(std::vector<symbol_id> symbols, std::vector<uint32_t> offsets, std::vector<uint32_t> edges) :
+m_offsets{ std::move(offsets) },
+m_edges{ std::move(edges) },
+m_symbols{ std::move(symbols) },
+m_indices{},
+m_visited{},
+m_queue{},
+m_reverse_offsets{},
+m_reverse_edges{}
+{
+    uint32_t n = m_symbols.size();
+    symbol_id max_symbol = 0;
+    for (symbol_id symbol : m_symbols)
+    {
+        max_symbol = std::max(max_symbol, symbol);
+    }
+
+    m_indices.assign(n == 0 ? 0 : max_symbol + 1, invalid_index);
+    for (uint32_t i = 0; i < n; ++i)
+    {
+        m_indices[m_symbols[i]] = i;
+    }
+
+    m_visited.assign((n + 63) / 64, 0);
+    m_queue.reserve(n);
+}
+
+/**
+ * Assigns node indices in breadth-first order from the roots of the
+ * graph. Nodes only reachable through cycles are numbered afterwards.
+ */
+void CsrGraph::number_nodes(AdjacencyList const & adj_list)
+{
+    // Collect every node and whether it has any incoming edge
+    std::vector<symbol_id> nodes;
+    std::unordered_set<symbol_id> has_incoming;
+    symbol_id max_symbol = 0;
+    for (auto const & p : adj_list)
+    {
+        nodes.push_back(p.first);
+        max_symbol = std::max(max_symbol, p.first);
+        for (symbol_id dependent : p.second)
+        {
+            has_incoming.insert(dependent);
+            max_symbol = std::max(max_symbol, dependent);
+        }
+    }
+    for (symbol_id dependent : has_incoming)
+    {
+        if (adj_list.find(dependent) == adj_list.end())
+        {
+            nodes.push_back(dependent);
+        }
+    }
+
+    // Sort so the numbering does not depend on hash map iteration order
+    std::sort(nodes.begin(), nodes.end());
+    std::stable_partition(nodes.begin(), nodes.end(), [&has_incoming](symbol_id node) {
+        return has_incoming.find(node) == has_incoming.end();
+    });
+
+    m_indices.assign(nodes.empty() ? 0 : max_symbol + 1, invalid_index);
+    m_symbols.reserve(nodes.size());
+
+    std::vector<symbol_id> visit_queue;
+    visit_queue.reserve(nodes.size());
+    for (symbol_id root : nodes)
+    {
+        if (m_indices[root] != invalid_index)
+        {
+            continue;
+        }
+
+        visit_queue.clear();
+        visit_queue.push_back(root);
+        m_indices[root] = m_symbols.size();
+        m_symbols.push_back(root);
+
+        for (size_t head = 0; head < visit_queue.size(); ++head)
+        {
+            auto it = adj_list.find(visit_queue[head]);
+            if (it == adj_list.end())
+            {
+                continue;
+            }
+            for (symbol_id dependent : it->second)
+            {
+                if (m_indices[dependent] == invalid_index)
+                {
+                    m_indices[dependent] = m_symbols.size();
+                    m_symbols.push_back(dependent);
+                    visit_queue.push_back(dependent);
+                }
+            }
+        }
+    }
+}
+
+/**
+ * Returns the number of nodes in the graph.
+ */
+uint32_t CsrGraph::num_nodes() const
+{
+    return m_symbols.size();
+}
+
+/**
+ * Returns the number of edges in the graph.
+ */
+uint32_t CsrGraph::num_edges() const
+{
+    return m_edges.size();
+}
+
+/**
+ * Returns the node index of a symbol, or invalid_index if the symbol
+ * is not in the graph.
+ */
+uint32_t CsrGraph::index_of(symbol_id symbol) const
+{
+    if (symbol >= m_indices.size())
+    {
+        return invalid_index;
+    }
+    return m_indices[symbol];
+}
+
+/**
+ * Returns the symbol of a node index.
+ */
+symbol_id CsrGraph::symbol_of(uint32_t index) const
+{
+    return m_symbols[index];
+}
+
+/**
+ * Returns the offset of the first dependent of a node in the edge array.
+ */
+uint32_t CsrGraph::begin(uint32_t index) const
+{
+    return m_offsets[index];
+}
+
+/**
+ * Returns the dependents of all nodes, as node indices.
+ */
+std::vector<uint32_t> const & CsrGraph::edges() const
+{
+    return m_edges;
+}
+
+/**
+ * Returns the graph with all edges reversed. Nodes keep their indices.
+ */
+CsrGraph CsrGraph::transpose() const
+{
+    std::vector<uint32_t> reverse_offsets;
+    std::vector<uint32_t> reverse_edges;
+    transpose_edges(m_offsets, m_edges, reverse_offsets, reverse_edges);
+    return CsrGraph{ m_symbols, std::move(reverse_offsets), std::move(reverse_edges) };
+}
+
+/**
+ * Computes the strongly connected components of the graph with
+ * Tarjan's algorithm. Tarjan's algorithm completes a component only
+ * after all components reachable from it, so numbering components in
+ * completion order gives a reverse topological order.
+ *
+ * The search is iterative, since call chains in large programs are
+ * deep enough to overflow the stack with a recursive search.
+ */
+uint32_t CsrGraph::strongly_connected_components(std::vector<uint32_t> & components) const
+{
+    uint32_t n = num_nodes();
+    components.assign(n, invalid_index);
+
+    std::vector<uint32_t> order(n, invalid_index);
+    std::vector<uint32_t> low(n, 0);
+    std::vector<bool> on_stack(n, false);
+    std::vector<uint32_t> scc_stack;
+
+    // Call stack of (node, position of the next edge to visit)
+    std::vector<std::pair<uint32_t, uint32_t>> call_stack;
+
+    uint32_t next_order = 0;
+    uint32_t num_components = 0;
+    for (uint32_t root = 0; root < n; ++root)
+    {
+        if (order[root] != invalid_index)
+        {
+            continue;
+        }
+
+        call_stack.push_back({ root, m_offsets[root] });
+        order[root] = low[root] = next_order++;
+        scc_stack.push_back(root);
+        on_stack[root] = true;
+
+        while (!call_stack.empty())
+        {
+            uint32_t node = call_stack.back().first;
+            uint32_t & pos = call_stack.back().second;
+
+            if (pos < m_offsets[node + 1])
+            {
+                uint32_t dependent = m_edges[pos++];
+                if (order[dependent] == invalid_index)
+                {
+                    // Descend into the dependent
+                    order[dependent] = low[dependent] = next_order++;
+                    scc_stack.push_back(dependent);
+                    on_stack[dependent] = true;
+                    call_stack.push_back({ dependent, m_offsets[dependent] });
+                }
+                else if (on_stack[dependent])
+                {
+                    low[node] = std::min(low[node], order[dependent]);
+                }
+                continue;
+            }
+
+            // All dependents visited, so check whether node is the root of a component
+            call_stack.pop_back();
+            if (!call_stack.empty())
+            {
+                uint32_t parent = call_stack.back().first;
+                low[parent] = std::min(low[parent], low[node]);
+            }
+
+            if (low[node] != order[node])
+            {
+                continue;
+            }
+
+            uint32_t member;
+            do
+            {
+                member = scc_stack.back();
+                scc_stack.pop_back();
+                on_stack[member] = false;
+                components[member] = num_components;
+            } while (member != node);
+            ++num_components;
+        }
+    }
+
+    return num_components;
+}
+
+/**
+ * Finds all dependents for the given start node and appends them to
+ * the given vector. The start node is only included if it depends on
+ * itself through a cycle.
+ */
+void CsrGraph::get_all_dependents(symbol_id start_node, std::vector<symbol_id> & dependents) const
+{
+    get_all_dependents(std::vector<symbol_id>{ start_node }, dependents);
+}
+
+/**
+ * Finds all dependents for the given start node.
+ */
+std::unordered_set<symbol_id> CsrGraph::get_all_dependents(symbol_id start_node) const
+{
+    return get_all_dependents(std::vector<symbol_id>{ start_node });
+}
+
+/**
+ * Finds the union of all dependents of the given start nodes with a
+ * single traversal and appends them to the given vector. A start node
+ * is only included if it depends on one of the start nodes.
+ */
+void CsrGraph::get_all_dependents(std::vector<symbol_id> const & start_nodes, std::vector<symbol_id> & dependents) const
+{
+    // Conduct a breadth-first search from all start nodes at once. The
+    // queue doubles as the list of visited nodes, which is used to clear
+    // the bitmap afterwards.
+    m_queue.clear();
+    for (symbol_id start_node : start_nodes)
+    {
+        uint32_t start = index_of(start_node);
+        if (start != invalid_index)
+        {
+            m_queue.push_back(start);
+        }
+    }
+
+    for (size_t head = 0; head < m_queue.size(); ++head)
+    {
+        uint32_t cur_node = m_queue[head];
+        for (uint32_t i = m_offsets[cur_node]; i < m_offsets[cur_node + 1]; ++i)
+        {
+            uint32_t dependent = m_edges[i];
+            uint64_t mask = uint64_t{ 1 } << (dependent % 64);
+            if (m_visited[dependent / 64] & mask)
+            {
+                continue;
+            }
+            m_visited[dependent / 64] |= mask;
+            dependents.push_back(m_symbols[dependent]);
+            m_queue.push_back(dependent);
+        }
+    }
+
+    for (uint32_t node : m_queue)
+    {
+        m_visited[node / 64] = 0;
+    }
+}
+
+/**
+ * Finds the union of all dependents of the given start nodes with a
+ * single traversal.
+ */
+std::unordered_set<symbol_id> CsrGraph::get_all_dependents(std::vector<symbol_id> const & start_nodes) const
+{
+    std::vector<symbol_id> dependents;
+    get_all_dependents(start_nodes, dependents);
+    return std::unordered_set<symbol_id>(dependents.begin(), dependents.end());
+}
+
+/**
+ * Finds the union of all dependents of the given start nodes with a
+ * level-synchronous parallel traversal on the given pool. Every level
+ * is expanded either top-down, with the frontier split across the
+ * pool, or bottom-up once the frontier is large, with the unvisited
+ * nodes split across the pool (direction-optimizing search).
+ */
+void CsrGraph::get_all_dependents(ThreadPool & pool, std::vector<symbol_id> const & start_nodes, std::vector<symbol_id> & dependents) const
+{
+    uint32_t n = num_nodes();
+    std::vector<uint32_t> frontier;
+    for (symbol_id start_node : start_nodes)
+    {
+        uint32_t start = index_of(start_node);
+        if (start != invalid_index)
+        {
+            frontier.push_back(start);
+        }
+    }
+
+    auto for_each_dependent = [this](uint32_t node, auto const & visit) {
+        for (uint32_t i = m_offsets[node]; i < m_offsets[node + 1]; ++i)
+        {
+            visit(m_edges[i]);
+        }
+    };
+
+    m_queue.clear();
+    std::vector<uint32_t> next;
+    while (!frontier.empty())
+    {
+        next.clear();
+        if (static_cast<uint64_t>(frontier.size()) * bottom_up_divisor > n)
+        {
+            expand_bottom_up(pool, frontier, next);
+        }
+        else
+        {
+            expand_top_down(pool, frontier, m_visited, next, for_each_dependent);
+        }
+        m_queue.insert(m_queue.end(), next.begin(), next.end());
+        frontier.swap(next);
+    }
+
+    for (uint32_t node : m_queue)
+    {
+        dependents.push_back(m_symbols[node]);
+        m_visited[node / 64] = 0;
+    }
+}
+
+/**
+ * Builds the reverse edges used by bottom-up levels of parallel
+ * traversals, keeping the node numbering.
+ */
+void CsrGraph::build_reverse_edges() const
+{
+    transpose_edges(m_offsets, m_edges, m_reverse_offsets, m_reverse_edges);
+}
+
+/**
+ * Expands one level bottom-up. The bitmap words are split across the
+ * pool, so every word of the visited bitmap is only written by one
+ * thread and needs no atomic updates.
+ */
+void CsrGraph::expand_bottom_up(ThreadPool & pool, std::vector<uint32_t> const & frontier, std::vector<uint32_t> & next) const
+{
+    if (m_reverse_offsets.size() != m_offsets.size())
+    {
+        build_reverse_edges();
+    }
+
+    uint32_t n = num_nodes();
+    std::vector<uint64_t> in_frontier(m_visited.size(), 0);
+    for (uint32_t node : frontier)
+    {
+        in_frontier[node / 64] |= uint64_t{ 1 } << (node % 64);
+    }
+
+    std::mutex next_mutex;
+    pool.parallel_for(m_visited.size(), [&](size_t begin, size_t end) {
+        std::vector<uint32_t> local_next;
+        for (size_t word = begin; word < end; ++word)
+        {
+            for (uint32_t bit = 0; bit < 64; ++bit)
+            {
+                uint32_t node = word * 64 + bit;
+                if (node >= n)
+                {
+                    break;
+                }
+                uint64_t mask = uint64_t{ 1 } << bit;
+                if (m_visited[word] & mask)
+                {
+                    continue;
+                }
+
+                for (uint32_t i = m_reverse_offsets[node]; i < m_reverse_offsets[node + 1]; ++i)
+                {
+                    uint32_t dependency = m_reverse_edges[i];
+                    if (in_frontier[dependency / 64] & (uint64_t{ 1 } << (dependency % 64)))
+                    {
+                        m_visited[word] |= mask;
+                        local_next.push_back(node);
+                        break;
+                    }
+                }
+            }
+        }
+
+        std::lock_guard<std::mutex> lock{ next_mutex };
+        next.insert(next.end(), local_next.begin(), local_next.end());
+    }, PARALLEL_BFS_GRAIN / 64);
+}
+
+}
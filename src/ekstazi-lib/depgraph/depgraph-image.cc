@@ -0,0 +1,223 @@
+#include "ekstazi/depgraph/depgraph-image.hh"
+
+#include <fstream>
+#include <vector>
+#include <cstring>
+
+namespace ekstazi
+{
+
+namespace
+{
+
+char const magic[4] = { 'E', 'K', 'D', 'G' };
+
+/**
+ * Fixed header at the start of every image.
+ */
+struct ImageHeader
+{
+    char magic[4];
+    uint32_t version;
+    uint32_t num_nodes;
+    uint32_t num_edges;
+    uint32_t names_size;
+    uint32_t reserved;
+};
+
+/**
+ * Returns the size of an image with the given header.
+ */
+uint64_t image_size(ImageHeader const & header)
+{
+    uint64_t num_nodes = header.num_nodes;
+    return sizeof(ImageHeader)
+        + sizeof(uint32_t) * (2 * (num_nodes + 1 + header.num_edges) + num_nodes + 1)
+        + header.names_size;
+}
+
+template <typename T>
+void write_vector(std::ofstream & ofs, std::vector<T> const & v)
+{
+    ofs.write(reinterpret_cast<char const *>(v.data()), v.size() * sizeof(T));
+}
+
+template <typename T>
+bool read_vector(std::ifstream & ifs, std::vector<T> & v, size_t size)
+{
+    v.resize(size);
+    return static_cast<bool>(ifs.read(reinterpret_cast<char*>(v.data()), v.size() * sizeof(T)));
+}
+
+/**
+ * Returns whether or not offsets start at 0, never decrease and end at
+ * the given size.
+ */
+bool valid_offsets(std::vector<uint32_t> const & offsets, uint32_t size)
+{
+    if (offsets.front() != 0 || offsets.back() != size)
+    {
+        return false;
+    }
+    for (size_t i = 1; i < offsets.size(); ++i)
+    {
+        if (offsets[i] < offsets[i - 1])
+        {
+            return false;
+        }
+    }
+    return true;
+}
+
+/**
+ * Returns whether or not all edges point to a node of the graph.
+ */
+bool valid_edges(std::vector<uint32_t> const & edges, uint32_t num_nodes)
+{
+    for (uint32_t edge : edges)
+    {
+        if (edge >= num_nodes)
+        {
+            return false;
+        }
+    }
+    return true;
+}
+
+}
+
+/**
+ * Current version of the image format.
+ */
+uint32_t const DepgraphImage::version = 1;
+
+/**
+ * Returns whether or not a file starts with the image magic.
+ */
+bool DepgraphImage::is_image(std::string const & fname)
+{
+    std::ifstream ifs{ fname, std::ios::binary };
+    char file_magic[sizeof(magic)];
+    if (!ifs.read(file_magic, sizeof(file_magic)))
+    {
+        return false;
+    }
+    return std::memcmp(file_magic, magic, sizeof(magic)) == 0;
+}
+
+/**
+ * Writes a frozen dependency graph to a file in the image format. The
+ * node numbering of the CSR graph is kept, so an image loads back into
+ * the same layout.
+ */
+bool DepgraphImage::write(CsrGraph const & graph, std::string const & fname)
+{
+    SymbolTable const & symbols = SymbolTable::instance();
+    uint32_t n = graph.num_nodes();
+
+    std::vector<uint32_t> offsets(n + 1);
+    for (uint32_t i = 0; i <= n; ++i)
+    {
+        offsets[i] = graph.begin(i);
+    }
+
+    // The reverse section keeps the numbering of the graph
+    CsrGraph reversed_graph = graph.transpose();
+    std::vector<uint32_t> reverse_offsets(n + 1);
+    for (uint32_t i = 0; i <= n; ++i)
+    {
+        reverse_offsets[i] = reversed_graph.begin(i);
+    }
+
+    std::string names;
+    std::vector<uint32_t> name_offsets(n + 1, 0);
+    for (uint32_t i = 0; i < n; ++i)
+    {
+        names += symbols.name(graph.symbol_of(i));
+        name_offsets[i + 1] = names.size();
+    }
+
+    ImageHeader header{};
+    std::memcpy(header.magic, magic, sizeof(magic));
+    header.version = version;
+    header.num_nodes = n;
+    header.num_edges = graph.num_edges();
+    header.names_size = names.size();
+
+    std::ofstream ofs{ fname, std::ios::binary };
+    ofs.write(reinterpret_cast<char const *>(&header), sizeof(header));
+    write_vector(ofs, offsets);
+    write_vector(ofs, graph.edges());
+    write_vector(ofs, reverse_offsets);
+    write_vector(ofs, reversed_graph.edges());
+    write_vector(ofs, name_offsets);
+    ofs.write(names.data(), names.size());
+    ofs.close();
+
+    return static_cast<bool>(ofs);
+}
+
+/**
+ * Reads an image into a frozen dependency graph and its reverse. Every
+ * section is read straight into the arrays the graphs keep, and checked
+ * before the node names are interned, so a truncated or corrupt image
+ * is rejected instead of being traversed out of bounds.
+ */
+bool DepgraphImage::read(std::string const & fname, CsrGraph & graph, CsrGraph & reverse_graph)
+{
+    std::ifstream ifs{ fname, std::ios::binary | std::ios::ate };
+    if (!ifs)
+    {
+        return false;
+    }
+    uint64_t file_size = ifs.tellg();
+    ifs.seekg(0);
+
+    ImageHeader header;
+    if (!ifs.read(reinterpret_cast<char*>(&header), sizeof(header))
+        || std::memcmp(header.magic, magic, sizeof(magic)) != 0
+        || header.version != version
+        || image_size(header) != file_size)
+    {
+        return false;
+    }
+
+    uint32_t n = header.num_nodes;
+    std::vector<uint32_t> offsets;
+    std::vector<uint32_t> edges;
+    std::vector<uint32_t> reverse_offsets;
+    std::vector<uint32_t> reverse_edges;
+    std::vector<uint32_t> name_offsets;
+    std::string names(header.names_size, '\0');
+    if (!read_vector(ifs, offsets, size_t{ n } + 1)
+        || !read_vector(ifs, edges, header.num_edges)
+        || !read_vector(ifs, reverse_offsets, size_t{ n } + 1)
+        || !read_vector(ifs, reverse_edges, header.num_edges)
+        || !read_vector(ifs, name_offsets, size_t{ n } + 1)
+        || !ifs.read(&names[0], names.size()))
+    {
+        return false;
+    }
+
+    if (!valid_offsets(offsets, header.num_edges)
+        || !valid_edges(edges, n)
+        || !valid_offsets(reverse_offsets, header.num_edges)
+        || !valid_edges(reverse_edges, n)
+        || !valid_offsets(name_offsets, header.names_size))
+    {
+        return false;
+    }
+
+    SymbolTable & symbols = SymbolTable::instance();
+    std::vector<symbol_id> node_symbols(n);
+    for (uint32_t i = 0; i < n; ++i)
+    {
+        node_symbols[i] = symbols.intern(names.substr(name_offsets[i], name_offsets[i + 1] - name_offsets[i]));
+    }
+
+    graph = CsrGraph{ node_symbols, std::move(offsets), std::move(edges) };
+    reverse_graph = CsrGraph{ std::move(node_symbols), std::move(reverse_offsets), std::move(reverse_edges) };
+    return true;
+}
+
+}
@@ -0,0 +1,325 @@
+#include "ekstazi/depgraph/depgraph-log.hh"
+
+#include <fstream>
+#include <sstream>
+#include <algorithm>
+#include <vector>
+#include <cstdio>
+
+namespace ekstazi
+{
+
+namespace
+{
+
+/**
+ * Returns the number of dependencies in an adjacency list.
+ */
+uint32_t count_edges(AdjacencyList const & adj_list)
+{
+    uint32_t num_edges = 0;
+    for (auto const & p : adj_list)
+    {
+        num_edges += p.second.size();
+    }
+    return num_edges;
+}
+
+/**
+ * Returns all nodes of an adjacency list.
+ */
+std::unordered_set<symbol_id> collect_nodes(AdjacencyList const & adj_list)
+{
+    std::unordered_set<symbol_id> nodes;
+    for (auto const & p : adj_list)
+    {
+        nodes.insert(p.first);
+        nodes.insert(p.second.begin(), p.second.end());
+    }
+    return nodes;
+}
+
+/**
+ * Returns the sorted dependents of a node, or an empty vector if the
+ * node has none.
+ */
+std::vector<symbol_id> sorted_dependents(AdjacencyList const & adj_list, symbol_id node)
+{
+    auto it = adj_list.find(node);
+    if (it == adj_list.end())
+    {
+        return {};
+    }
+
+    std::vector<symbol_id> dependents{ it->second.begin(), it->second.end() };
+    std::sort(dependents.begin(), dependents.end());
+    return dependents;
+}
+
+}
+
+DepgraphLog::DepgraphLog() :
+DepgraphLog("", "")
+{
+
+}
+
+DepgraphLog::DepgraphLog(std::string const & snapshot_fname, std::string const & log_fname) :
+m_snapshot_fname{ snapshot_fname },
+m_log_fname{ log_fname },
+m_has_snapshot{ false },
+m_snapshot_edges{ 0 },
+m_generations{ 0 },
+m_entries{ 0 },
+m_appended{ false },
+m_last_generation{},
+m_last_entries{ 0 }
+{
+
+}
+
+/**
+ * Loads the base snapshot into the given graph and replays every
+ * generation of the log.
+ */
+void DepgraphLog::load(DependencyGraph & depgraph)
+{
+    replay(depgraph, UINT32_MAX);
+}
+
+/**
+ * Loads the graphs of the last two runs. The old graph is the new one
+ * without the last generation of the log.
+ */
+void DepgraphLog::load(DependencyGraph & old_depgraph, DependencyGraph & new_depgraph)
+{
+    replay(new_depgraph, UINT32_MAX);
+    if (m_generations > 0)
+    {
+        DepgraphLog{ m_snapshot_fname, m_log_fname }.replay(old_depgraph, m_generations - 1);
+    }
+}
+
+/**
+ * Loads the base snapshot into the given graph and replays the given
+ * number of generations of the log. Node removals are batched, since
+ * each batch takes a pass over the whole graph.
+ */
+void DepgraphLog::replay(DependencyGraph & depgraph, uint32_t num_generations)
+{
+    SymbolTable & symbols = SymbolTable::instance();
+    char delim = ';';
+
+    m_has_snapshot = static_cast<bool>(std::ifstream{ m_snapshot_fname });
+    m_generations = 0;
+    m_entries = 0;
+    m_appended = false;
+    if (!m_has_snapshot)
+    {
+        m_snapshot_edges = 0;
+        return;
+    }
+
+    depgraph.load_file(m_snapshot_fname);
+    m_snapshot_edges = count_edges(depgraph.get_adjacency_list());
+
+    std::ifstream ifs{ m_log_fname };
+    std::unordered_set<symbol_id> removed_nodes;
+    std::string line;
+    while (std::getline(ifs, line))
+    {
+        std::istringstream iss{ line };
+        std::string kind;
+        std::getline(iss, kind, delim);
+
+        if (kind != "!")
+        {
+            depgraph.remove_nodes(removed_nodes);
+            removed_nodes.clear();
+        }
+
+        if (kind == "generation")
+        {
+            if (m_generations == num_generations)
+            {
+                break;
+            }
+            ++m_generations;
+            continue;
+        }
+
+        std::string src_name;
+        std::getline(iss, src_name, delim);
+        if (kind == "!")
+        {
+            removed_nodes.insert(symbols.intern(src_name));
+            ++m_entries;
+            continue;
+        }
+
+        std::string dst_name;
+        std::getline(iss, dst_name, delim);
+        if (kind == "+")
+        {
+            depgraph.add_dependency(symbols.intern(src_name), symbols.intern(dst_name));
+            ++m_entries;
+        }
+        else if (kind == "-")
+        {
+            depgraph.remove_dependency(symbols.intern(src_name), symbols.intern(dst_name));
+            ++m_entries;
+        }
+    }
+    depgraph.remove_nodes(removed_nodes);
+
+    // Replaying a log over a snapshot that already contains some of its
+    // generations (after an interrupted compaction) gives the same graph,
+    // since every dependency ends up as its last entry left it
+}
+
+/**
+ * Appends the difference between the old and the new graph to the log
+ * as a new generation. Nodes that disappeared are logged once instead
+ * of logging each of their dependencies. Without a snapshot there is
+ * nothing to diff against, so nothing is appended.
+ *
+ * @return the number of entries written.
+ */
+uint32_t DepgraphLog::append(DependencyGraph const & old_depgraph, DependencyGraph const & new_depgraph)
+{
+    if (!m_has_snapshot)
+    {
+        return 0;
+    }
+
+    SymbolTable const & symbols = SymbolTable::instance();
+    AdjacencyList const & old_adj_list = old_depgraph.get_adjacency_list();
+    AdjacencyList const & new_adj_list = new_depgraph.get_adjacency_list();
+    char delim = ';';
+
+    // Buffer the generation so it is appended with a single write
+    std::ostringstream oss;
+    uint32_t entries = 0;
+
+    std::unordered_set<symbol_id> new_nodes = collect_nodes(new_adj_list);
+    std::unordered_set<symbol_id> removed_nodes;
+    for (symbol_id node : collect_nodes(old_adj_list))
+    {
+        if (new_nodes.find(node) == new_nodes.end())
+        {
+            removed_nodes.insert(node);
+            oss << '!' << delim << symbols.name(node) << '\n';
+            ++entries;
+        }
+    }
+
+    // Removed dependencies between nodes that still exist
+    for (auto const & p : old_adj_list)
+    {
+        if (removed_nodes.find(p.first) != removed_nodes.end())
+        {
+            continue;
+        }
+
+        std::vector<symbol_id> old_dependents = sorted_dependents(old_adj_list, p.first);
+        std::vector<symbol_id> new_dependents = sorted_dependents(new_adj_list, p.first);
+        std::vector<symbol_id> removed;
+        std::set_difference(old_dependents.begin(), old_dependents.end(), new_dependents.begin(), new_dependents.end(), std::back_inserter(removed));
+        for (symbol_id dependent : removed)
+        {
+            if (removed_nodes.find(dependent) != removed_nodes.end())
+            {
+                continue;
+            }
+            oss << '-' << delim << symbols.name(p.first) << delim << symbols.name(dependent) << '\n';
+            ++entries;
+        }
+    }
+
+    // Added dependencies
+    for (auto const & p : new_adj_list)
+    {
+        std::vector<symbol_id> old_dependents = sorted_dependents(old_adj_list, p.first);
+        std::vector<symbol_id> new_dependents = sorted_dependents(new_adj_list, p.first);
+        std::vector<symbol_id> added;
+        std::set_difference(new_dependents.begin(), new_dependents.end(), old_dependents.begin(), old_dependents.end(), std::back_inserter(added));
+        for (symbol_id dependent : added)
+        {
+            oss << '+' << delim << symbols.name(p.first) << delim << symbols.name(dependent) << '\n';
+            ++entries;
+        }
+    }
+
+    m_appended = true;
+    m_last_generation = oss.str();
+    m_last_entries = entries;
+
+    std::ofstream ofs{ m_log_fname, std::ios::app };
+    ofs << "generation" << delim << m_generations + 1 << '\n' << m_last_generation;
+    ofs.close();
+
+    ++m_generations;
+    m_entries += entries;
+
+    return entries;
+}
+
+/**
+ * Returns whether or not the log should be compacted.
+ */
+bool DepgraphLog::should_compact(uint32_t max_generations) const
+{
+    return !m_has_snapshot || m_generations >= max_generations || m_entries > m_snapshot_edges;
+}
+
+/**
+ * Writes a new base snapshot and rewrites the log. The old graph is
+ * the snapshot as long as this run appended a generation, so the
+ * analyzers can still rebuild it. Both files are written to temporary
+ * files first and the snapshot is replaced before the log, so an
+ * interrupted compaction leaves a snapshot with a log that replays to
+ * the same graph.
+ */
+void DepgraphLog::compact(DependencyGraph & old_depgraph, DependencyGraph & new_depgraph, bool binary)
+{
+    DependencyGraph & snapshot = m_appended ? old_depgraph : new_depgraph;
+    char delim = ';';
+    std::string tmp_fname = m_snapshot_fname + ".tmp";
+    if (binary)
+    {
+        snapshot.save_binary_file(tmp_fname);
+    }
+    else
+    {
+        snapshot.save_file(tmp_fname);
+    }
+    std::rename(tmp_fname.c_str(), m_snapshot_fname.c_str());
+
+    // The log is always written, even when empty, since the analyzers
+    // tell the log mode by it
+    tmp_fname = m_log_fname + ".tmp";
+    std::ofstream ofs{ tmp_fname };
+    if (m_appended)
+    {
+        ofs << "generation" << delim << 1 << '\n' << m_last_generation;
+    }
+    ofs.close();
+    std::rename(tmp_fname.c_str(), m_log_fname.c_str());
+
+    m_has_snapshot = true;
+    m_snapshot_edges = count_edges(snapshot.get_adjacency_list());
+    m_generations = m_appended ? 1 : 0;
+    m_entries = m_appended ? m_last_entries : 0;
+}
+
+uint32_t DepgraphLog::num_generations() const
+{
+    return m_generations;
+}
+
+uint32_t DepgraphLog::num_entries() const
+{
+    return m_entries;
+}
+
+}
@@ -0,0 +1,237 @@
+#include "ekstazi/depgraph/depgraph-union.hh"
+#include "ekstazi/utils/parallel-bfs.hh"
+
+#include <algorithm>
+
+namespace ekstazi
+{
+
+DepgraphUnion::DepgraphUnion() :
+m_symbols{},
+m_indices{},
+m_old_offsets{ 0 },
+m_old_edges{},
+m_new_offsets{ 0 },
+m_new_edges{},
+m_visited{},
+m_queue{},
+m_thread_pool{ nullptr },
+m_parallel_visited{}
+{
+
+}
+
+/**
+ * Builds the union view of two frozen dependency graphs. Nodes keep
+ * the numbering of the old graph, and nodes that only exist in the new
+ * graph are numbered after them.
+ */
+DepgraphUnion::DepgraphUnion(CsrGraph const & old_graph, CsrGraph const & new_graph) :
+DepgraphUnion()
+{
+    symbol_id max_symbol = 0;
+    for (CsrGraph const * graph : { &old_graph, &new_graph })
+    {
+        for (uint32_t i = 0; i < graph->num_nodes(); ++i)
+        {
+            max_symbol = std::max(max_symbol, graph->symbol_of(i));
+        }
+    }
+
+    bool empty = old_graph.num_nodes() == 0 && new_graph.num_nodes() == 0;
+    m_indices.assign(empty ? 0 : max_symbol + 1, CsrGraph::invalid_index);
+    for (CsrGraph const * graph : { &old_graph, &new_graph })
+    {
+        for (uint32_t i = 0; i < graph->num_nodes(); ++i)
+        {
+            symbol_id symbol = graph->symbol_of(i);
+            if (m_indices[symbol] == CsrGraph::invalid_index)
+            {
+                m_indices[symbol] = m_symbols.size();
+                m_symbols.push_back(symbol);
+            }
+        }
+    }
+
+    add_graph(old_graph, m_old_offsets, m_old_edges);
+    add_graph(new_graph, m_new_offsets, m_new_edges);
+
+    uint32_t n = m_symbols.size();
+    m_visited[0].assign((n + 63) / 64, 0);
+    m_visited[1].assign((n + 63) / 64, 0);
+    m_queue.reserve(2 * n);
+}
+
+/**
+ * Adds the edges of one graph, translated to the shared node
+ * numbering. Nodes that are not in the graph get no edges.
+ */
+void DepgraphUnion::add_graph(CsrGraph const & graph, std::vector<uint32_t> & offsets, std::vector<uint32_t> & edges)
+{
+    uint32_t n = m_symbols.size();
+    std::vector<uint32_t> const & graph_edges = graph.edges();
+
+    offsets.assign(n + 1, 0);
+    edges.reserve(graph.num_edges());
+    for (uint32_t i = 0; i < n; ++i)
+    {
+        uint32_t index = graph.index_of(m_symbols[i]);
+        if (index != CsrGraph::invalid_index)
+        {
+            for (uint32_t e = graph.begin(index); e < graph.begin(index + 1); ++e)
+            {
+                edges.push_back(m_indices[graph.symbol_of(graph_edges[e])]);
+            }
+        }
+        offsets[i + 1] = edges.size();
+    }
+}
+
+/**
+ * Sets the thread pool used to traverse large unions in parallel. The
+ * pool is not owned by the view.
+ */
+void DepgraphUnion::set_thread_pool(ThreadPool * pool)
+{
+    m_thread_pool = pool;
+}
+
+/**
+ * Returns the number of nodes in either graph.
+ */
+uint32_t DepgraphUnion::num_nodes() const
+{
+    return m_symbols.size();
+}
+
+/**
+ * Finds the union of all dependents of the given start nodes in both
+ * graphs and appends them to the given vector. Every start node is
+ * searched in both graphs at once; a node is appended the first time
+ * it is reached in either of them.
+ */
+void DepgraphUnion::get_all_dependents(std::vector<symbol_id> const & start_nodes, std::vector<symbol_id> & dependents) const
+{
+    if (m_thread_pool != nullptr && num_nodes() >= CsrGraph::parallel_threshold)
+    {
+        get_all_dependents_parallel(start_nodes, dependents);
+        return;
+    }
+
+    std::vector<uint32_t> const * offsets[2] = { &m_old_offsets, &m_new_offsets };
+    std::vector<uint32_t> const * edges[2] = { &m_old_edges, &m_new_edges };
+
+    m_queue.clear();
+    for (symbol_id start_node : start_nodes)
+    {
+        if (start_node >= m_indices.size() || m_indices[start_node] == CsrGraph::invalid_index)
+        {
+            continue;
+        }
+        m_queue.push_back(m_indices[start_node] << 1);
+        m_queue.push_back(m_indices[start_node] << 1 | 1);
+    }
+    size_t num_starts = m_queue.size();
+
+    for (size_t head = 0; head < m_queue.size(); ++head)
+    {
+        uint32_t cur_node = m_queue[head] >> 1;
+        uint32_t side = m_queue[head] & 1;
+        std::vector<uint64_t> & visited = m_visited[side];
+        std::vector<uint64_t> const & other_visited = m_visited[side ^ 1];
+
+        for (uint32_t i = (*offsets[side])[cur_node]; i < (*offsets[side])[cur_node + 1]; ++i)
+        {
+            uint32_t dependent = (*edges[side])[i];
+            uint64_t mask = uint64_t{ 1 } << (dependent % 64);
+            if (visited[dependent / 64] & mask)
+            {
+                continue;
+            }
+            visited[dependent / 64] |= mask;
+            if (!(other_visited[dependent / 64] & mask))
+            {
+                dependents.push_back(m_symbols[dependent]);
+            }
+            m_queue.push_back(dependent << 1 | side);
+        }
+    }
+
+    for (size_t head = num_starts; head < m_queue.size(); ++head)
+    {
+        m_visited[m_queue[head] & 1][m_queue[head] >> 7] = 0;
+    }
+}
+
+/**
+ * Parallel version of get_all_dependents, with every level of the
+ * search split across the thread pool.
+ */
+void DepgraphUnion::get_all_dependents_parallel(std::vector<symbol_id> const & start_nodes, std::vector<symbol_id> & dependents) const
+{
+    uint32_t n = num_nodes();
+    if (m_parallel_visited.empty())
+    {
+        m_parallel_visited.assign((2 * static_cast<size_t>(n) + 63) / 64, 0);
+    }
+
+    std::vector<uint32_t> frontier;
+    for (symbol_id start_node : start_nodes)
+    {
+        if (start_node >= m_indices.size() || m_indices[start_node] == CsrGraph::invalid_index)
+        {
+            continue;
+        }
+        frontier.push_back(m_indices[start_node]);
+        frontier.push_back(m_indices[start_node] + n);
+    }
+
+    auto for_each_dependent = [this, n](uint32_t state, auto const & visit) {
+        bool is_new = state >= n;
+        uint32_t node = is_new ? state - n : state;
+        std::vector<uint32_t> const & offsets = is_new ? m_new_offsets : m_old_offsets;
+        std::vector<uint32_t> const & edges = is_new ? m_new_edges : m_old_edges;
+        for (uint32_t i = offsets[node]; i < offsets[node + 1]; ++i)
+        {
+            visit(is_new ? edges[i] + n : edges[i]);
+        }
+    };
+
+    std::vector<uint32_t> reached;
+    parallel_bfs(*m_thread_pool, frontier, m_parallel_visited, reached, for_each_dependent);
+
+    // A node reached in both graphs is only appended for the old one
+    for (uint32_t state : reached)
+    {
+        if (state < n || !(m_parallel_visited[(state - n) / 64] & (uint64_t{ 1 } << ((state - n) % 64))))
+        {
+            dependents.push_back(m_symbols[state < n ? state : state - n]);
+        }
+    }
+
+    for (uint32_t state : reached)
+    {
+        m_parallel_visited[state / 64] = 0;
+    }
+}
+
+/**
+ * Finds the union of all dependents of the given start nodes in both
+ * graphs.
+ */
+std::unordered_set<symbol_id> DepgraphUnion::get_all_dependents(std::vector<symbol_id> const & start_nodes) const
+{
+    std::vector<symbol_id> dependents;
+    get_all_dependents(start_nodes, dependents);
+    return std::unordered_set<symbol_id>(dependents.begin(), dependents.end());
+}
+
+/**
+ * Finds all dependents of the given start node in both graphs.
+ */
+std::unordered_set<symbol_id> DepgraphUnion::get_all_dependents(symbol_id start_node) const
+{
+    return get_all_dependents(std::vector<symbol_id>{ start_node });
+}
+
+}
@@ -1,23 +1,90 @@
 
 #include "ekstazi/depgraph/depgraph.hh"
+#include "ekstazi/depgraph/depgraph-image.hh"
 
 #include <iostream>
 #include <fstream>
 #include <sstream>
-#include <queue>
 #include <algorithm>
 
 namespace ekstazi
 {
 
+namespace
+{
+
+/**
+ * Removes a dependent from the list of a node, and the node itself if
+ * no dependents are left.
+ *
+ * @return true if the dependent was removed, false if it was not there.
+ */
+bool remove_edge(AdjacencyList & adj_list, symbol_id src, symbol_id dst)
+{
+    AdjacencyList::iterator it = adj_list.find(src);
+    if (it == adj_list.end() || !it->second.erase(dst))
+    {
+        return false;
+    }
+
+    if (it->second.empty())
+    {
+        adj_list.erase(it);
+    }
+    return true;
+}
+
+/**
+ * Removes the given nodes and every edge from or to them.
+ */
+void remove_nodes_from(AdjacencyList & adj_list, std::unordered_set<symbol_id> const & nodes)
+{
+    for (AdjacencyList::iterator it = adj_list.begin(); it != adj_list.end(); )
+    {
+        if (nodes.find(it->first) != nodes.end())
+        {
+            it = adj_list.erase(it);
+            continue;
+        }
+
+        it->second.erase(nodes);
+        if (it->second.empty())
+        {
+            it = adj_list.erase(it);
+            continue;
+        }
+        ++it;
+    }
+}
+
+}
+
 DependencyGraph::DependencyGraph() :
-m_adj_list{}
+m_adj_list{},
+m_reverse_adj_list{},
+m_materialized{ true },
+m_csr{},
+m_frozen{ false },
+m_condensation{},
+m_condensed{ false },
+m_reverse_csr{},
+m_reverse_frozen{ false },
+m_thread_pool{ nullptr }
 {
 
 }
 
 DependencyGraph::DependencyGraph(DependencyGraph const & other) :
-m_adj_list{ other.m_adj_list }
+m_adj_list{ other.m_adj_list },
+m_reverse_adj_list{ other.m_reverse_adj_list },
+m_materialized{ other.m_materialized },
+m_csr{ other.m_csr },
+m_frozen{ other.m_frozen },
+m_condensation{ other.m_condensation },
+m_condensed{ other.m_condensed },
+m_reverse_csr{ other.m_reverse_csr },
+m_reverse_frozen{ other.m_reverse_frozen },
+m_thread_pool{ other.m_thread_pool }
 {
 
 }
@@ -28,118 +95,275 @@ m_adj_list{ other.m_adj_list }
  * function, or that the dst function depends on the src function.
  */
 void DependencyGraph::add_dependency(std::string const & function_src, std::string const & function_dst)
+{
+    SymbolTable & symbols = SymbolTable::instance();
+    add_dependency(symbols.intern(function_src), symbols.intern(function_dst));
+}
+
+void DependencyGraph::add_dependency(symbol_id function_src, symbol_id function_dst)
 {
     // Don't insert if src and dst are the same
     if (function_src == function_dst)
     {
         return;
     }
-    // std::cout << "Adding dependency" << std::endl;
-    std::list<std::string> & dependents = m_adj_list[function_src];
+    materialize();
+    // Duplicate edges are rejected and leave the graph unchanged
+    if (!m_adj_list[function_src].insert(function_dst))
+    {
+        return;
+    }
+    m_reverse_adj_list[function_dst].insert(function_src);
+    m_frozen = false;
+    m_condensed = false;
+    m_reverse_frozen = false;
+}
+
+/**
+ * Removes a dependency relationship from the current graph.
+ */
+void DependencyGraph::remove_dependency(symbol_id function_src, symbol_id function_dst)
+{
+    materialize();
+    if (!remove_edge(m_adj_list, function_src, function_dst))
+    {
+        return;
+    }
+    remove_edge(m_reverse_adj_list, function_dst, function_src);
+    m_frozen = false;
+    m_condensed = false;
+    m_reverse_frozen = false;
+}
+
+/**
+ * Removes the given nodes and every dependency from or to them, with a
+ * single pass over the graph.
+ */
+void DependencyGraph::remove_nodes(std::unordered_set<symbol_id> const & nodes)
+{
+    if (nodes.empty())
+    {
+        return;
+    }
 
-    // Insert into dependents if it doesn't already exist
-    // std::list<std::string>::iterator it = std::find(dependents.begin(), dependents.end(), function_dst);
-    // if (it == dependents.end())
-    // {
-    //     dependents.push_back(function_dst);
-    // }
+    materialize();
+    remove_nodes_from(m_adj_list, nodes);
+    remove_nodes_from(m_reverse_adj_list, nodes);
+    m_frozen = false;
+    m_condensed = false;
+    m_reverse_frozen = false;
+}
 
-    dependents.push_back(function_dst);
-    // auto search = m_adj_list.find(function_src);
-    // if (search == m_adj_list.end())
-    // {   // not found, so create a new node and list
-    //     // std::cout << "Creating node for " << function_src << std::endl;
-    //     m_adj_list.insert({ function_src, std::list<std::string>{} });
-    //     // "search" for the new node
-    //     search = m_adj_list.find(function_src);
-    // }
+/**
+ * Returns the adjacency list of the graph.
+ */
+AdjacencyList const & DependencyGraph::get_adjacency_list() const
+{
+    materialize();
+    return m_adj_list;
+}
 
-    // auto & connected_functions = search->second;
-    // connected_functions.push_back(function_dst);
+/**
+ * Returns the reverse adjacency list of the graph, which maps every
+ * node to the nodes it depends on.
+ */
+AdjacencyList const & DependencyGraph::get_reverse_adjacency_list() const
+{
+    materialize();
+    return m_reverse_adj_list;
 }
 
 std::unordered_set<std::string> DependencyGraph::get_all_dependents(std::string const & start_node)
 {
+    SymbolTable const & symbols = SymbolTable::instance();
+    symbol_id start_id = symbols.find(start_node);
+    if (start_id == SymbolTable::invalid_id)
+    {
+        return {};
+    }
+
     std::unordered_set<std::string> dependents{};
+    for (symbol_id dependent : get_all_dependents(start_id))
+    {
+        dependents.insert(symbols.name(dependent));
+    }
+    return dependents;
+}
+
+std::unordered_set<symbol_id> DependencyGraph::get_all_dependents(symbol_id start_node)
+{
+    if (m_frozen && m_thread_pool != nullptr && m_csr.num_nodes() >= CsrGraph::parallel_threshold)
+    {
+        return get_all_dependents(std::vector<symbol_id>{ start_node });
+    }
+    if (m_condensed)
+    {
+        return m_condensation.get_all_dependents(start_node);
+    }
+    if (m_frozen)
+    {
+        return m_csr.get_all_dependents(start_node);
+    }
 
     // Conduct a breadth-first search
-    std::queue<std::string> visit_queue{};
-    std::unordered_set<std::string> visited{};
+    return bfs(start_node, m_adj_list);
+}
+
+/**
+ * Finds the union of all dependents of the given start nodes. The
+ * graph is traversed once with a shared visited set, rather than once
+ * per start node. Large frozen graphs are traversed in parallel if a
+ * thread pool is set.
+ */
+std::unordered_set<symbol_id> DependencyGraph::get_all_dependents(std::vector<symbol_id> const & start_nodes)
+{
+    if (m_frozen && m_thread_pool != nullptr && m_csr.num_nodes() >= CsrGraph::parallel_threshold)
+    {
+        std::vector<symbol_id> dependents;
+        m_csr.get_all_dependents(*m_thread_pool, start_nodes, dependents);
+        return std::unordered_set<symbol_id>(dependents.begin(), dependents.end());
+    }
+    if (m_condensed)
+    {
+        return m_condensation.get_all_dependents(start_nodes);
+    }
+    if (m_frozen)
+    {
+        return m_csr.get_all_dependents(start_nodes);
+    }
+
+    return bfs(start_nodes, m_adj_list);
+}
 
-    visit_queue.push(start_node);
+/**
+ * Sets the thread pool used to traverse large frozen graphs in
+ * parallel. The pool is not owned by the graph.
+ */
+void DependencyGraph::set_thread_pool(ThreadPool * pool)
+{
+    m_thread_pool = pool;
+}
 
-    while (!visit_queue.empty())
+std::unordered_set<std::string> DependencyGraph::get_all_dependencies(std::string const & start_node)
+{
+    SymbolTable const & symbols = SymbolTable::instance();
+    symbol_id start_id = symbols.find(start_node);
+    if (start_id == SymbolTable::invalid_id)
     {
-        // Get front element and mark as visited
-        std::string cur_node = visit_queue.front();
-        // std::cout << "Searching for children of " << cur_node << std::endl;
-        visit_queue.pop();
-        visited.insert(cur_node);
+        return {};
+    }
 
-        // Get all direct dependents
-        auto search = m_adj_list.find(cur_node);
-        // If not found, continue
-        if (search == m_adj_list.end())
-        {
-            // std::cout << "Not found in adjacency list: " << cur_node << std::endl;
-            continue;
-        }
+    std::unordered_set<std::string> dependencies{};
+    for (symbol_id dependency : get_all_dependencies(start_id))
+    {
+        dependencies.insert(symbols.name(dependency));
+    }
+    return dependencies;
+}
 
-        std::list<std::string> const & direct_dependents = search->second;
-        dependents.insert(direct_dependents.begin(), direct_dependents.end());
+std::unordered_set<symbol_id> DependencyGraph::get_all_dependencies(symbol_id start_node)
+{
+    return get_all_dependencies(std::vector<symbol_id>{ start_node });
+}
 
-        // Add to visit_queue queue if not already visited
-        // std::cout << "Direct dependents of " << cur_node << ": " << std::endl;
-        for (std::string const & dependent : direct_dependents)
+/**
+ * Finds the union of all dependencies of the given start nodes by
+ * traversing the reverse adjacency directly. Once the graph is frozen,
+ * a reverse CSR copy is built on the first query and reused.
+ */
+std::unordered_set<symbol_id> DependencyGraph::get_all_dependencies(std::vector<symbol_id> const & start_nodes)
+{
+    if (m_frozen)
+    {
+        if (!m_reverse_frozen)
         {
-            // std::cout << dependent << std::endl;
-            auto search = visited.find(dependent);
-            if (search == visited.end())
-            {
-                visit_queue.push(dependent);
-                // std::cout << "Added " << dependent << " to the visit queue." << std::endl;
-            }
+            materialize();
+            m_reverse_csr = CsrGraph{ m_reverse_adj_list };
+            m_reverse_frozen = true;
         }
+        return m_reverse_csr.get_all_dependents(start_nodes);
     }
 
-    return dependents;
+    return bfs(start_nodes, m_reverse_adj_list);
 }
 
-bool DependencyGraph::empty() {
-    return m_adj_list.empty();
+/**
+ * Builds an immutable CSR copy of the graph that is used for all
+ * following traversals. Adding a dependency afterwards discards the
+ * frozen copy.
+ */
+void DependencyGraph::freeze()
+{
+    materialize();
+    m_csr = CsrGraph{ m_adj_list };
+    m_frozen = true;
+    m_condensed = false;
+    m_reverse_frozen = false;
+}
+
+bool DependencyGraph::is_frozen() const
+{
+    return m_frozen;
 }
 
 /**
- * Reverses a dependency graph and returns it (original remains
- * unchanged).
+ * Returns the frozen CSR copy of the graph. Only valid once the graph
+ * is frozen.
  */
-DependencyGraph DependencyGraph::reverse()
+CsrGraph const & DependencyGraph::get_frozen_graph() const
 {
-    DependencyGraph reversed;
-    // To reverse the dependency graph, we iterate through the
-    // adjacency list and make new connections backwards from the list
-    // node to the key.
-    for (auto pair: m_adj_list)
+    return m_csr;
+}
+
+/**
+ * Condenses the strongly connected components of the graph into a
+ * DAG, which is used for all following traversals so cycles are only
+ * explored once. Freezes the graph if it is not frozen yet.
+ */
+void DependencyGraph::condense()
+{
+    if (!m_frozen)
     {
-        for (std::string const & function : pair.second)
-        {
-            // Connect from function -> original key
-            reversed.add_dependency(function, pair.first);
-        }
+        freeze();
     }
-    return reversed;
+    m_condensation = CondensedGraph{ m_csr };
+    m_condensed = true;
+}
+
+bool DependencyGraph::is_condensed() const
+{
+    return m_condensed;
 }
 
 /**
- * Removes duplicates from the dependency graph.
+ * Returns the condensation of the graph. Only valid once the graph is
+ * condensed.
  */
-void DependencyGraph::remove_duplicates()
+CondensedGraph const & DependencyGraph::get_condensed_graph() const
 {
-    for (std::unordered_map<std::string, std::list<std::string>>::iterator it = m_adj_list.begin(); it != m_adj_list.end(); ++it)
+    return m_condensation;
+}
+
+bool DependencyGraph::empty() {
+    if (!m_materialized)
     {
-        it->second.sort();
-        it->second.unique();
+        return m_csr.num_edges() == 0;
     }
+    return m_adj_list.empty();
+}
+
+/**
+ * Reverses a dependency graph and returns it (original remains
+ * unchanged).
+ */
+DependencyGraph DependencyGraph::reverse()
+{
+    // Both directions are maintained, so reversing only swaps them
+    materialize();
+    DependencyGraph reversed;
+    reversed.m_adj_list = m_reverse_adj_list;
+    reversed.m_reverse_adj_list = m_adj_list;
+    return reversed;
 }
 
 /**
@@ -147,39 +371,53 @@ void DependencyGraph::remove_duplicates()
  */
 bool DependencyGraph::exists_dependency(std::string const & function_src, std::string const & function_dst)
 {
-    std::unordered_map<std::string, std::list<std::string>>::iterator it = m_adj_list.find(function_src);
-    if (it == m_adj_list.end())
+    SymbolTable const & symbols = SymbolTable::instance();
+    symbol_id src = symbols.find(function_src);
+    symbol_id dst = symbols.find(function_dst);
+    if (src == SymbolTable::invalid_id || dst == SymbolTable::invalid_id)
     {
         return false;
     }
+    return exists_dependency(src, dst);
+}
 
-    for (std::string const & fun : it->second)
-    {
-        if (fun == function_dst)
-        {
-            return true;
-        }
-    }
-
-    return false;
+/**
+ * Returns whether or not a dependency relation exists. The dependents
+ * of hub nodes are hashed by their AdjacencySet, so this stays constant
+ * time for them.
+ */
+bool DependencyGraph::exists_dependency(symbol_id function_src, symbol_id function_dst)
+{
+    materialize();
+    AdjacencyList::const_iterator it = m_adj_list.find(function_src);
+    return it != m_adj_list.end() && it->second.contains(function_dst);
 }
 
 void DependencyGraph::print()
 {
-    for (auto pair : m_adj_list)
+    materialize();
+    SymbolTable const & symbols = SymbolTable::instance();
+    for (auto const & pair : m_adj_list)
     {
-        std::cout << pair.first << std::endl;
+        std::cout << symbols.name(pair.first) << std::endl;
 
-        std::list<std::string> connected_functions = pair.second;
-        for (auto fun : connected_functions)
+        AdjacencySet const & connected_functions = pair.second;
+        for (symbol_id fun : connected_functions)
         {
-            std::cout << " -> " << fun << std::endl;
+            std::cout << " -> " << symbols.name(fun) << std::endl;
         }
     }
 }
 
 void DependencyGraph::load_file(std::string const & fname)
 {
+    if (DepgraphImage::is_image(fname))
+    {
+        load_binary_file(fname);
+        return;
+    }
+
+    SymbolTable & symbols = SymbolTable::instance();
     std::ifstream ifs { fname };
     char delim = ';';
     char dep_delim = ';';
@@ -192,12 +430,13 @@ void DependencyGraph::load_file(std::string const & fname)
         // First parse the source node
         std::string src_name;
         std::getline(iss, src_name, delim);
+        symbol_id src = symbols.intern(src_name);
 
         // Now get all of the connected nodes
         std::string dst_name;
         while (std::getline(iss, dst_name, dep_delim))
         {
-            add_dependency(src_name, dst_name);
+            add_dependency(src, symbols.intern(dst_name));
         }
     }
 }
@@ -207,20 +446,22 @@ void DependencyGraph::load_file(std::string const & fname)
  */
 void DependencyGraph::save_file(std::string const & fname)
 {
+    materialize();
+    SymbolTable const & symbols = SymbolTable::instance();
     std::ofstream ofs { fname };
     char delim = ';';
     char dep_delim = ';';
 
     for (auto const & pair : m_adj_list)
     {
-        ofs << pair.first << delim;
+        ofs << symbols.name(pair.first) << delim;
 
-        std::list<std::string> const & connected_functions = pair.second;
+        AdjacencySet const & connected_functions = pair.second;
 
         int i = 0;
-        for (auto const & fun : connected_functions)
+        for (symbol_id fun : connected_functions)
         {
-            ofs << fun;
+            ofs << symbols.name(fun);
             
             ++i;
             if (i < connected_functions.size())
@@ -235,4 +476,74 @@ void DependencyGraph::save_file(std::string const & fname)
     ofs.close();
 }
 
+/**
+ * Loads the dependency graph from a binary image. The graph and its
+ * reverse are frozen with the CSR arrays read from the image, so no
+ * text is parsed and nothing is inserted edge by edge. The node names
+ * are interned, since the old and new graphs of a run are matched by
+ * symbol. The adjacency lists are left to materialize().
+ */
+bool DependencyGraph::load_binary_file(std::string const & fname)
+{
+    CsrGraph graph;
+    CsrGraph reverse_graph;
+    if (!DepgraphImage::read(fname, graph, reverse_graph))
+    {
+        return false;
+    }
+
+    m_adj_list.clear();
+    m_reverse_adj_list.clear();
+    m_materialized = false;
+
+    m_csr = std::move(graph);
+    m_frozen = true;
+    m_condensed = false;
+
+    m_reverse_csr = std::move(reverse_graph);
+    m_reverse_frozen = true;
+
+    return true;
+}
+
+/**
+ * Builds the adjacency lists from the frozen CSR graph of a graph
+ * loaded from a binary image. The frozen graph is
+ * only discarded when the graph changes afterwards, so it is still
+ * valid while they are missing.
+ */
+void DependencyGraph::materialize() const
+{
+    if (m_materialized)
+    {
+        return;
+    }
+
+    std::vector<uint32_t> const & edges = m_csr.edges();
+    for (uint32_t i = 0; i < m_csr.num_nodes(); ++i)
+    {
+        symbol_id src = m_csr.symbol_of(i);
+        for (uint32_t e = m_csr.begin(i); e < m_csr.begin(i + 1); ++e)
+        {
+            symbol_id dst = m_csr.symbol_of(edges[e]);
+            m_adj_list[src].insert(dst);
+            m_reverse_adj_list[dst].insert(src);
+        }
+    }
+    m_materialized = true;
+}
+
+/**
+ * Saves the dependency graph as a binary image. Freezes the graph if it
+ * is not frozen yet.
+ */
+bool DependencyGraph::save_binary_file(std::string const & fname)
+{
+    if (!m_frozen)
+    {
+        freeze();
+    }
+    return DepgraphImage::write(m_csr, fname);
+}
+
 }
@@ -0,0 +1,157 @@
+#include "ekstazi/depgraph/dispatch-summary.hh"
+
+#include <fstream>
+#include <sstream>
+
+namespace ekstazi
+{
+
+/**
+ * Loads the summaries from a file. Every line holds the function, the
+ * argument number, the entry and default digests, and the cases as a
+ * list of value:digest. Malformed lines are skipped.
+ */
+DispatchSummaryMap DispatchSummary::load_file(std::string const & fname)
+{
+    SymbolTable & symbols = SymbolTable::instance();
+    std::ifstream ifs{ fname };
+    DispatchSummaryMap summaries{};
+    char delim = ';';
+
+    std::string line;
+    while (std::getline(ifs, line))
+    {
+        std::istringstream iss{ line };
+        std::string name;
+        std::string arg_no;
+        std::string entry_str;
+        std::string default_str;
+        std::string cases;
+        std::getline(iss, name, delim);
+        std::getline(iss, arg_no, delim);
+        std::getline(iss, entry_str, delim);
+        std::getline(iss, default_str, delim);
+        std::getline(iss, cases, delim);
+
+        Hash128 entry;
+        Hash128 default_case;
+        if (name.empty() || arg_no.empty() ||
+            !Hash128::from_string(entry_str, entry) ||
+            !Hash128::from_string(default_str, default_case))
+        {
+            continue;
+        }
+
+        DispatchSummary summary{ static_cast<uint32_t>(std::stoul(arg_no)), entry, default_case };
+        std::istringstream cases_iss{ cases };
+        std::string c;
+        while (std::getline(cases_iss, c, ','))
+        {
+            size_t pos = c.find(':');
+            Hash128 digest;
+            if (pos != std::string::npos && Hash128::from_string(c.substr(pos + 1), digest))
+            {
+                summary.add_case(std::stoull(c.substr(0, pos)), digest);
+            }
+        }
+
+        summaries.insert({ symbols.intern(name), summary });
+    }
+
+    return summaries;
+}
+
+/**
+ * Saves the summaries to a file.
+ */
+void DispatchSummary::save_file(DispatchSummaryMap const & summaries, std::string const & fname)
+{
+    SymbolTable const & symbols = SymbolTable::instance();
+    std::ofstream ofs{ fname };
+    char delim = ';';
+
+    for (auto const & p : summaries)
+    {
+        DispatchSummary const & summary = p.second;
+        ofs << symbols.name(p.first) << delim << summary.m_arg_no << delim
+            << summary.m_entry.to_string() << delim << summary.m_default.to_string() << delim;
+
+        char sep = '\0';
+        for (auto const & c : summary.m_cases)
+        {
+            if (sep != '\0')
+            {
+                ofs << sep;
+            }
+            ofs << c.first << ':' << c.second.to_string();
+            sep = ',';
+        }
+        ofs << std::endl;
+    }
+
+    ofs.close();
+}
+
+DispatchSummary::DispatchSummary() :
+m_empty{ true },
+m_arg_no{ 0 },
+m_entry{ 0, 0 },
+m_default{ 0, 0 },
+m_cases{}
+{
+
+}
+
+DispatchSummary::DispatchSummary(uint32_t arg_no, Hash128 const & entry, Hash128 const & default_case) :
+m_empty{ false },
+m_arg_no{ arg_no },
+m_entry{ entry },
+m_default{ default_case },
+m_cases{}
+{
+
+}
+
+void DispatchSummary::add_case(uint64_t value, Hash128 const & digest)
+{
+    m_cases[value] = digest;
+}
+
+bool DispatchSummary::empty() const
+{
+    return m_empty;
+}
+
+uint32_t DispatchSummary::arg_no() const
+{
+    return m_arg_no;
+}
+
+Hash128 const & DispatchSummary::entry() const
+{
+    return m_entry;
+}
+
+/**
+ * Returns the digest of the blocks a call passing the value runs
+ * after the entry block.
+ */
+Hash128 const & DispatchSummary::get_case(uint64_t value) const
+{
+    auto it = m_cases.find(value);
+    return it == m_cases.end() ? m_default : it->second;
+}
+
+/**
+ * Returns whether a call passing the value runs the same code as with
+ * the old summary. A case that was added or removed compares against
+ * the default of the other summary.
+ */
+bool DispatchSummary::same_case(DispatchSummary const & old_summary, uint64_t value) const
+{
+    return !m_empty && !old_summary.m_empty &&
+        m_entry == old_summary.m_entry &&
+        get_case(value) == old_summary.get_case(value);
+}
+
+}
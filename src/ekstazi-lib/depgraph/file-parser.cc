@@ -15,7 +15,7 @@ m_fname { fname }
 
 }
 
-void FileParser::parse_dependencies(DependencyGraph & graph, std::map<std::string, ekstazi::Function> & functions)
+void FileParser::parse_dependencies(DependencyGraph & graph, ekstazi::FunctionMap & functions)
 {
     std::cout << "Parsing dependency file: " << m_fname << std::endl;
     std::ifstream ifs{ m_fname };
@@ -33,7 +33,8 @@ void FileParser::parse_dependencies(DependencyGraph & graph, std::map<std::strin
             cur_fun = line.substr(0, found);
             std::string checksum = line.substr(found + 1);
             std::cout << cur_fun << ", " << checksum << std::endl;
-            functions.insert(std::make_pair(cur_fun, ekstazi::Function{ cur_fun, checksum, m_fname }));
+            ekstazi::Function f{ cur_fun, checksum, m_fname };
+            functions.insert({ f.id(), f });
             continue;
         }
 
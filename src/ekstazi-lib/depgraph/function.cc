@@ -5,20 +5,36 @@
 #include <fstream>
 #include <iostream>
 #include <sstream>
+#include <vector>
+#include <algorithm>
 
 namespace ekstazi
 {
 
-void Function::save_file(std::map<std::string, Function> const & functions, std::string const & fname)
+/**
+ * Saves the functions to a file, sorted by name so the file does not
+ * depend on the order of the table.
+ */
+void Function::save_file(FunctionMap const & functions, std::string const & fname)
 {
     std::ofstream ofs{ fname };
 
     char delim = ';';
 
-    for (std::pair<std::string, Function> const & p : functions)
+    std::vector<Function const *> sorted_functions;
+    sorted_functions.reserve(functions.size());
+    for (std::pair<symbol_id const, Function> const & p : functions)
+    {
+        sorted_functions.push_back(&p.second);
+    }
+    std::sort(sorted_functions.begin(), sorted_functions.end(), [](Function const * lhs, Function const * rhs)
+    {
+        return lhs->name() < rhs->name();
+    });
+
+    for (Function const * f : sorted_functions)
     {
-        Function f = p.second;
-        ofs << f.name() << delim << f.filename() << delim << f.checksum() << std::endl;
+        ofs << f->name() << delim << f->filename() << delim << f->checksum() << delim << f->callee_signature() << std::endl;
     }
 
     ofs.close();
@@ -74,18 +90,14 @@ std::pair<std::string, std::string> Function::split_class_name(std::string const
 {
     std::pair<std::string, std::string> res;
 
-    std::string demangled_name = fun_name;
-    if (should_demangle)
-    {
-        demangled_name = demangle(fun_name);
-    }
+    std::string_view demangled_name = should_demangle ? demangle(fun_name) : std::string_view{ fun_name };
     // Find location of opening parenthesis '('
     size_t pos_first_arg = demangled_name.find('(');
     // Find location of last '::', which separates the class name from
     // the function name.
     size_t pos_fun_separator = demangled_name.rfind("::", pos_first_arg);
 
-    if (pos_fun_separator == std::string::npos)
+    if (pos_fun_separator == std::string_view::npos)
     {
         res.first = demangled_name.substr(0, pos_fun_separator);
         res.second = "";
@@ -98,10 +110,10 @@ std::pair<std::string, std::string> Function::split_class_name(std::string const
     return res;
 }
 
-std::map<std::string, Function> Function::load_file(std::string const & fname)
+FunctionMap Function::load_file(std::string const & fname)
 {
     std::ifstream ifs{ fname };
-    std::map<std::string, Function> functions{};
+    FunctionMap functions{};
     char delim = ';';
     
     std::string line;
@@ -120,7 +132,12 @@ std::map<std::string, Function> Function::load_file(std::string const & fname)
         std::string checksum;
         std::getline(iss, checksum, delim);
 
+        // Files from older versions have no callee signatures
+        std::string callee_signature;
+        std::getline(iss, callee_signature, delim);
+
         Function f{ name, fname, checksum };
+        f.set_callee_signature(callee_signature);
 
         // std::cout << "Name: " << f.name() << std::endl;
         // std::cout << "FName: " << f.filename() << std::endl;
@@ -128,7 +145,7 @@ std::map<std::string, Function> Function::load_file(std::string const & fname)
         // ++count;
         // std::cout << "Count: " << count << std::endl;
         
-        functions.insert({ f.name(), f });
+        functions.insert({ f.id(), f });
     }
 
     ifs.close();
@@ -142,22 +159,22 @@ std::map<std::string, Function> Function::load_file(std::string const & fname)
  * don't exist from old to new and vice versa (similar to set XOR), or
  * the computed hash changed.
  */
-std::unordered_set<std::string> Function::get_modified_functions(std::map<std::string, Function> const & old_functions, std::map<std::string, Function> const & new_functions)
+std::unordered_set<symbol_id> Function::get_modified_functions(FunctionMap const & old_functions, FunctionMap const & new_functions)
 {   
-    std::unordered_set<std::string> modified_functions;
+    std::unordered_set<symbol_id> modified_functions;
 
     // Find changed functions
-    for (std::pair<std::string, ekstazi::Function> const & p : old_functions)
+    for (std::pair<symbol_id const, ekstazi::Function> const & p : old_functions)
     {
-        std::string const & old_fun_name = p.first;
+        symbol_id old_fun_id = p.first;
         ekstazi::Function const & old_fun = p.second;
 
-        auto it = new_functions.find(old_fun_name);
+        auto it = new_functions.find(old_fun_id);
 
         // If not found, then we need to add this to the set of modified functions.
         if (it == new_functions.end())
         {
-            modified_functions.insert(old_fun.name());
+            modified_functions.insert(old_fun_id);
             continue;
         }
 
@@ -165,23 +182,22 @@ std::unordered_set<std::string> Function::get_modified_functions(std::map<std::s
         ekstazi::Function const & new_fun = it->second;
         if (old_fun.checksum() != new_fun.checksum())
         {
-            // errs() << "Checksums differ: " << old_fun_name << '\n';
-            modified_functions.insert(old_fun.name());
+            // errs() << "Checksums differ: " << old_fun.name() << '\n';
+            modified_functions.insert(old_fun_id);
         }
     }
 
     // Find new functions that were not in the old functions list
-    for (std::pair<std::string, ekstazi::Function> const & p : new_functions)
+    for (std::pair<symbol_id const, ekstazi::Function> const & p : new_functions)
     {
-        std::string const & new_fun_name = p.first;
-        ekstazi::Function const & new_fun = p.second;
+        symbol_id new_fun_id = p.first;
 
-        auto it = old_functions.find(new_fun_name);
+        auto it = old_functions.find(new_fun_id);
 
         // If not found, then we need to add this to the set of modified functions.
         if (it == old_functions.end())
         {
-            modified_functions.insert(new_fun.name());
+            modified_functions.insert(new_fun_id);
         }
     }
 
@@ -189,16 +205,31 @@ std::unordered_set<std::string> Function::get_modified_functions(std::map<std::s
 }
 
 Function::Function(std::string const & name, std::string const & fname, std::string const & checksum) :
-m_name { name },
+m_id { SymbolTable::instance().intern(name) },
 m_filename { fname },
-m_checksum { checksum }
+m_checksum { checksum },
+m_callee_signature {}
 {
 
 }
 
+Function::Function(symbol_id id, std::string const & fname, std::string const & checksum) :
+m_id { id },
+m_filename { fname },
+m_checksum { checksum },
+m_callee_signature {}
+{
+
+}
+
+symbol_id Function::id() const
+{
+    return m_id;
+}
+
 std::string const & Function::name() const
 {
-    return m_name;
+    return SymbolTable::instance().name(m_id);
 }
 
 std::string const & Function::filename() const
@@ -211,10 +242,20 @@ std::string const & Function::checksum() const
     return m_checksum;
 }
 
+std::string const & Function::callee_signature() const
+{
+    return m_callee_signature;
+}
+
+void Function::set_callee_signature(std::string const & callee_signature)
+{
+    m_callee_signature = callee_signature;
+}
+
 bool Function::operator==(Function const & fun) const
 {
     return
-        m_name == fun.m_name &&
+        m_id == fun.m_id &&
         m_filename == fun.m_filename &&
         m_checksum == fun.m_checksum;
 }
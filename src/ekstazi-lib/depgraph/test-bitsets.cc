@@ -0,0 +1,96 @@
+#include "ekstazi/depgraph/test-bitsets.hh"
+
+namespace ekstazi
+{
+
+/**
+ * Numbers the tests among the functions densely, continuing after the
+ * tests numbered so far. Functions seen before keep their number, so a
+ * function shared by several graphs is only numbered once.
+ */
+std::vector<uint32_t> number_tests(std::vector<symbol_id> const & functions, std::function<bool(std::string const &)> const & is_test,
+                                   std::unordered_map<symbol_id, uint32_t> & test_numbers, std::vector<symbol_id> & tests)
+{
+    SymbolTable const & symbols = SymbolTable::instance();
+    std::vector<uint32_t> function_test_numbers;
+    function_test_numbers.reserve(functions.size());
+    for (symbol_id function : functions)
+    {
+        auto it = test_numbers.insert({ function, CsrGraph::invalid_index });
+        if (it.second && is_test(symbols.name(function)))
+        {
+            it.first->second = tests.size();
+            tests.push_back(function);
+        }
+        function_test_numbers.push_back(it.first->second);
+    }
+    return function_test_numbers;
+}
+
+/**
+ * Returns the number of 64-bit words of a bitset over the given
+ * number of tests.
+ */
+uint32_t num_bitset_words(uint32_t num_tests)
+{
+    return (num_tests + 63) / 64;
+}
+
+/**
+ * Returns a pointer to the first word of a bitset.
+ */
+uint64_t* bitset(std::vector<uint64_t> & bitsets, uint32_t index, uint32_t words)
+{
+    return bitsets.data() + static_cast<size_t>(index) * words;
+}
+
+uint64_t const * bitset(std::vector<uint64_t> const & bitsets, uint32_t index, uint32_t words)
+{
+    return bitsets.data() + static_cast<size_t>(index) * words;
+}
+
+/**
+ * ORs one bitset into another, and returns whether it changed.
+ */
+bool merge_bitsets(uint64_t* bits, uint64_t const * other_bits, uint32_t words)
+{
+    bool changed = false;
+    for (uint32_t w = 0; w < words; ++w)
+    {
+        uint64_t word = bits[w] | other_bits[w];
+        changed = changed || word != bits[w];
+        bits[w] = word;
+    }
+    return changed;
+}
+
+/**
+ * Propagates the tests over the components of a condensed graph: the
+ * bitset of a component is the OR of the bitsets of its dependents'
+ * components, plus the tests inside the component itself. Components
+ * are numbered in reverse topological order, so all dependent
+ * components are complete before we reach one.
+ */
+void propagate_test_bitsets(CondensedGraph const & graph, std::vector<uint32_t> const & member_test_numbers, uint32_t words, std::vector<uint64_t> & bitsets)
+{
+    std::vector<uint32_t> const & successors = graph.successors();
+    for (uint32_t c = 0; c < graph.num_components(); ++c)
+    {
+        uint64_t* bits = bitset(bitsets, c, words);
+        for (uint32_t k = graph.member_begin(c); k < graph.member_begin(c + 1); ++k)
+        {
+            uint32_t test_number = member_test_numbers[k];
+            if (test_number != CsrGraph::invalid_index)
+            {
+                bits[test_number / 64] |= uint64_t{ 1 } << (test_number % 64);
+            }
+        }
+
+        for (uint32_t e = graph.successor_begin(c); e < graph.successor_begin(c + 1); ++e)
+        {
+            merge_bitsets(bits, bitset(bitsets, successors[e], words), words);
+        }
+    }
+}
+
+}
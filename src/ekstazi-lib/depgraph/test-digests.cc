@@ -0,0 +1,157 @@
+#include "ekstazi/depgraph/test-digests.hh"
+
+#include <fstream>
+
+namespace ekstazi
+{
+
+namespace
+{
+
+/**
+ * Adds a hash to a sum of hashes, in both halves.
+ */
+void add_to(Hash128 & sum, Hash128 const & hash)
+{
+    sum.low += hash.low;
+    sum.high += hash.high;
+}
+
+}
+
+TestDigests::TestDigests() :
+m_digests{}
+{
+
+}
+
+/**
+ * Computes the digests of the tests. Components are numbered in
+ * reverse topological order, so the components a component depends on
+ * have larger numbers and are complete before we reach it.
+ */
+void TestDigests::build(CondensedGraph const & graph, FunctionMap const & functions, TestPredicate const & is_test)
+{
+    SymbolTable const & symbols = SymbolTable::instance();
+    std::vector<symbol_id> const & members = graph.members();
+    std::vector<uint32_t> const & successors = graph.successors();
+    uint32_t num_components = graph.num_components();
+
+    m_digests.clear();
+    std::vector<Hash128> dependency_sums(num_components, Hash128{ 0, 0 });
+    for (uint32_t c = num_components; c-- > 0;)
+    {
+        // Members of the component
+        Hash128 member_sum{ 0, 0 };
+        for (uint32_t k = graph.member_begin(c); k < graph.member_begin(c + 1); ++k)
+        {
+            std::string const & name = symbols.name(members[k]);
+            auto it = functions.find(members[k]);
+            std::string const checksum = it == functions.end() ? std::string{} : it->second.checksum();
+
+            Xxh128HashPolicy member_hash{};
+            member_hash.add_bytes(name.data(), name.size());
+            member_hash.add_bytes(checksum.data(), checksum.size());
+            add_to(member_sum, member_hash.finish());
+        }
+
+        Xxh128HashPolicy component_hash{};
+        component_hash.add_word(member_sum.low);
+        component_hash.add_word(member_sum.high);
+        component_hash.add_word(dependency_sums[c].low);
+        component_hash.add_word(dependency_sums[c].high);
+        Hash128 digest = component_hash.finish();
+
+        // The dependents of the component depend on its digest
+        for (uint32_t e = graph.successor_begin(c); e < graph.successor_begin(c + 1); ++e)
+        {
+            add_to(dependency_sums[successors[e]], digest);
+        }
+
+        for (uint32_t k = graph.member_begin(c); k < graph.member_begin(c + 1); ++k)
+        {
+            if (is_test(symbols.name(members[k])))
+            {
+                m_digests.insert({ members[k], digest });
+            }
+        }
+    }
+}
+
+/**
+ * Returns the tests whose digest changed or that are new.
+ */
+std::vector<symbol_id> TestDigests::get_changed_tests(TestDigests const & old_digests) const
+{
+    std::vector<symbol_id> tests;
+    for (auto const & p : m_digests)
+    {
+        auto it = old_digests.m_digests.find(p.first);
+        if (it == old_digests.m_digests.end() || it->second != p.second)
+        {
+            tests.push_back(p.first);
+        }
+    }
+
+    return tests;
+}
+
+/**
+ * Returns whether or not there are no tests.
+ */
+bool TestDigests::empty() const
+{
+    return m_digests.empty();
+}
+
+/**
+ * Returns the number of tests.
+ */
+uint32_t TestDigests::num_tests() const
+{
+    return m_digests.size();
+}
+
+/**
+ * Loads the digests from a file. Malformed lines are skipped.
+ */
+void TestDigests::load_file(std::string const & fname)
+{
+    SymbolTable & symbols = SymbolTable::instance();
+    std::ifstream ifs{ fname };
+    char delim = ';';
+
+    m_digests.clear();
+
+    std::string line;
+    while (std::getline(ifs, line))
+    {
+        size_t pos = line.rfind(delim);
+        Hash128 digest;
+        if (pos == std::string::npos || !Hash128::from_string(line.substr(pos + 1), digest))
+        {
+            continue;
+        }
+
+        m_digests[symbols.intern(line.substr(0, pos))] = digest;
+    }
+}
+
+/**
+ * Saves the digests to a file.
+ */
+void TestDigests::save_file(std::string const & fname) const
+{
+    SymbolTable const & symbols = SymbolTable::instance();
+    std::ofstream ofs{ fname };
+    char delim = ';';
+
+    for (auto const & p : m_digests)
+    {
+        ofs << symbols.name(p.first) << delim << p.second.to_string() << std::endl;
+    }
+
+    ofs.close();
+}
+
+}
@@ -0,0 +1,199 @@
+#include "ekstazi/depgraph/test-index.hh"
+
+#include <fstream>
+#include <sstream>
+#include <iomanip>
+#include <algorithm>
+
+namespace ekstazi
+{
+
+TestIndex::TestIndex() :
+m_tests{},
+m_words{ 0 },
+m_bitsets{},
+m_function_bitsets{}
+{
+
+}
+
+/**
+ * Builds the index for a condensed dependency graph.
+ */
+void TestIndex::build(CondensedGraph const & graph, TestPredicate const & is_test)
+{
+    std::vector<symbol_id> const & members = graph.members();
+    uint32_t num_components = graph.num_components();
+
+    m_tests.clear();
+    std::unordered_map<symbol_id, uint32_t> test_numbers;
+    std::vector<uint32_t> member_test_numbers = number_tests(members, is_test, test_numbers, m_tests);
+    m_words = num_bitset_words(m_tests.size());
+
+    std::vector<uint64_t> component_bitsets(static_cast<size_t>(num_components) * m_words, 0);
+    propagate_test_bitsets(graph, member_test_numbers, m_words, component_bitsets);
+
+    // Keep a single copy of every distinct, non-empty bitset
+    m_bitsets.clear();
+    m_function_bitsets.clear();
+    std::unordered_map<std::string, uint32_t> distinct_bitsets;
+    for (uint32_t c = 0; c < num_components; ++c)
+    {
+        uint64_t const * bits = bitset(component_bitsets, c, m_words);
+        if (std::all_of(bits, bits + m_words, [](uint64_t word) { return word == 0; }))
+        {
+            continue;
+        }
+
+        std::string key{ reinterpret_cast<char const *>(bits), m_words * sizeof(uint64_t) };
+        auto it = distinct_bitsets.find(key);
+        if (it == distinct_bitsets.end())
+        {
+            it = distinct_bitsets.insert({ key, m_bitsets.size() / m_words }).first;
+            m_bitsets.insert(m_bitsets.end(), bits, bits + m_words);
+        }
+
+        for (uint32_t k = graph.member_begin(c); k < graph.member_begin(c + 1); ++k)
+        {
+            m_function_bitsets.insert({ members[k], it->second });
+        }
+    }
+}
+
+/**
+ * Returns the tests that depend on any of the given functions,
+ * including functions that are tests themselves. The result is the OR
+ * of the bitsets of all given functions.
+ */
+std::unordered_set<symbol_id> TestIndex::get_tests(std::vector<symbol_id> const & functions) const
+{
+    std::vector<uint64_t> selected(m_words, 0);
+    for (symbol_id function : functions)
+    {
+        auto it = m_function_bitsets.find(function);
+        if (it == m_function_bitsets.end())
+        {
+            continue;
+        }
+
+        merge_bitsets(selected.data(), bitset(m_bitsets, it->second, m_words), m_words);
+    }
+
+    std::unordered_set<symbol_id> tests;
+    for (uint32_t w = 0; w < m_words; ++w)
+    {
+        uint64_t word = selected[w];
+        while (word != 0)
+        {
+            uint32_t bit = __builtin_ctzll(word);
+            tests.insert(m_tests[w * 64 + bit]);
+            word &= word - 1;
+        }
+    }
+
+    return tests;
+}
+
+/**
+ * Returns whether or not the index is empty.
+ */
+bool TestIndex::empty() const
+{
+    return m_function_bitsets.empty();
+}
+
+/**
+ * Returns the number of tests in the index.
+ */
+uint32_t TestIndex::num_tests() const
+{
+    return m_tests.size();
+}
+
+/**
+ * Loads the index from a file.
+ */
+void TestIndex::load_file(std::string const & fname)
+{
+    SymbolTable & symbols = SymbolTable::instance();
+    std::ifstream ifs{ fname };
+    char delim = ';';
+
+    m_tests.clear();
+    m_bitsets.clear();
+    m_function_bitsets.clear();
+    m_words = 0;
+
+    std::string line;
+    if (!std::getline(ifs, line) || line.empty())
+    {
+        return;
+    }
+
+    uint32_t num_tests = std::stoul(line);
+    for (uint32_t i = 0; i < num_tests && std::getline(ifs, line); ++i)
+    {
+        m_tests.push_back(symbols.intern(line));
+    }
+    m_words = (m_tests.size() + 63) / 64;
+
+    std::getline(ifs, line);
+    uint32_t num_bitsets = std::stoul(line);
+    for (uint32_t i = 0; i < num_bitsets && std::getline(ifs, line); ++i)
+    {
+        // Every word is written as 16 hex digits
+        for (uint32_t w = 0; w < m_words; ++w)
+        {
+            m_bitsets.push_back(std::stoull(line.substr(w * 16, 16), nullptr, 16));
+        }
+    }
+
+    while (std::getline(ifs, line))
+    {
+        size_t pos = line.rfind(delim);
+        if (pos == std::string::npos)
+        {
+            continue;
+        }
+        m_function_bitsets[symbols.intern(line.substr(0, pos))] = std::stoul(line.substr(pos + 1));
+    }
+}
+
+/**
+ * Saves the index to a file.
+ */
+void TestIndex::save_file(std::string const & fname) const
+{
+    SymbolTable const & symbols = SymbolTable::instance();
+    std::ofstream ofs{ fname };
+    char delim = ';';
+
+    ofs << m_tests.size() << std::endl;
+    for (symbol_id test : m_tests)
+    {
+        ofs << symbols.name(test) << std::endl;
+    }
+
+    uint32_t num_bitsets = m_words == 0 ? 0 : m_bitsets.size() / m_words;
+    ofs << num_bitsets << std::endl;
+    ofs << std::hex << std::setfill('0');
+    for (uint32_t i = 0; i < num_bitsets; ++i)
+    {
+        uint64_t const * bits = bitset(m_bitsets, i, m_words);
+        for (uint32_t w = 0; w < m_words; ++w)
+        {
+            ofs << std::setw(16) << bits[w];
+        }
+        ofs << std::endl;
+    }
+    ofs << std::dec;
+
+    for (auto const & p : m_function_bitsets)
+    {
+        ofs << symbols.name(p.first) << delim << p.second << std::endl;
+    }
+
+    ofs.close();
+}
+
+}
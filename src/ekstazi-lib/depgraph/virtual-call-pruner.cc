@@ -0,0 +1,334 @@
+#include "ekstazi/depgraph/virtual-call-pruner.hh"
+
+#include <algorithm>
+
+namespace ekstazi
+{
+
+/**
+ * Condenses the old and the new dependency graph, before any virtual
+ * calls are added.
+ */
+VirtualCallPruner::VirtualCallPruner(CsrGraph const & old_graph, CsrGraph const & new_graph) :
+m_old_graph{ old_graph },
+m_new_graph{ new_graph },
+m_per_test{ false },
+m_calls{},
+m_tests{},
+m_class_indices{},
+m_class_constructors{},
+m_extra_nodes{},
+m_extra_symbols{},
+m_words{ 0 },
+m_old_bitsets{},
+m_new_bitsets{},
+m_class_bitsets{},
+m_live_bitsets{},
+m_predecessor_offsets{},
+m_predecessors{},
+m_added_predecessors{},
+m_node_classes{}
+{
+
+}
+
+/**
+ * Sets whether calls are decided per test.
+ */
+void VirtualCallPruner::set_per_test(bool per_test)
+{
+    m_per_test = per_test;
+}
+
+/**
+ * Adds a constructor of a class.
+ */
+void VirtualCallPruner::add_constructor(symbol_id class_id, symbol_id constructor)
+{
+    m_class_constructors[class_index_of(class_id)].push_back(constructor);
+    node_of(constructor);
+}
+
+/**
+ * Adds a virtual call from a caller to a virtual function of a class.
+ */
+void VirtualCallPruner::add_virtual_call(symbol_id caller, symbol_id callee, symbol_id class_id)
+{
+    m_calls.push_back(VirtualCall{ caller, callee, class_index_of(class_id) });
+    node_of(caller);
+    node_of(callee);
+}
+
+/**
+ * Decides all virtual calls. The bitsets of both graphs are propagated
+ * once over their components in reverse topological order. Then every
+ * undecided call is checked against the tests constructing its class,
+ * and the edges of the kept calls are propagated, until a round keeps
+ * no more calls. Bitsets only grow, so the result does not depend on
+ * the order of the calls. In per-test mode, calls are checked again
+ * until no call becomes live for any more tests.
+ */
+std::vector<uint32_t> VirtualCallPruner::prune(TestPredicate const & is_test)
+{
+    uint32_t num_old_components = m_old_graph.num_components();
+    uint32_t num_new_components = m_new_graph.num_components();
+
+    // Functions in both graphs are tests under the same number
+    m_tests.clear();
+    std::unordered_map<symbol_id, uint32_t> test_numbers;
+    std::vector<uint32_t> old_test_numbers = number_tests(m_old_graph.members(), is_test, test_numbers, m_tests);
+    std::vector<uint32_t> new_test_numbers = number_tests(m_new_graph.members(), is_test, test_numbers, m_tests);
+
+    // In per-test mode, callees get edges to tests, which need nodes in the new graph
+    if (m_per_test)
+    {
+        for (symbol_id test : m_tests)
+        {
+            node_of(test);
+        }
+    }
+    std::vector<uint32_t> extra_test_numbers = number_tests(m_extra_symbols, is_test, test_numbers, m_tests);
+    m_words = num_bitset_words(m_tests.size());
+    uint32_t num_nodes = num_new_components + m_extra_symbols.size();
+
+    // Tests reaching the components of both graphs, and the extra nodes
+    m_old_bitsets.assign(static_cast<size_t>(num_old_components) * m_words, 0);
+    propagate_test_bitsets(m_old_graph, old_test_numbers, m_words, m_old_bitsets);
+    m_new_bitsets.assign(static_cast<size_t>(num_nodes) * m_words, 0);
+    propagate_test_bitsets(m_new_graph, new_test_numbers, m_words, m_new_bitsets);
+    for (uint32_t i = 0; i < m_extra_symbols.size(); ++i)
+    {
+        uint32_t test_number = extra_test_numbers[i];
+        if (test_number != CsrGraph::invalid_index)
+        {
+            bitset(m_new_bitsets, num_new_components + i, m_words)[test_number / 64] |= uint64_t{ 1 } << (test_number % 64);
+        }
+    }
+
+    // Reverse the DAG edges of the new graph, for propagating along added edges
+    std::vector<uint32_t> const & successors = m_new_graph.successors();
+    m_predecessor_offsets.assign(num_nodes + 1, 0);
+    for (uint32_t successor : successors)
+    {
+        ++m_predecessor_offsets[successor + 1];
+    }
+    for (uint32_t n = 0; n < num_nodes; ++n)
+    {
+        m_predecessor_offsets[n + 1] += m_predecessor_offsets[n];
+    }
+    m_predecessors.resize(successors.size());
+    std::vector<uint32_t> next_predecessor(m_predecessor_offsets.begin(), m_predecessor_offsets.end() - 1);
+    for (uint32_t c = 0; c < num_new_components; ++c)
+    {
+        for (uint32_t e = m_new_graph.successor_begin(c); e < m_new_graph.successor_begin(c + 1); ++e)
+        {
+            m_predecessors[next_predecessor[successors[e]]++] = c;
+        }
+    }
+
+    // Tests constructing every class: the tests reaching any of its constructors
+    m_class_bitsets.assign(m_class_constructors.size() * m_words, 0);
+    for (uint32_t i = 0; i < m_class_constructors.size(); ++i)
+    {
+        uint64_t* bits = bitset(m_class_bitsets, i, m_words);
+        for (symbol_id constructor : m_class_constructors[i])
+        {
+            uint32_t component = m_old_graph.component_of(constructor);
+            if (component != CsrGraph::invalid_index)
+            {
+                merge_bitsets(bits, bitset(m_old_bitsets, component, m_words), m_words);
+            }
+            uint32_t node = node_of(constructor);
+            merge_bitsets(bits, bitset(m_new_bitsets, node, m_words), m_words);
+            m_node_classes[node].push_back(i);
+        }
+    }
+
+    // Keep the calls made by a test that constructs the class, until no more are kept
+    m_live_bitsets.assign(m_calls.size() * m_words, 0);
+    std::vector<uint64_t> new_live_bits(m_words);
+    std::vector<uint32_t> kept_calls;
+    bool changed = true;
+    while (changed)
+    {
+        changed = false;
+        for (uint32_t i = 0; i < m_calls.size(); ++i)
+        {
+            uint64_t* live_bits = bitset(m_live_bitsets, i, m_words);
+            bool kept = std::any_of(live_bits, live_bits + m_words, [](uint64_t word) { return word != 0; });
+            if (kept && !m_per_test)
+            {
+                continue;
+            }
+
+            VirtualCall const & call = m_calls[i];
+            uint64_t const * class_bits = bitset(m_class_bitsets, call.class_index, m_words);
+            uint64_t const * new_bits = bitset(m_new_bitsets, node_of(call.caller), m_words);
+            uint32_t old_component = m_old_graph.component_of(call.caller);
+            uint64_t const * old_bits = old_component != CsrGraph::invalid_index ? bitset(m_old_bitsets, old_component, m_words) : nullptr;
+
+            bool live = false;
+            for (uint32_t w = 0; w < m_words; ++w)
+            {
+                uint64_t caller_word = new_bits[w] | (old_bits != nullptr ? old_bits[w] : 0);
+                new_live_bits[w] = caller_word & class_bits[w] & ~live_bits[w];
+                live = live || new_live_bits[w] != 0;
+            }
+            if (!live)
+            {
+                continue;
+            }
+
+            merge_bitsets(live_bits, new_live_bits.data(), m_words);
+            if (!kept)
+            {
+                kept_calls.push_back(i);
+            }
+            changed = true;
+
+            if (!m_per_test)
+            {
+                add_edge(node_of(call.callee), node_of(call.caller));
+                continue;
+            }
+            for (uint32_t w = 0; w < m_words; ++w)
+            {
+                for (uint64_t word = new_live_bits[w]; word != 0; word &= word - 1)
+                {
+                    add_edge(node_of(call.callee), node_of(m_tests[w * 64 + __builtin_ctzll(word)]));
+                }
+            }
+        }
+    }
+
+    std::sort(kept_calls.begin(), kept_calls.end());
+    return kept_calls;
+}
+
+/**
+ * Returns the number of classes constructed by any test.
+ */
+uint32_t VirtualCallPruner::num_constructed_classes() const
+{
+    uint32_t num_constructed = 0;
+    for (uint32_t i = 0; i < m_class_constructors.size(); ++i)
+    {
+        uint64_t const * bits = bitset(m_class_bitsets, i, m_words);
+        if (std::any_of(bits, bits + m_words, [](uint64_t word) { return word != 0; }))
+        {
+            ++num_constructed;
+        }
+    }
+    return num_constructed;
+}
+
+/**
+ * Returns the tests that both reach the caller of a kept call and
+ * construct its class.
+ */
+std::vector<symbol_id> VirtualCallPruner::get_live_tests(uint32_t call) const
+{
+    std::vector<symbol_id> tests;
+    uint64_t const * live_bits = bitset(m_live_bitsets, call, m_words);
+    for (uint32_t w = 0; w < m_words; ++w)
+    {
+        for (uint64_t word = live_bits[w]; word != 0; word &= word - 1)
+        {
+            tests.push_back(m_tests[w * 64 + __builtin_ctzll(word)]);
+        }
+    }
+    return tests;
+}
+
+/**
+ * Returns the node of a symbol in the new graph. Symbols that are not
+ * in the graph get nodes of their own after its components.
+ */
+uint32_t VirtualCallPruner::node_of(symbol_id symbol)
+{
+    uint32_t component = m_new_graph.component_of(symbol);
+    if (component != CsrGraph::invalid_index)
+    {
+        return component;
+    }
+
+    auto it = m_extra_nodes.insert({ symbol, m_new_graph.num_components() + m_extra_symbols.size() });
+    if (it.second)
+    {
+        m_extra_symbols.push_back(symbol);
+    }
+    return it.first->second;
+}
+
+/**
+ * Returns the index of a class, adding it if it is new.
+ */
+uint32_t VirtualCallPruner::class_index_of(symbol_id class_id)
+{
+    auto it = m_class_indices.insert({ class_id, m_class_constructors.size() });
+    if (it.second)
+    {
+        m_class_constructors.emplace_back();
+    }
+    return it.first->second;
+}
+
+/**
+ * Adds an edge to the new graph, e.g. from the callee to the caller of
+ * a kept call. The tests reaching the dependent node now reach the node
+ * and everything it depends on, including the constructors among them,
+ * so they are propagated backwards along the edges until nothing
+ * changes.
+ */
+void VirtualCallPruner::add_edge(uint32_t node, uint32_t dependent_node)
+{
+    if (node == dependent_node)
+    {
+        return;
+    }
+
+    m_added_predecessors[dependent_node].push_back(node);
+    if (!merge_bitsets(bitset(m_new_bitsets, node, m_words), bitset(m_new_bitsets, dependent_node, m_words), m_words))
+    {
+        return;
+    }
+
+    std::vector<uint32_t> worklist{ node };
+    while (!worklist.empty())
+    {
+        uint32_t cur_node = worklist.back();
+        worklist.pop_back();
+        uint64_t const * bits = bitset(m_new_bitsets, cur_node, m_words);
+
+        auto classes_it = m_node_classes.find(cur_node);
+        if (classes_it != m_node_classes.end())
+        {
+            for (uint32_t class_index : classes_it->second)
+            {
+                merge_bitsets(bitset(m_class_bitsets, class_index, m_words), bits, m_words);
+            }
+        }
+
+        for (uint32_t p = m_predecessor_offsets[cur_node]; p < m_predecessor_offsets[cur_node + 1]; ++p)
+        {
+            if (merge_bitsets(bitset(m_new_bitsets, m_predecessors[p], m_words), bits, m_words))
+            {
+                worklist.push_back(m_predecessors[p]);
+            }
+        }
+
+        auto added_it = m_added_predecessors.find(cur_node);
+        if (added_it != m_added_predecessors.end())
+        {
+            for (uint32_t predecessor : added_it->second)
+            {
+                if (merge_bitsets(bitset(m_new_bitsets, predecessor, m_words), bits, m_words))
+                {
+                    worklist.push_back(predecessor);
+                }
+            }
+        }
+    }
+}
+
+}
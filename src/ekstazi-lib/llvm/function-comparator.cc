@@ -1,5 +1,6 @@
 
 #include "ekstazi/llvm/function-comparator.hh"
+#include "ekstazi/llvm/string-ref.hh"
 #include "ekstazi/test-frameworks/gtest/gtest-adapter.hh"
 
 #include "llvm/IR/Instructions.h"
@@ -10,29 +11,75 @@
 #include <iostream>
 #include <string>
 #include <iterator>
+#include <algorithm>
+#include <limits>
+#include <mutex>
 
 using namespace llvm;
 
 namespace ekstazi
 {
 
-FunctionComparator::HashAccumulator::HashAccumulator()
+template <typename HashPolicy>
+FunctionComparator::GlobalDigestCache<HashPolicy>::GlobalDigestCache() :
+m_mutex{},
+m_digests{}
 {
-    hash = 0x6acaa36bef8325c5ULL;
+
+}
+
+template <typename HashPolicy>
+bool FunctionComparator::GlobalDigestCache<HashPolicy>::find(GlobalVariable const * global_var, GlobalDigest & digest) const
+{
+    std::shared_lock<std::shared_mutex> lock{ m_mutex };
+    auto it = m_digests.find(global_var);
+    if (it == m_digests.end())
+    {
+        return false;
+    }
+    digest = it->second;
+    return true;
 }
 
-void FunctionComparator::HashAccumulator::add(uint64_t v)
+template <typename HashPolicy>
+void FunctionComparator::GlobalDigestCache<HashPolicy>::insert(GlobalVariable const * global_var, GlobalDigest const & digest)
 {
-    hash = hashing::detail::hash_16_bytes(hash, v);
+    std::unique_lock<std::shared_mutex> lock{ m_mutex };
+    m_digests.insert({ global_var, digest });
 }
 
-void FunctionComparator::HashAccumulator::add(std::string const & v)
+template <typename HashPolicy>
+size_t FunctionComparator::GlobalDigestCache<HashPolicy>::size() const
 {
-    hash += hash_value(v);
+    std::shared_lock<std::shared_mutex> lock{ m_mutex };
+    return m_digests.size();
+}
+
+template <typename HashPolicy>
+FunctionComparator::HashAccumulator<HashPolicy>::HashAccumulator(GlobalDigestCache<HashPolicy>* cache) :
+m_policy{},
+m_cache{ cache },
+m_globals_in_progress{},
+m_low_link{ std::numeric_limits<uint32_t>::max() }
+{
+
+}
+
+template <typename HashPolicy>
+void FunctionComparator::HashAccumulator<HashPolicy>::add(uint64_t v)
+{
+    m_policy.add_word(v);
+}
+
+template <typename HashPolicy>
+void FunctionComparator::HashAccumulator<HashPolicy>::add(std::string const & v)
+{
+    m_policy.add_bytes(v.data(), v.size());
 }
 
 // Hash LLVM constant values
-void FunctionComparator::HashAccumulator::add(llvm::Constant const * const_val)
+template <typename HashPolicy>
+void FunctionComparator::HashAccumulator<HashPolicy>::add(llvm::Constant const * const_val)
 {
     const_val = const_val->stripPointerCasts();
     // Constant* const_val = dyn_cast<Constant>(operand_val);
@@ -50,18 +97,23 @@ void FunctionComparator::HashAccumulator::add(llvm::Constant const * const_val)
             // errs() << *(const_int->getValue().getRawData()) << '\n';
         }
 
-        // For fp, we try to get the value as a double and then hash
+        // For fp, we hash the bit pattern, which works for every fp type
         else if (isa<ConstantFP>(const_val))
         {
             ConstantFP const * const_fp = dyn_cast<ConstantFP>(const_val);
-            add(const_fp->getValueAPF().convertToDouble());
+            APInt bits = const_fp->getValueAPF().bitcastToAPInt();
+            for (unsigned i = 0; i < bits.getNumWords(); ++i)
+            {
+                add(bits.getRawData()[i]);
+            }
         }
 
         // For strings, we need to get the bytes of the array
         else if (isa<ConstantDataSequential>(const_val))
         {
             ConstantDataSequential const * const_arr = dyn_cast<ConstantDataSequential>(const_val);
-            add(const_arr->getRawDataValues().str());
+            StringRef raw_data = const_arr->getRawDataValues();
+            m_policy.add_bytes(raw_data.data(), raw_data.size());
         }
     }
 
@@ -91,146 +143,205 @@ void FunctionComparator::HashAccumulator::add(llvm::Constant const * const_val)
 
         if (isa<GlobalVariable>(const_val))
         {
-            GlobalVariable const * global_var = dyn_cast<GlobalVariable>(const_val);
-            if (gtest::GtestAdapter::is_internal_function(global_var->getName()))
-            {
-                return;
-            }
-            if (global_var->hasInitializer())
-            {
-                // errs() << global_var->getName() << '\n';
-                Constant const * init_val = global_var->getInitializer();
-                add(init_val);
-            }
-            
+            add_global(dyn_cast<GlobalVariable>(const_val));
         }
     }
 }
 
-template <typename T>
-void FunctionComparator::HashAccumulator::add(T & v)
+// Fold the digest of a global's initializer into the hash
+template <typename HashPolicy>
+void FunctionComparator::HashAccumulator<HashPolicy>::add_global(GlobalVariable const * global_var)
 {
-    hash += hash_value(v);
+    auto it = std::find(m_globals_in_progress.begin(), m_globals_in_progress.end(), global_var);
+    if (it != m_globals_in_progress.end())
+    {
+        // A cycle of initializers; hash how far back it goes
+        uint32_t depth = it - m_globals_in_progress.begin();
+        m_low_link = std::min(m_low_link, depth);
+        add(m_globals_in_progress.size() - depth);
+        return;
+    }
+
+    GlobalDigest digest;
+    if (m_cache == nullptr || !m_cache->find(global_var, digest))
+    {
+        digest = compute_digest(global_var);
+    }
+    if (digest.has_digest)
+    {
+        add(digest.hash.low);
+        add(digest.hash.high);
+    }
 }
 
-// No finishing is required, because the entire hash value is used.
-uint64_t FunctionComparator::HashAccumulator::get_hash()
+// Hash a global's initializer on its own, and cache the digest unless
+// the initializer is part of a cycle. The digest of a global on a cycle
+// depends on the global the hashing entered the cycle at.
+template <typename HashPolicy>
+FunctionComparator::GlobalDigest FunctionComparator::HashAccumulator<HashPolicy>::compute_digest(GlobalVariable const * global_var)
 {
-    return hash;
+    GlobalDigest digest{ false, FunctionHash{ 0, 0 } };
+    if (gtest::GtestAdapter::is_internal_function(to_string_view(global_var->getName())) ||
+        !global_var->hasInitializer())
+    {
+        if (m_cache != nullptr)
+        {
+            m_cache->insert(global_var, digest);
+        }
+        return digest;
+    }
+
+    uint32_t depth = m_globals_in_progress.size();
+    uint32_t outer_low_link = m_low_link;
+    HashPolicy outer_policy = m_policy;
+    m_policy = HashPolicy{};
+    m_low_link = std::numeric_limits<uint32_t>::max();
+    m_globals_in_progress.push_back(global_var);
+
+    add(global_var->getInitializer());
+    digest = GlobalDigest{ true, m_policy.finish() };
+
+    m_globals_in_progress.pop_back();
+    bool self_contained = m_low_link > depth;
+    m_policy = outer_policy;
+    m_low_link = std::min(outer_low_link, m_low_link);
+
+    if (self_contained && m_cache != nullptr)
+    {
+        m_cache->insert(global_var, digest);
+    }
+    return digest;
 }
 
-FunctionComparator::FunctionHash FunctionComparator::functionHash(llvm::Function &F)
+template <typename HashPolicy>
+FunctionComparator::FunctionHash FunctionComparator::HashAccumulator<HashPolicy>::get_hash()
 {
-    HashAccumulator H;
-    H.add(F.isVarArg());
-    H.add(F.arg_size());
-    
-    SmallVector<const BasicBlock *, 8> BBs;
-    SmallSet<const BasicBlock *, 16> VisitedBBs;
+    return m_policy.finish();
+}
 
-    // Walk the blocks in the same order as
-    // FunctionComparator::cmpBasicBlocks(), accumulating the hash of
-    // the function "structure." (BB and opcode sequence).
-    BBs.push_back(&F.getEntryBlock());
-    VisitedBBs.insert(BBs[0]);
-    while (!BBs.empty()) {
-        const BasicBlock *BB = BBs.pop_back_val();
-        
-        // This random value acts as a block header, as otherwise the
-        // partition of opcodes into BBs wouldn't affect the hash,
-        // only the order of the opcodes.
-        H.add(45798);
-        for (auto &Inst : *BB) {
-            H.add(Inst.getOpcode());
-
-            // errs() << F.getName() << ';' << Inst.getOpcodeName() << '\n';
-
-            // Ignore call target offsetse
-            if (isa<CallInst>(Inst) || isa<InvokeInst>(Inst))
+namespace
+{
+
+// Hash the instructions of a block, optionally leaving out its terminator
+template <typename HashPolicy>
+void hash_block(FunctionComparator::HashAccumulator<HashPolicy> & H, BasicBlock const * BB, bool with_terminator)
+{
+    // This random value acts as a block header, as otherwise the
+    // partition of opcodes into BBs wouldn't affect the hash,
+    // only the order of the opcodes.
+    H.add(45798);
+    for (auto &Inst : *BB) {
+        if (!with_terminator && Inst.isTerminator())
+        {
+            continue;
+        }
+        H.add(Inst.getOpcode());
+
+        // errs() << F.getName() << ';' << Inst.getOpcodeName() << '\n';
+
+        // Ignore call target offsetse
+        if (isa<CallInst>(Inst) || isa<InvokeInst>(Inst))
+        {
+            if (isa<CallInst>(Inst))
             {
-                if (isa<CallInst>(Inst))
+                CallInst const * call_inst = dyn_cast<CallInst>(&Inst);
+                llvm::Function* called_fun = call_inst->getCalledFunction();
+                if (called_fun)
+                {
+                    // Skip the internal gtest functions that depend on code location of test
+                    if (ekstazi::gtest::GtestAdapter::is_internal_function(to_string_view(called_fun->getName())))
+                    {
+                        continue;
+                    }
+                }
+                for (Use const & arg : call_inst->arg_operands())
                 {
-                    CallInst const * call_inst = dyn_cast<CallInst>(&Inst);
-                    llvm::Function* called_fun = call_inst->getCalledFunction();
-                    if (called_fun)
+                    Value* val = arg.get();
+                    if (dyn_cast<llvm::Function>(val))
                     {
-                        // Skip the internal gtest functions that depend on code location of test
-                        if (ekstazi::gtest::GtestAdapter::is_internal_function(called_fun->getName()))
-                        {
-                            continue;
-                        }
+                        continue;
                     }
-                    for (Use const & arg : call_inst->arg_operands())
+                    if (isa<Constant>(val))
                     {
-                        Value* val = arg.get();
-                        if (dyn_cast<llvm::Function>(val))
-                        {
-                            continue;
-                        }
-                        if (isa<Constant>(val))
-                        {
-                            H.add(dyn_cast<Constant>(val));
-                        }
+                        H.add(dyn_cast<Constant>(val));
                     }
                 }
+            }
 
-                else
+            else
+            {
+                InvokeInst const * invoke_inst = dyn_cast<InvokeInst>(&Inst);
+                llvm::Function* called_fun = invoke_inst->getCalledFunction();
+                if (called_fun)
                 {
-                    InvokeInst const * invoke_inst = dyn_cast<InvokeInst>(&Inst);
-                    llvm::Function* called_fun = invoke_inst->getCalledFunction();
-                    if (called_fun)
+                    // Skip the internal gtest functions that depend on code location of test
+                    if (ekstazi::gtest::GtestAdapter::is_internal_function(to_string_view(called_fun->getName())))
                     {
-                        // Skip the internal gtest functions that depend on code location of test
-                        if (ekstazi::gtest::GtestAdapter::is_internal_function(called_fun->getName()))
-                        {
-                            continue;
-                        }
+                        continue;
                     }
-                    for (Use const & arg : invoke_inst->arg_operands())
+                }
+                for (Use const & arg : invoke_inst->arg_operands())
+                {
+                    Value* val = arg.get();
+                    if (dyn_cast<llvm::Function>(val))
+                    {
+                        continue;
+                    }
+                    if (isa<Constant>(val))
                     {
-                        Value* val = arg.get();
-                        if (dyn_cast<llvm::Function>(val))
-                        {
-                            continue;
-                        }
-                        if (isa<Constant>(val))
-                        {
-                            H.add(dyn_cast<Constant>(val));
-                        }
+                        H.add(dyn_cast<Constant>(val));
                     }
                 }
-                continue;
             }
+            continue;
+        }
+
+        // I tried here to get values for constants, but how do
+        // they store constants that are numbers (as constants can
+        // be many other things)?
+        // for (uint32_t i = 0; i < Inst.getNumOperands(); i++) {
+        //     Value *Val = Inst.getOperand(i);
+        //     if (isa<Constant>(*Val)) {
+        //         Constant *Const = (Constant*) Val;
+        //         if (Const->isOneValue()) {
+        //             std::cout << " " << Const->getUniqueInteger().toString(10, false) << std::endl;
+        //         }
+        //     }
+        // }
+        for (Value const * operand_val : Inst.operand_values())
+        {
+            // Value* operand_val = operand.get();
 
-            // I tried here to get values for constants, but how do
-            // they store constants that are numbers (as constants can
-            // be many other things)?
-            // for (uint32_t i = 0; i < Inst.getNumOperands(); i++) {
-            //     Value *Val = Inst.getOperand(i);
-            //     if (isa<Constant>(*Val)) {
-            //         Constant *Const = (Constant*) Val;
-            //         if (Const->isOneValue()) {
-            //             std::cout << " " << Const->getUniqueInteger().toString(10, false) << std::endl;
-            //         }
-            //     }
-            // }
-            for (Value const * operand_val : Inst.operand_values())
+            // H.add(operand_val->getValueID());
+            // std::string val_str;
+            // raw_string_ostream rso{ val_str };
+            // operand_val->print(rso);
+            // errs() << rso.str() << '\n';
+            // H.add(hashing::detail::hash_short(rso.str().c_str(), rso.str().length(), 0));
+            // std::hash<std::string>(operand);
+            if (isa<Constant>(operand_val))
             {
-                // Value* operand_val = operand.get();
-
-                // H.add(operand_val->getValueID());
-                // std::string val_str;
-                // raw_string_ostream rso{ val_str };
-                // operand_val->print(rso);
-                // errs() << rso.str() << '\n';
-                // H.add(hashing::detail::hash_short(rso.str().c_str(), rso.str().length(), 0));
-                // std::hash<std::string>(operand);
-                if (isa<Constant>(operand_val))
-                {
-                    H.add(dyn_cast<Constant>(operand_val));
-                }
+                H.add(dyn_cast<Constant>(operand_val));
             }
         }
+    }
+}
+
+// Hash the blocks reachable from a block
+template <typename HashPolicy>
+void hash_blocks_from(FunctionComparator::HashAccumulator<HashPolicy> & H, BasicBlock const * start)
+{
+    SmallVector<const BasicBlock *, 8> BBs;
+    SmallSet<const BasicBlock *, 16> VisitedBBs;
+
+    // Walk the blocks in the same order as
+    // FunctionComparator::cmpBasicBlocks(), accumulating the hash of
+    // the function "structure." (BB and opcode sequence).
+    BBs.push_back(start);
+    VisitedBBs.insert(BBs[0]);
+    while (!BBs.empty()) {
+        const BasicBlock *BB = BBs.pop_back_val();
+        hash_block(H, BB, true);
 
         const TerminatorInst *Term = BB->getTerminator();
         for (unsigned i = 0, e = Term->getNumSuccessors(); i != e; ++i) {
@@ -240,10 +351,81 @@ FunctionComparator::FunctionHash FunctionComparator::functionHash(llvm::Function
             BBs.push_back(Term->getSuccessor(i));
         }
     }
+}
+
+}
+
+template <typename HashPolicy>
+FunctionComparator::FunctionHash FunctionComparator::functionHash(llvm::Function &F, GlobalDigestCache<HashPolicy>* cache)
+{
+    HashAccumulator<HashPolicy> H{ cache };
+    H.add(F.isVarArg());
+    H.add(F.arg_size());
+    hash_blocks_from(H, &F.getEntryBlock());
 
     return H.get_hash();
     // FunctionComparator::FunctionHash h = llvm::FunctionComparator::functionHash(F);
     // return h;
 }
 
+// Summarize a dispatcher: the entry block without the switch, and the
+// blocks reachable from every case
+template <typename HashPolicy>
+DispatchSummary FunctionComparator::dispatchSummary(llvm::Function &F, GlobalDigestCache<HashPolicy>* cache)
+{
+    BasicBlock const & entry = F.getEntryBlock();
+    SwitchInst const * switch_inst = dyn_cast<SwitchInst>(entry.getTerminator());
+    if (!switch_inst)
+    {
+        return DispatchSummary{};
+    }
+
+    Argument const * arg = dyn_cast<Argument>(switch_inst->getCondition());
+    unsigned bit_width = switch_inst->getCondition()->getType()->getIntegerBitWidth();
+    if (!arg || bit_width > 64)
+    {
+        return DispatchSummary{};
+    }
+
+    HashAccumulator<HashPolicy> entry_hash{ cache };
+    entry_hash.add(F.isVarArg());
+    entry_hash.add(F.arg_size());
+    entry_hash.add(arg->getArgNo());
+    entry_hash.add(bit_width);
+    hash_block(entry_hash, &entry, false);
+
+    // Cases often share their blocks
+    std::unordered_map<BasicBlock const *, FunctionHash> region_hashes;
+    auto hash_region = [&region_hashes, cache](BasicBlock const * start)
+    {
+        auto it = region_hashes.find(start);
+        if (it == region_hashes.end())
+        {
+            HashAccumulator<HashPolicy> H{ cache };
+            hash_blocks_from(H, start);
+            it = region_hashes.insert({ start, H.get_hash() }).first;
+        }
+        return it->second;
+    };
+
+    DispatchSummary summary{ arg->getArgNo(), entry_hash.get_hash(), hash_region(switch_inst->getDefaultDest()) };
+    for (auto const & c : switch_inst->cases())
+    {
+        summary.add_case(c.getCaseValue()->getZExtValue(), hash_region(c.getCaseSuccessor()));
+    }
+    return summary;
+}
+
+template class FunctionComparator::GlobalDigestCache<Mix64HashPolicy>;
+template class FunctionComparator::GlobalDigestCache<Xxh128HashPolicy>;
+
+template class FunctionComparator::HashAccumulator<Mix64HashPolicy>;
+template class FunctionComparator::HashAccumulator<Xxh128HashPolicy>;
+
+template FunctionComparator::FunctionHash FunctionComparator::functionHash<Mix64HashPolicy>(llvm::Function &F, GlobalDigestCache<Mix64HashPolicy>* cache);
+template FunctionComparator::FunctionHash FunctionComparator::functionHash<Xxh128HashPolicy>(llvm::Function &F, GlobalDigestCache<Xxh128HashPolicy>* cache);
+
+template DispatchSummary FunctionComparator::dispatchSummary<Mix64HashPolicy>(llvm::Function &F, GlobalDigestCache<Mix64HashPolicy>* cache);
+template DispatchSummary FunctionComparator::dispatchSummary<Xxh128HashPolicy>(llvm::Function &F, GlobalDigestCache<Xxh128HashPolicy>* cache);
+
 }
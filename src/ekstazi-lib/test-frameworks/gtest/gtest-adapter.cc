@@ -5,6 +5,7 @@
 #include "ekstazi/test-frameworks/gtest/test-types/typed-test.hh"
 #include "ekstazi/test-frameworks/gtest/test-types/type-parameterized-test.hh"
 #include "ekstazi/utils/mangle.hh"
+#include "ekstazi/utils/mangled-prefix.hh"
 
 #include <sstream>
 #include <fstream>
@@ -21,6 +22,21 @@ namespace gtest
 
 std::string const GtestAdapter::bc_suffix = ".0.5.precodegen.bc";
 
+namespace
+{
+
+/**
+ * Classes and functions directly in namespace testing whose names start
+ * with one of these are internal.
+ */
+constexpr std::array<std::string_view, 4> internal_prefixes = {
+    "Assertion", "Message", "Test", "UnitTest",
+};
+
+static_assert(nested_component("_ZNK7testing8internal6FormatEv", 1) == "internal", "testing::internal::Format() const");
+
+}
+
 /**
  * Returns whether or not a function name in IR is an internal
  * googletest function. We will skip adding these to the dependency
@@ -28,15 +44,44 @@ std::string const GtestAdapter::bc_suffix = ".0.5.precodegen.bc";
  * 
  * @param fun_name the mangled function name
  */
-bool GtestAdapter::is_internal_function(std::string const & fun_name)
+bool GtestAdapter::is_internal_function(std::string_view fun_name)
 {
-    std::string demangled_name = demangle(fun_name);
+    // The demangled name can only mention testing if the mangled one does
+    if (fun_name.find("testing") == std::string_view::npos)
+    {
+        return false;
+    }
+
+    // Members of testing:: are decided by the name of their class or
+    // function, unless a return type would be demangled in front of them
+    // or testing::internal may appear further on
+    std::string_view member = nested_component(fun_name, 1);
+    if (nested_component(fun_name, 0) == "testing" && !member.empty())
+    {
+        if (starts_with(member, "internal"))
+        {
+            return true;
+        }
+        if (!may_have_return_type(fun_name))
+        {
+            if (starts_with_any(member, internal_prefixes))
+            {
+                return true;
+            }
+            if (fun_name.find("internal") == std::string_view::npos)
+            {
+                return false;
+            }
+        }
+    }
+
+    std::string_view demangled_name = demangle(fun_name);
     return
         // default testing:: namespace
         // demangled_name.find("testing::") == 0 ||
 
         // testing::internal functions
-        demangled_name.find("testing::internal") != std::string::npos ||
+        demangled_name.find("testing::internal") != std::string_view::npos ||
         demangled_name.find("testing::Assertion") == 0 ||
         demangled_name.find("testing::Message") == 0 ||
         demangled_name.find("testing::Test") == 0 ||
@@ -40,34 +40,48 @@ m_derived_adj_list{}
  * base of the derived type.
  */
 void TypeHierarchy::add_inheritance_relationship(std::string const & base_type_name, std::string const & derived_type_name)
+{
+    SymbolTable & symbols = SymbolTable::instance();
+    add_inheritance_relationship(symbols.intern(base_type_name), symbols.intern(derived_type_name));
+}
+
+void TypeHierarchy::add_inheritance_relationship(symbol_id base_type, symbol_id derived_type)
 {
     // base -(IS_BASE_OF)-> derived
-    std::list<std::string> & derived_types_for_base = m_derived_adj_list[base_type_name];
-    // std::list<std::string>::iterator it = std::find(derived_types_for_base.begin(), derived_types_for_base.end(), derived_type_name);
-    // if (it == derived_types_for_base.end())
-    // {
-    //     derived_types_for_base.push_back(derived_type_name);
-    // }
-    derived_types_for_base.push_back(derived_type_name);
+    m_derived_adj_list[base_type].insert(derived_type);
 
     // derived -(INHERITS_FROM)-> base
-    std::list<std::string> & super_types_for_derived = m_super_adj_list[derived_type_name];
-    // it = std::find(super_types_for_derived.begin(), super_types_for_derived.end(), base_type_name);
-    // if (it == super_types_for_derived.end())
-    // {
-    //     super_types_for_derived.push_back(base_type_name);
-    // }
-    super_types_for_derived.push_back(base_type_name);
+    m_super_adj_list[derived_type].insert(base_type);
 }
 
 std::unordered_set<std::string> TypeHierarchy::get_derived_types(std::string const & base_type_name)
 {
-    return bfs(base_type_name, m_derived_adj_list);
+    symbol_id base_type = SymbolTable::instance().find(base_type_name);
+    if (base_type == SymbolTable::invalid_id)
+    {
+        return {};
+    }
+    return to_names(get_derived_types(base_type));
+}
+
+std::unordered_set<symbol_id> TypeHierarchy::get_derived_types(symbol_id base_type)
+{
+    return bfs(base_type, m_derived_adj_list);
 }
 
 std::unordered_set<std::string> TypeHierarchy::get_super_types(std::string const & derived_type_name)
 {
-    return bfs(derived_type_name, m_super_adj_list);
+    symbol_id derived_type = SymbolTable::instance().find(derived_type_name);
+    if (derived_type == SymbolTable::invalid_id)
+    {
+        return {};
+    }
+    return to_names(get_super_types(derived_type));
+}
+
+std::unordered_set<symbol_id> TypeHierarchy::get_super_types(symbol_id derived_type)
+{
+    return bfs(derived_type, m_super_adj_list);
 }
 
 std::unordered_set<std::string> TypeHierarchy::get_all_related_types(std::string const & type_name)
@@ -110,41 +124,33 @@ uint32_t TypeHierarchy::num_derived_types() const
     return num_nonroot_nodes(m_derived_adj_list);
 }
 
-/**
- * Removes duplicates from adjacency list.
- */
-void TypeHierarchy::remove_duplicates()
-{
-    remove_duplicates(m_derived_adj_list);
-    remove_duplicates(m_super_adj_list);
-}
-
 /**
  * Prints the type hierarchy.
  */
 void TypeHierarchy::print(std::ostream & os)
 {
     os << derived_hierarchy_name << std::endl;
-    for (std::pair<std::string, std::list<std::string>> const & p : m_derived_adj_list)
+    SymbolTable const & symbols = SymbolTable::instance();
+    for (std::pair<symbol_id const, AdjacencySet> const & p : m_derived_adj_list)
     {
-        std::string const & base_type = p.first;
+        std::string const & base_type = symbols.name(p.first);
         os << base_type << delim;
-        for (std::string const & derived_type : p.second)
+        for (symbol_id derived_type : p.second)
         {
-            os << derived_type << delim;
+            os << symbols.name(derived_type) << delim;
         }
         os << std::endl;
     }
 
     os << super_hierarchy_name << std::endl;
 
-    for (std::pair<std::string, std::list<std::string>> const & p : m_super_adj_list)
+    for (std::pair<symbol_id const, AdjacencySet> const & p : m_super_adj_list)
     {
-        std::string const & derived_type = p.first;
+        std::string const & derived_type = symbols.name(p.first);
         os << derived_type << delim;
-        for (std::string const & base_type : p.second)
+        for (symbol_id base_type : p.second)
         {
-            os << base_type << delim;
+            os << symbols.name(base_type) << delim;
         }
         os << std::endl;
     }
@@ -165,6 +171,7 @@ void TypeHierarchy::save_file(std::string const & fname)
  */
 void TypeHierarchy::load_file(std::string const & fname)
 {
+    SymbolTable & symbols = SymbolTable::instance();
     std::ifstream ifs{ fname };
     std::string line;
     while(std::getline(ifs, line))
@@ -184,10 +191,11 @@ void TypeHierarchy::load_file(std::string const & fname)
                 std::getline(iss, base_type, delim);
 
                 // Parse all derived classes
+                AdjacencySet & derived_types = m_derived_adj_list[symbols.intern(base_type)];
                 std::string derived_type;
                 while (std::getline(iss, derived_type, delim))
                 {
-                    m_derived_adj_list[base_type].push_back(derived_type);
+                    derived_types.insert(symbols.intern(derived_type));
                 }
             }
         }
@@ -203,78 +211,49 @@ void TypeHierarchy::load_file(std::string const & fname)
                 std::getline(iss, derived_type, delim);
 
                 // Parse all base classes
+                AdjacencySet & base_types = m_super_adj_list[symbols.intern(derived_type)];
                 std::string base_type;
                 while (std::getline(iss, base_type, delim))
                 {
-                    m_super_adj_list[derived_type].push_back(base_type);
+                    base_types.insert(symbols.intern(base_type));
                 }
             }
         }
     }
 }
 
- /**
- * Removes duplicates from adjacency list.
+std::unordered_set<symbol_id> TypeHierarchy::get_all_children(symbol_id start_node, AdjacencyList const & adj_list)
+{
+    return bfs(start_node, adj_list);
+}
+
+/**
+ * Converts a set of type ids to their names.
  */
-void TypeHierarchy::remove_duplicates(std::unordered_map<std::string, std::list<std::string>> & adj_list)
+std::unordered_set<std::string> TypeHierarchy::to_names(std::unordered_set<symbol_id> const & ids)
 {
-    for (std::unordered_map<std::string, std::list<std::string>>::iterator it = adj_list.begin(); it != adj_list.end(); ++it)
+    SymbolTable const & symbols = SymbolTable::instance();
+    std::unordered_set<std::string> names;
+    for (symbol_id id : ids)
     {
-        it->second.sort();
-        it->second.unique();
+        names.insert(symbols.name(id));
     }
+    return names;
 }
 
-std::unordered_set<std::string> TypeHierarchy::get_all_children(std::string const & start_node, std::unordered_map<std::string, std::list<std::string>> const & adj_list)
+bool TypeHierarchy::contains(std::string const & class_name)
 {
-    std::unordered_set<std::string> dependents{};
-
-    // Conduct a breadth-first search
-    std::queue<std::string> visit_queue{};
-    std::unordered_set<std::string> visited{};
-
-    visit_queue.push(start_node);
-
-    while (!visit_queue.empty())
+    symbol_id class_id = SymbolTable::instance().find(class_name);
+    if (class_id == SymbolTable::invalid_id)
     {
-        // Get front element and mark as visited
-        std::string cur_node = visit_queue.front();
-        // std::cout << "Searching for children of " << cur_node << std::endl;
-        visit_queue.pop();
-        visited.insert(cur_node);
-
-        // Get all direct dependents
-        auto search = adj_list.find(cur_node);
-        // If not found, continue
-        if (search == adj_list.end())
-        {
-            // std::cout << "Not found in adjacency list: " << cur_node << std::endl;
-            continue;
-        }
-
-        std::list<std::string> const & direct_dependents = search->second;
-        dependents.insert(direct_dependents.begin(), direct_dependents.end());
-
-        // Add to visit_queue queue if not already visited
-        // std::cout << "Direct dependents of " << cur_node << ": " << std::endl;
-        for (std::string const & dependent : direct_dependents)
-        {
-            // std::cout << dependent << std::endl;
-            auto search = visited.find(dependent);
-            if (search == visited.end())
-            {
-                visit_queue.push(dependent);
-                // std::cout << "Added " << dependent << " to the visit queue." << std::endl;
-            }
-        }
+        return false;
     }
-
-    return dependents;
+    return contains(class_id);
 }
 
-bool TypeHierarchy::contains(std::string const & class_name)
+bool TypeHierarchy::contains(symbol_id class_id)
 {
-    auto it = m_derived_adj_list.find(class_name);
+    auto it = m_derived_adj_list.find(class_id);
     if (it != m_derived_adj_list.end())
     {
         return true;
@@ -283,9 +262,9 @@ bool TypeHierarchy::contains(std::string const & class_name)
     // Now search through all of the nodes
     for (auto & p : m_derived_adj_list)
     {
-        for (std::string const & name : p.second)
+        for (symbol_id id : p.second)
         {
-            if (class_name == name)
+            if (class_id == id)
             {
                 return true;
             }
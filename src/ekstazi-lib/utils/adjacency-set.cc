@@ -0,0 +1,184 @@
+#include "ekstazi/utils/adjacency-set.hh"
+
+#include <algorithm>
+
+namespace ekstazi
+{
+
+AdjacencySet::AdjacencySet() :
+m_inline{},
+m_size{ 0 },
+m_heap{},
+m_table{}
+{
+
+}
+
+/**
+ * Inserts a node, unless it is already in the set.
+ */
+bool AdjacencySet::insert(symbol_id node)
+{
+    if (contains(node))
+    {
+        return false;
+    }
+
+    if (m_size < inline_capacity)
+    {
+        m_inline[m_size++] = node;
+        return true;
+    }
+
+    if (m_size == inline_capacity)
+    {
+        m_heap.assign(m_inline, m_inline + inline_capacity);
+    }
+    m_heap.push_back(node);
+    ++m_size;
+
+    // Keep the table at most half full
+    if (m_size > hash_threshold && 2 * m_size > m_table.size())
+    {
+        rebuild_table();
+    }
+    else if (!m_table.empty())
+    {
+        m_table[find_slot(node)] = node;
+    }
+    return true;
+}
+
+/**
+ * Removes a node. The remaining nodes keep their order, so this is
+ * linear in the size of the set.
+ */
+bool AdjacencySet::erase(symbol_id node)
+{
+    if (!contains(node))
+    {
+        return false;
+    }
+
+    erase(std::unordered_set<symbol_id>{ node });
+    return true;
+}
+
+/**
+ * Removes all of the given nodes with a single pass over the set.
+ */
+void AdjacencySet::erase(std::unordered_set<symbol_id> const & nodes)
+{
+    symbol_id * nodes_begin = data();
+    symbol_id * nodes_end = std::remove_if(nodes_begin, nodes_begin + m_size, [&nodes](symbol_id node) {
+        return nodes.find(node) != nodes.end();
+    });
+
+    uint32_t new_size = nodes_end - nodes_begin;
+    if (new_size == m_size)
+    {
+        return;
+    }
+
+    if (m_size > inline_capacity)
+    {
+        m_heap.resize(new_size);
+        if (new_size <= inline_capacity)
+        {
+            std::copy(m_heap.begin(), m_heap.end(), m_inline);
+            m_heap = std::vector<symbol_id>{};
+        }
+    }
+    m_size = new_size;
+    rebuild_table();
+}
+
+/**
+ * Returns whether the node is in the set.
+ */
+bool AdjacencySet::contains(symbol_id node) const
+{
+    if (!m_table.empty())
+    {
+        return m_table[find_slot(node)] == node;
+    }
+
+    symbol_id const * nodes = data();
+    return std::find(nodes, nodes + m_size, node) != nodes + m_size;
+}
+
+size_t AdjacencySet::size() const
+{
+    return m_size;
+}
+
+bool AdjacencySet::empty() const
+{
+    return m_size == 0;
+}
+
+AdjacencySet::const_iterator AdjacencySet::begin() const
+{
+    return data();
+}
+
+AdjacencySet::const_iterator AdjacencySet::end() const
+{
+    return data() + m_size;
+}
+
+/**
+ * Returns the stored nodes, inline or on the heap.
+ */
+symbol_id * AdjacencySet::data()
+{
+    return m_size <= inline_capacity ? m_inline : m_heap.data();
+}
+
+symbol_id const * AdjacencySet::data() const
+{
+    return m_size <= inline_capacity ? m_inline : m_heap.data();
+}
+
+/**
+ * Returns the table slot holding the node, or the empty slot it would
+ * go in. The table size is a power of two and never full.
+ */
+size_t AdjacencySet::find_slot(symbol_id node) const
+{
+    size_t mask = m_table.size() - 1;
+    size_t slot = (node * uint32_t{ 2654435769u }) & mask;
+    while (m_table[slot] != node && m_table[slot] != SymbolTable::invalid_id)
+    {
+        slot = (slot + 1) & mask;
+    }
+    return slot;
+}
+
+/**
+ * Rebuilds the hash table for the current nodes, or drops it for small
+ * sets.
+ */
+void AdjacencySet::rebuild_table()
+{
+    if (m_size <= hash_threshold)
+    {
+        m_table = std::vector<symbol_id>{};
+        return;
+    }
+
+    size_t capacity = 2 * hash_threshold;
+    while (capacity < 4 * static_cast<size_t>(m_size))
+    {
+        capacity *= 2;
+    }
+
+    m_table.assign(capacity, SymbolTable::invalid_id);
+    symbol_id const * nodes = data();
+    for (uint32_t i = 0; i < m_size; ++i)
+    {
+        m_table[find_slot(nodes[i])] = nodes[i];
+    }
+}
+
+}
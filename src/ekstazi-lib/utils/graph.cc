@@ -1,72 +1,79 @@
 
 #include "ekstazi/utils/graph.hh"
+#include "ekstazi/depgraph/condensed-graph.hh"
 
 #include <queue>
+#include <algorithm>
 
 namespace ekstazi
 {
 
-std::unordered_set<std::string> bfs(std::string const & begin_node, std::unordered_map<std::string, std::list<std::string>> const & adj_list)
+namespace
 {
-    std::unordered_set<std::string> dependents{};
 
-    // Conduct a breadth-first search
-    std::queue<std::string> visit_queue{};
-    std::unordered_set<std::string> visited{};
-
-    visit_queue.push(begin_node);
+/**
+ * Returns the max distance of a BFS search from a node. Every entry of
+ * distances must be CsrGraph::invalid_index, and is again on return.
+ */
+uint32_t max_distance_bfs(uint32_t begin_node, CsrGraph const & graph, std::vector<uint32_t> & distances)
+{
+    std::vector<uint32_t> visit_queue{ begin_node };
+    distances[begin_node] = 0;
 
-    while (!visit_queue.empty())
+    uint32_t max_distance = 0;
+    for (size_t head = 0; head < visit_queue.size(); ++head)
     {
-        // Get front element and mark as visited
-        std::string cur_node = visit_queue.front();
-        // std::cout << "Searching for children of " << cur_node << std::endl;
-        visit_queue.pop();
-        visited.insert(cur_node);
-
-        // Get all direct dependents
-        auto search = adj_list.find(cur_node);
-        // If not found, continue
-        if (search == adj_list.end())
-        {
-            // std::cout << "Not found in adjacency list: " << cur_node << std::endl;
-            continue;
-        }
-
-        std::list<std::string> const & direct_dependents = search->second;
-        dependents.insert(direct_dependents.begin(), direct_dependents.end());
+        uint32_t cur_node = visit_queue[head];
+        uint32_t cur_distance = distances[cur_node];
+        max_distance = std::max(max_distance, cur_distance);
 
-        // Add to visit_queue queue if not already visited
-        // std::cout << "Direct dependents of " << cur_node << ": " << std::endl;
-        for (std::string const & dependent : direct_dependents)
+        for (uint32_t i = graph.begin(cur_node); i < graph.begin(cur_node + 1); ++i)
         {
-            // std::cout << dependent << std::endl;
-            auto search = visited.find(dependent);
-            if (search == visited.end())
+            uint32_t dependent = graph.edges()[i];
+            if (distances[dependent] == CsrGraph::invalid_index)
             {
-                visit_queue.push(dependent);
-                // std::cout << "Added " << dependent << " to the visit queue." << std::endl;
+                distances[dependent] = cur_distance + 1;
+                visit_queue.push_back(dependent);
             }
         }
     }
 
-    return dependents;
+    for (uint32_t node : visit_queue)
+    {
+        distances[node] = CsrGraph::invalid_index;
+    }
+
+    return max_distance;
 }
 
-std::unordered_set<std::string> dfs(std::string const & begin_node, std::unordered_map<std::string, std::list<std::string>> const & adj_list)
+}
+
+std::unordered_set<symbol_id> bfs(symbol_id begin_node, AdjacencyList const & adj_list)
 {
-    std::unordered_set<std::string> dependents{};
+    return bfs(std::vector<symbol_id>{ begin_node }, adj_list);
+}
+
+/**
+ * Conducts a single breadth-first search from several nodes at once and
+ * returns the union of the nodes reachable from each of them.
+ */
+std::unordered_set<symbol_id> bfs(std::vector<symbol_id> const & begin_nodes, AdjacencyList const & adj_list)
+{
+    std::unordered_set<symbol_id> dependents{};
 
     // Conduct a breadth-first search
-    std::queue<std::string> visit_queue{};
-    std::unordered_set<std::string> visited{};
+    std::queue<symbol_id> visit_queue{};
+    std::unordered_set<symbol_id> visited{};
 
-    visit_queue.push(begin_node);
+    for (symbol_id begin_node : begin_nodes)
+    {
+        visit_queue.push(begin_node);
+    }
 
     while (!visit_queue.empty())
     {
         // Get front element and mark as visited
-        std::string cur_node = visit_queue.front();
+        symbol_id cur_node = visit_queue.front();
         // std::cout << "Searching for children of " << cur_node << std::endl;
         visit_queue.pop();
         visited.insert(cur_node);
@@ -80,12 +87,12 @@ std::unordered_set<std::string> dfs(std::string const & begin_node, std::unorder
             continue;
         }
 
-        std::list<std::string> const & direct_dependents = search->second;
+        AdjacencySet const & direct_dependents = search->second;
         dependents.insert(direct_dependents.begin(), direct_dependents.end());
 
         // Add to visit_queue queue if not already visited
         // std::cout << "Direct dependents of " << cur_node << ": " << std::endl;
-        for (std::string const & dependent : direct_dependents)
+        for (symbol_id dependent : direct_dependents)
         {
             // std::cout << dependent << std::endl;
             auto search = visited.find(dependent);
@@ -100,32 +107,24 @@ std::unordered_set<std::string> dfs(std::string const & begin_node, std::unorder
     return dependents;
 }
 
-/**
- * Returns the max distance of a BFS search from a node.
- */
-uint32_t max_distance_bfs(std::string const & begin_node, std::unordered_map<std::string, std::list<std::string>> const & adj_list)
+std::unordered_set<symbol_id> dfs(symbol_id begin_node, AdjacencyList const & adj_list)
 {
-    // Conduct a breadth-first search
-    std::queue<std::string> visit_queue{};
-    std::unordered_set<std::string> visited{};
+    std::unordered_set<symbol_id> dependents{};
 
-    // Map of nodes to their distance from begin_node
-    std::unordered_map<std::string, uint32_t> distances;
+    // Conduct a breadth-first search
+    std::queue<symbol_id> visit_queue{};
+    std::unordered_set<symbol_id> visited{};
 
     visit_queue.push(begin_node);
-    distances[begin_node] = 0;
 
     while (!visit_queue.empty())
     {
         // Get front element and mark as visited
-        std::string cur_node = visit_queue.front();
+        symbol_id cur_node = visit_queue.front();
         // std::cout << "Searching for children of " << cur_node << std::endl;
         visit_queue.pop();
         visited.insert(cur_node);
 
-        // Save the current distance from begin_node
-        uint32_t cur_distance = distances[cur_node];
-
         // Get all direct dependents
         auto search = adj_list.find(cur_node);
         // If not found, continue
@@ -135,45 +134,36 @@ uint32_t max_distance_bfs(std::string const & begin_node, std::unordered_map<std
             continue;
         }
 
-        std::list<std::string> const & direct_dependents = search->second;
+        AdjacencySet const & direct_dependents = search->second;
+        dependents.insert(direct_dependents.begin(), direct_dependents.end());
 
         // Add to visit_queue queue if not already visited
         // std::cout << "Direct dependents of " << cur_node << ": " << std::endl;
-        for (std::string const & dependent : direct_dependents)
+        for (symbol_id dependent : direct_dependents)
         {
             // std::cout << dependent << std::endl;
             auto search = visited.find(dependent);
             if (search == visited.end())
             {
                 visit_queue.push(dependent);
-                distances[dependent] = cur_distance + 1;
                 // std::cout << "Added " << dependent << " to the visit queue." << std::endl;
             }
         }
     }
 
-    uint32_t max_distance = 0;
-    for (std::pair<std::string, uint32_t> const & p : distances)
-    {
-        if (p.second > max_distance)
-        {
-            max_distance = p.second;
-        }
-    }
-
-    return max_distance;
+    return dependents;
 }
 
 /**
  * Returns the leaf nodes in the graph.
  */
-std::unordered_set<std::string> find_leaf_nodes(std::unordered_map<std::string, std::list<std::string>> const & adj_list)
+std::unordered_set<symbol_id> find_leaf_nodes(AdjacencyList const & adj_list)
 {
-    std::unordered_set<std::string> leaf_nodes;
+    std::unordered_set<symbol_id> leaf_nodes;
     // Find all nodes in graph first and filter by leaves.
     // Leaves are nodes where either the adjacency list key doesn't exist, or
     // it does exist and the adjacency list for that node is empty
-    for (std::pair<std::string, std::list<std::string>> const & p : adj_list)
+    for (std::pair<symbol_id const, AdjacencySet> const & p : adj_list)
     {
         // Is a leaf if the list is empty.
         if (p.second.empty())
@@ -181,9 +171,9 @@ std::unordered_set<std::string> find_leaf_nodes(std::unordered_map<std::string,
             leaf_nodes.insert(p.first);
         }
         
-        for (std::string const & adjacent_node : p.second)
+        for (symbol_id adjacent_node : p.second)
         {
-            std::unordered_map<std::string, std::list<std::string>>::const_iterator it = adj_list.find(adjacent_node);
+            AdjacencyList::const_iterator it = adj_list.find(adjacent_node);
             // Is a leaf if the entry doesn't exist in the adjacency list
             if (it == adj_list.end())
             {
@@ -204,64 +194,62 @@ std::unordered_set<std::string> find_leaf_nodes(std::unordered_map<std::string,
 }
 
 /**
- * Reverses all edges in the graph.
+ * Returns the strongly connected components of the graph, in reverse
+ * topological order.
  */
-std::unordered_map<std::string, std::list<std::string>> reverse_edges(std::unordered_map<std::string, std::list<std::string>> const & adj_list)
+std::vector<std::vector<symbol_id>> strongly_connected_components(AdjacencyList const & adj_list)
 {
-    std::unordered_map<std::string, std::list<std::string>> reversed_adj_list;
-    for (std::pair<std::string, std::list<std::string>> const & p : adj_list)
+    CondensedGraph condensed{ CsrGraph{ adj_list } };
+    std::vector<symbol_id> const & members = condensed.members();
+
+    std::vector<std::vector<symbol_id>> components;
+    for (uint32_t c = 0; c < condensed.num_components(); ++c)
     {
-        for (std::string const & adjacent_node : p.second)
-        {
-            // Insert the edge but reversed
-            reversed_adj_list[adjacent_node].push_back(p.first);
-        }
+        components.emplace_back(members.begin() + condensed.member_begin(c), members.begin() + condensed.member_begin(c + 1));
     }
 
-    return reversed_adj_list;
+    return components;
 }
 
 /**
- * Returns the maximum distance of the graph between any 2 nodes.
+ * Returns the maximum distance of the graph between any 2 nodes, i.e.
+ * the largest BFS (shortest path) distance from any node.
  */
-uint32_t max_distance(std::unordered_map<std::string, std::list<std::string>> const & adj_list)
+uint32_t max_distance(AdjacencyList const & adj_list)
 {
-    std::vector<uint32_t> distances;
-    // Find max distances from all nodes
-    for (std::pair<std::string, std::list<std::string>> const & p : adj_list)
-    {
-        distances.push_back(max_distance_bfs(p.first, adj_list));
-    }
+    CsrGraph graph{ adj_list };
+    std::vector<uint32_t> distances(graph.num_nodes(), CsrGraph::invalid_index);
 
+    // Find max distances from all nodes
     uint32_t max_distance = 0;
-    for (uint32_t distance : distances)
+    for (uint32_t node = 0; node < graph.num_nodes(); ++node)
     {
-        if (distance > max_distance)
-        {
-            max_distance = distance;
-        }
+        max_distance = std::max(max_distance, max_distance_bfs(node, graph, distances));
     }
 
     return max_distance;
 }
 
 /**
- * Returns the average distance of the graph from all leaf nodes.
+ * Returns the average distance of the graph from all leaf nodes, where
+ * the distance of a leaf is its max BFS distance in the reversed graph.
  */
-double average_distance(std::unordered_map<std::string, std::list<std::string>> const & adj_list)
+double average_distance(AdjacencyList const & adj_list)
 {
     // Find all leaf nodes
-    std::unordered_set<std::string> leaf_nodes = find_leaf_nodes(adj_list);
+    std::unordered_set<symbol_id> leaf_nodes = find_leaf_nodes(adj_list);
 
     // Now reverse the edges in the graph and find the max distance for each leaf node
-    std::unordered_map<std::string, std::list<std::string>> reversed_adj_list = reverse_edges(adj_list);
+    CsrGraph reversed_graph = CsrGraph{ adj_list }.transpose();
+    std::vector<uint32_t> node_distances(reversed_graph.num_nodes(), CsrGraph::invalid_index);
 
     // Find max distances for each leaf node
     std::vector<uint32_t> distances;
-    
-    for (std::string const & leaf_node : leaf_nodes)
+
+    for (symbol_id leaf_node : leaf_nodes)
     {
-        distances.push_back(max_distance_bfs(leaf_node, reversed_adj_list));
+        uint32_t node = reversed_graph.index_of(leaf_node);
+        distances.push_back(node == CsrGraph::invalid_index ? 0 : max_distance_bfs(node, reversed_graph, node_distances));
     }
 
     double average_distance = 0;
@@ -278,13 +266,13 @@ double average_distance(std::unordered_map<std::string, std::list<std::string>>
 /**
  * Returns the number of nodes in the graph.
  */
-uint32_t num_nodes(std::unordered_map<std::string, std::list<std::string>> const & adj_list)
+uint32_t num_nodes(AdjacencyList const & adj_list)
 {
-    std::unordered_set<std::string> nodes;
-    for (std::pair<std::string, std::list<std::string>> const & p : adj_list)
+    std::unordered_set<symbol_id> nodes;
+    for (std::pair<symbol_id const, AdjacencySet> const & p : adj_list)
     {
         nodes.insert(p.first);
-        for (std::string const & adj_node : p.second)
+        for (symbol_id adj_node : p.second)
         {
             nodes.insert(adj_node);
         }
@@ -294,17 +282,19 @@ uint32_t num_nodes(std::unordered_map<std::string, std::list<std::string>> const
 }
 
 /**
- * Returns the number of non-root nodes in the graph.
+ * Returns the number of non-root nodes in the graph. Roots are the
+ * nodes without incoming edges, so these are exactly the nodes that
+ * appear as the destination of an edge.
  */
-uint32_t num_nonroot_nodes(std::unordered_map<std::string, std::list<std::string>> const & adj_list)
+uint32_t num_nonroot_nodes(AdjacencyList const & adj_list)
 {
-    uint32_t total_nodes = num_nodes(adj_list);
-    // First we reverse the graph, then count the number of non-leaf nodes.
-    std::unordered_map<std::string, std::list<std::string>> rev_adj_list = reverse_edges(adj_list);
-
-    std::unordered_set<std::string> leaf_nodes = find_leaf_nodes(rev_adj_list);
+    std::unordered_set<symbol_id> nonroot_nodes;
+    for (std::pair<symbol_id const, AdjacencySet> const & p : adj_list)
+    {
+        nonroot_nodes.insert(p.second.begin(), p.second.end());
+    }
 
-    return total_nodes - leaf_nodes.size();
+    return nonroot_nodes.size();
 }
 
-}
\ No newline at end of file
+}
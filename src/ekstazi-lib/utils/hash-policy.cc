@@ -0,0 +1,292 @@
+#include "ekstazi/utils/hash-policy.hh"
+
+#include <string_view>
+#include <functional>
+#include <sstream>
+#include <iomanip>
+#include <algorithm>
+#include <cstring>
+#include <cctype>
+
+#if defined(__AVX2__) || defined(__SSE2__)
+#include <immintrin.h>
+#endif
+
+namespace ekstazi
+{
+
+namespace
+{
+
+uint64_t const prime32_1 = 0x9E3779B1;
+uint64_t const prime32_2 = 0x85EBCA77;
+uint64_t const prime32_3 = 0xC2B2AE3D;
+uint64_t const prime64_1 = 0x9E3779B185EBCA87;
+uint64_t const prime64_2 = 0xC2B2AE3D27D4EB4F;
+uint64_t const prime64_3 = 0x165667B19E3779F9;
+uint64_t const prime64_4 = 0x85EBCA77C2B2AE63;
+uint64_t const prime64_5 = 0x27D4EB2F165667C5;
+
+/**
+ * Secret the input is XORed with. Stripe s of a block uses words s to
+ * s + 7, and the scramble at the end of a block uses words 8 to 15.
+ */
+alignas(32) uint64_t const secret[16] = {
+    0x2CB0F69F4ABEA221, 0x9417034723148989, 0xDD555950609DFE03, 0xDBAFB150DEB12800,
+    0x7E789B2E6C442CB6, 0xF41E5636C7E4F8C4, 0x0959D150F8FBA7E4, 0xA97316F13CDB9EEA,
+    0x74CD8258F9520068, 0x55C74A62E116868B, 0xD2F4C799A2023CBD, 0xDF98CB79A37B51B9,
+    0x396F5885524F3905, 0xAF1D56386CA3B276, 0xA9FFBE6B5104E85A, 0x6BD0C51B9FD533B3
+};
+
+/**
+ * Mixes two words into one, as llvm::hashing::detail::hash_16_bytes.
+ */
+uint64_t hash_16_bytes(uint64_t low, uint64_t high)
+{
+    uint64_t const mul = 0x9DDFEA08EB382D69;
+    uint64_t a = (low ^ high) * mul;
+    a ^= (a >> 47);
+    uint64_t b = (high ^ a) * mul;
+    b ^= (b >> 47);
+    b *= mul;
+    return b;
+}
+
+/**
+ * Multiplies two words to 128 bits and folds the halves of the product.
+ */
+uint64_t mul_fold(uint64_t lhs, uint64_t rhs)
+{
+    unsigned __int128 product = static_cast<unsigned __int128>(lhs) * rhs;
+    return static_cast<uint64_t>(product) ^ static_cast<uint64_t>(product >> 64);
+}
+
+/**
+ * Final mix, so every input bit affects every output bit.
+ */
+uint64_t avalanche(uint64_t hash)
+{
+    hash ^= hash >> 37;
+    hash *= 0x165667919E3779F9;
+    hash ^= hash >> 32;
+    return hash;
+}
+
+/**
+ * Folds a stripe into the accumulators with the secret at the given
+ * word offset. Lane i adds the product of the halves of its input word
+ * XORed with the secret, and lane i ^ 1 adds the input word itself.
+ */
+void accumulate(uint64_t* acc, unsigned char const * stripe, size_t secret_offset)
+{
+#if defined(__AVX2__)
+    for (size_t i = 0; i < Xxh128HashPolicy::num_lanes; i += 4)
+    {
+        __m256i data = _mm256_loadu_si256(reinterpret_cast<__m256i const *>(stripe + i * 8));
+        __m256i key = _mm256_xor_si256(data, _mm256_loadu_si256(reinterpret_cast<__m256i const *>(secret + secret_offset + i)));
+        __m256i product = _mm256_mul_epu32(key, _mm256_srli_epi64(key, 32));
+        __m256i swapped = _mm256_shuffle_epi32(data, _MM_SHUFFLE(1, 0, 3, 2));
+        __m256i* lanes = reinterpret_cast<__m256i*>(acc + i);
+        _mm256_store_si256(lanes, _mm256_add_epi64(_mm256_load_si256(lanes), _mm256_add_epi64(product, swapped)));
+    }
+#elif defined(__SSE2__)
+    for (size_t i = 0; i < Xxh128HashPolicy::num_lanes; i += 2)
+    {
+        __m128i data = _mm_loadu_si128(reinterpret_cast<__m128i const *>(stripe + i * 8));
+        __m128i key = _mm_xor_si128(data, _mm_loadu_si128(reinterpret_cast<__m128i const *>(secret + secret_offset + i)));
+        __m128i product = _mm_mul_epu32(key, _mm_srli_epi64(key, 32));
+        __m128i swapped = _mm_shuffle_epi32(data, _MM_SHUFFLE(1, 0, 3, 2));
+        __m128i* lanes = reinterpret_cast<__m128i*>(acc + i);
+        _mm_store_si128(lanes, _mm_add_epi64(_mm_load_si128(lanes), _mm_add_epi64(product, swapped)));
+    }
+#else
+    for (size_t i = 0; i < Xxh128HashPolicy::num_lanes; ++i)
+    {
+        uint64_t data;
+        std::memcpy(&data, stripe + i * 8, sizeof(data));
+        uint64_t key = data ^ secret[secret_offset + i];
+        acc[i ^ 1] += data;
+        acc[i] += (key & 0xFFFFFFFF) * (key >> 32);
+    }
+#endif
+}
+
+}
+
+bool Hash128::operator==(Hash128 const & other) const
+{
+    return low == other.low && high == other.high;
+}
+
+bool Hash128::operator!=(Hash128 const & other) const
+{
+    return !(*this == other);
+}
+
+/**
+ * Returns the hash as 32 hexadecimal digits, high half first.
+ */
+std::string Hash128::to_string() const
+{
+    std::ostringstream oss;
+    oss << std::hex << std::setfill('0') << std::setw(16) << high << std::setw(16) << low;
+    return oss.str();
+}
+
+/**
+ * Parses a hash written by to_string().
+ */
+bool Hash128::from_string(std::string const & str, Hash128 & hash)
+{
+    if (str.size() != 32 || !std::all_of(str.begin(), str.end(), [](char c) { return std::isxdigit(static_cast<unsigned char>(c)); }))
+    {
+        return false;
+    }
+
+    hash.high = std::stoull(str.substr(0, 16), nullptr, 16);
+    hash.low = std::stoull(str.substr(16, 16), nullptr, 16);
+    return true;
+}
+
+Mix64HashPolicy::Mix64HashPolicy() :
+m_hash{ 0x6ACAA36BEF8325C5 }
+{
+
+}
+
+void Mix64HashPolicy::add_word(uint64_t word)
+{
+    m_hash = hash_16_bytes(m_hash, word);
+}
+
+void Mix64HashPolicy::add_bytes(char const * data, size_t size)
+{
+    m_hash += std::hash<std::string_view>{}(std::string_view{ data, size });
+}
+
+Hash128 Mix64HashPolicy::finish() const
+{
+    return Hash128{ m_hash, 0 };
+}
+
+Xxh128HashPolicy::Xxh128HashPolicy() :
+m_acc{ prime32_3, prime64_1, prime64_2, prime64_3, prime64_4, prime32_2, prime64_5, prime32_1 },
+m_buffer{},
+m_buffer_size{ 0 },
+m_block_stripes{ 0 },
+m_total_size{ 0 }
+{
+
+}
+
+/**
+ * Appends a word to the stream. Words that fit into the incomplete
+ * stripe are copied directly.
+ */
+void Xxh128HashPolicy::add_word(uint64_t word)
+{
+    if (m_buffer_size + sizeof(word) > stripe_size)
+    {
+        append(reinterpret_cast<unsigned char const *>(&word), sizeof(word));
+        return;
+    }
+
+    std::memcpy(m_buffer + m_buffer_size, &word, sizeof(word));
+    m_buffer_size += sizeof(word);
+    m_total_size += sizeof(word);
+    if (m_buffer_size == stripe_size)
+    {
+        consume_stripe(m_buffer);
+        m_buffer_size = 0;
+    }
+}
+
+/**
+ * Appends a byte string to the stream, preceded by its length.
+ */
+void Xxh128HashPolicy::add_bytes(char const * data, size_t size)
+{
+    add_word(size);
+    append(reinterpret_cast<unsigned char const *>(data), size);
+}
+
+/**
+ * Returns the hash of the stream so far. The incomplete stripe is
+ * padded with zeros; the total size mixed into the result tells it
+ * apart from explicit zeros.
+ */
+Hash128 Xxh128HashPolicy::finish() const
+{
+    alignas(32) uint64_t acc[num_lanes];
+    std::copy(m_acc, m_acc + num_lanes, acc);
+    if (m_buffer_size > 0)
+    {
+        alignas(32) unsigned char last_stripe[stripe_size] = {};
+        std::memcpy(last_stripe, m_buffer, m_buffer_size);
+        accumulate(acc, last_stripe, m_block_stripes);
+    }
+
+    uint64_t low = m_total_size * prime64_1;
+    uint64_t high = ~(m_total_size * prime64_2);
+    for (size_t i = 0; i < num_lanes; i += 2)
+    {
+        low += mul_fold(acc[i] ^ secret[i], acc[i + 1] ^ secret[i + 1]);
+        high += mul_fold(acc[i] ^ secret[15 - i], acc[i + 1] ^ secret[14 - i]);
+    }
+    return Hash128{ avalanche(low), avalanche(high) };
+}
+
+/**
+ * Appends bytes to the stream. Complete stripes are consumed straight
+ * from the input once the incomplete stripe has been filled.
+ */
+void Xxh128HashPolicy::append(unsigned char const * data, size_t size)
+{
+    m_total_size += size;
+    if (m_buffer_size > 0)
+    {
+        size_t num_bytes = std::min(size, stripe_size - m_buffer_size);
+        std::memcpy(m_buffer + m_buffer_size, data, num_bytes);
+        m_buffer_size += num_bytes;
+        data += num_bytes;
+        size -= num_bytes;
+        if (m_buffer_size < stripe_size)
+        {
+            return;
+        }
+        consume_stripe(m_buffer);
+        m_buffer_size = 0;
+    }
+
+    for (; size >= stripe_size; data += stripe_size, size -= stripe_size)
+    {
+        consume_stripe(data);
+    }
+
+    std::memcpy(m_buffer, data, size);
+    m_buffer_size = size;
+}
+
+/**
+ * Folds a stripe into the accumulators, and scrambles them at the end
+ * of a block so the lanes do not just keep adding up.
+ */
+void Xxh128HashPolicy::consume_stripe(unsigned char const * stripe)
+{
+    accumulate(m_acc, stripe, m_block_stripes);
+    if (++m_block_stripes < stripes_per_block)
+    {
+        return;
+    }
+
+    for (size_t i = 0; i < num_lanes; ++i)
+    {
+        uint64_t acc = m_acc[i];
+        acc ^= acc >> 47;
+        acc ^= secret[8 + i];
+        m_acc[i] = acc * prime32_1;
+    }
+    m_block_stripes = 0;
+}
+
+}
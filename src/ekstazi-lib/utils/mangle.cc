@@ -1,17 +1,154 @@
-
 #include "ekstazi/utils/mangle.hh"
+#include "ekstazi/utils/mangled-prefix.hh"
 
-#include <memory>
+#include <cstring>
+#include <algorithm>
+#include <mutex>
 
 namespace ekstazi
 {
 
-std::string demangle(std::string const & name)
+namespace
+{
+
+/**
+ * Size of an arena block.
+ */
+size_t const block_size = 64 * 1024;
+
+/**
+ * Mangled prefixes of names in namespace std or __gnu_cxx. St, Sa, Sb,
+ * Ss, Si, So and Sd are the abbreviations for std:: and some of its
+ * classes.
+ */
+constexpr std::array<std::string_view, 19> std_prefixes = {
+    "_ZSt", "_ZNSt", "_ZNKSt",
+    "_ZNSa", "_ZNKSa", "_ZNSb", "_ZNKSb", "_ZNSs", "_ZNKSs",
+    "_ZNSi", "_ZNKSi", "_ZNSo", "_ZNKSo", "_ZNSd", "_ZNKSd",
+    "_ZN3std", "_ZNK3std",
+    "_ZN9__gnu_cxx", "_ZNK9__gnu_cxx",
+};
+
+/**
+ * Parts of a mangled name without which its demangled form cannot
+ * contain "std::" or "__gnu_cxx::". "std" also covers identifiers
+ * ending in std, whose demangled form would match as well.
+ */
+constexpr std::array<std::string_view, 9> std_parts = {
+    "std", "St", "Sa", "Sb", "Ss", "Si", "So", "Sd", "__gnu_cxx",
+};
+
+static_assert(starts_with_any("_ZNSt6vectorIiSaIiEE9push_backERKi", std_prefixes), "std::vector member");
+static_assert(!contains_any("_ZN3foo3barEv", std_parts), "foo::bar()");
+
+}
+
+/**
+ * Returns the process-wide demangle cache.
+ */
+DemangleCache & DemangleCache::instance()
+{
+    static DemangleCache cache;
+    return cache;
+}
+
+DemangleCache::DemangleCache() :
+m_blocks{},
+m_block_used{ block_size },
+m_names{},
+m_mutex{}
+{
+
+}
+
+/**
+ * Returns the demangled name, or the name itself if it is not a
+ * mangled name. Only the first lookup of a name demangles it, outside
+ * of the lock; if another thread stored the name in the meantime, its
+ * entry is returned.
+ */
+std::string_view DemangleCache::demangle(std::string_view name)
 {
+    {
+        std::shared_lock<std::shared_mutex> lock{ m_mutex };
+        auto it = m_names.find(name);
+        if (it != m_names.end())
+        {
+            return it->second;
+        }
+    }
+
+    // __cxa_demangle needs a null-terminated name
+    std::string mangled{ name };
     int status = -1;
+    std::unique_ptr<char, void(*)(void*)> res { abi::__cxa_demangle(mangled.c_str(), NULL, NULL, &status), std::free };
+
+    std::unique_lock<std::shared_mutex> lock{ m_mutex };
+    auto it = m_names.find(name);
+    if (it != m_names.end())
+    {
+        return it->second;
+    }
+
+    std::string_view key = store(name);
+    std::string_view demangled = (status == 0) ? store(res.get()) : key;
+    m_names.insert({ key, demangled });
+    return demangled;
+}
+
+/**
+ * Returns the number of cached names.
+ */
+size_t DemangleCache::size() const
+{
+    std::shared_lock<std::shared_mutex> lock{ m_mutex };
+    return m_names.size();
+}
+
+/**
+ * Copies a string into the arena and returns a view of the copy. The
+ * caller holds the exclusive lock.
+ */
+std::string_view DemangleCache::store(std::string_view str)
+{
+    if (m_blocks.empty() || str.size() > block_size - m_block_used)
+    {
+        // Oversized strings get a block of their own. The rest of the
+        // current block is given up in both cases.
+        m_blocks.emplace_back(new char[std::max(block_size, str.size())]);
+        m_block_used = 0;
+    }
+
+    char* dst = m_blocks.back().get() + m_block_used;
+    std::memcpy(dst, str.data(), str.size());
+    m_block_used = str.size() > block_size ? block_size : m_block_used + str.size();
+    return std::string_view{ dst, str.size() };
+}
+
+std::string_view demangle(std::string_view name)
+{
+    return DemangleCache::instance().demangle(name);
+}
+
+/**
+ * Returns whether the demangled form of a name contains "std::" or
+ * "__gnu_cxx::". Names are only demangled if neither their prefix nor
+ * the absence of any std abbreviation decides it.
+ */
+bool is_std_name(std::string_view name)
+{
+    if (starts_with_any(name, std_prefixes))
+    {
+        return true;
+    }
+    if (!contains_any(name, std_parts))
+    {
+        return false;
+    }
 
-    std::unique_ptr<char, void(*)(void*)> res { abi::__cxa_demangle(name.c_str(), NULL, NULL, &status), std::free };
-    return (status == 0) ? res.get() : std::string(name);
+    std::string_view demangled = demangle(name);
+    return demangled.find("std::") != std::string_view::npos ||
+           demangled.find("__gnu_cxx::") != std::string_view::npos;
 }
 
 }
@@ -0,0 +1,255 @@
+#include "ekstazi/utils/symbol-rules.hh"
+
+#include <fstream>
+#include <sstream>
+#include <limits>
+#include <algorithm>
+#include <tuple>
+
+namespace ekstazi
+{
+
+namespace
+{
+
+/**
+ * Marks a missing trie transition while the automaton is built.
+ */
+uint32_t const no_state = std::numeric_limits<uint32_t>::max();
+
+}
+
+SymbolRules::SymbolRules() :
+m_rules{},
+m_has_include{ false },
+m_char_class{},
+m_num_classes{ 1 },
+m_transitions{},
+m_output_offsets{},
+m_outputs{}
+{
+
+}
+
+/**
+ * Adds a rule. Empty patterns are ignored.
+ */
+void SymbolRules::add_rule(bool exclude, bool prefix, std::string const & pattern)
+{
+    if (pattern.empty())
+    {
+        return;
+    }
+
+    m_rules.push_back(Rule{ pattern, exclude, prefix });
+    m_has_include = m_has_include || !exclude;
+}
+
+/**
+ * Loads the rules from a file and compiles them. Malformed lines are
+ * skipped.
+ */
+uint32_t SymbolRules::load_file(std::string const & fname)
+{
+    std::ifstream ifs{ fname };
+    char delim = ';';
+    uint32_t num_rules = 0;
+
+    std::string line;
+    while (std::getline(ifs, line))
+    {
+        if (line.empty() || line[0] == '#')
+        {
+            continue;
+        }
+
+        std::istringstream iss{ line };
+        std::string action;
+        std::string kind;
+        std::string pattern;
+        std::getline(iss, action, delim);
+        std::getline(iss, kind, delim);
+        std::getline(iss, pattern);
+
+        if ((action != "exclude" && action != "include") ||
+            (kind != "prefix" && kind != "substring") ||
+            pattern.empty())
+        {
+            continue;
+        }
+
+        add_rule(action == "exclude", kind == "prefix", pattern);
+        ++num_rules;
+    }
+
+    compile();
+    return num_rules;
+}
+
+/**
+ * Builds the automaton for all rules added so far: a trie of the
+ * patterns, completed into a full transition table by following the
+ * failure links in breadth-first order.
+ */
+void SymbolRules::compile()
+{
+    // Alphabet of the patterns
+    std::fill(m_char_class, m_char_class + 256, 0);
+    m_num_classes = 1;
+    for (Rule const & rule : m_rules)
+    {
+        for (char c : rule.pattern)
+        {
+            uint16_t & char_class = m_char_class[static_cast<uint8_t>(c)];
+            if (char_class == 0)
+            {
+                char_class = m_num_classes++;
+            }
+        }
+    }
+
+    // Trie of the patterns
+    m_transitions.assign(m_num_classes, no_state);
+    std::vector<std::vector<uint32_t>> outputs(1);
+    for (uint32_t i = 0; i < m_rules.size(); ++i)
+    {
+        uint32_t state = 0;
+        for (char c : m_rules[i].pattern)
+        {
+            uint32_t & next = m_transitions[state * m_num_classes + m_char_class[static_cast<uint8_t>(c)]];
+            if (next == no_state)
+            {
+                next = outputs.size();
+                outputs.emplace_back();
+                m_transitions.resize(m_transitions.size() + m_num_classes, no_state);
+            }
+            state = m_transitions[state * m_num_classes + m_char_class[static_cast<uint8_t>(c)]];
+        }
+        outputs[state].push_back(i);
+    }
+
+    // Failure links. A state's failure state is shallower, so it is
+    // complete by the time the state is visited.
+    uint32_t num_states = outputs.size();
+    std::vector<uint32_t> fail(num_states, 0);
+    std::vector<uint32_t> queue;
+    queue.reserve(num_states);
+    for (uint32_t c = 0; c < m_num_classes; ++c)
+    {
+        uint32_t & next = m_transitions[c];
+        if (next == no_state)
+        {
+            next = 0;
+        }
+        else
+        {
+            queue.push_back(next);
+        }
+    }
+
+    for (size_t head = 0; head < queue.size(); ++head)
+    {
+        uint32_t state = queue[head];
+        std::vector<uint32_t> const & fail_outputs = outputs[fail[state]];
+        outputs[state].insert(outputs[state].end(), fail_outputs.begin(), fail_outputs.end());
+
+        for (uint32_t c = 0; c < m_num_classes; ++c)
+        {
+            uint32_t & next = m_transitions[state * m_num_classes + c];
+            uint32_t fail_next = m_transitions[fail[state] * m_num_classes + c];
+            if (next == no_state)
+            {
+                next = fail_next;
+            }
+            else
+            {
+                fail[next] = fail_next;
+                queue.push_back(next);
+            }
+        }
+    }
+
+    m_output_offsets.assign(1, 0);
+    m_outputs.clear();
+    for (std::vector<uint32_t> const & state_outputs : outputs)
+    {
+        m_outputs.insert(m_outputs.end(), state_outputs.begin(), state_outputs.end());
+        m_output_offsets.push_back(m_outputs.size());
+    }
+}
+
+/**
+ * Returns whether there are no rules.
+ */
+bool SymbolRules::empty() const
+{
+    return m_rules.empty();
+}
+
+/**
+ * Returns a digest of the rules, hashed in a canonical order since the
+ * order of the rules does not affect which names they exclude.
+ */
+Hash128 SymbolRules::digest() const
+{
+    std::vector<Rule const *> rules;
+    for (Rule const & rule : m_rules)
+    {
+        rules.push_back(&rule);
+    }
+    std::sort(rules.begin(), rules.end(), [](Rule const * a, Rule const * b) {
+        return std::tie(a->exclude, a->prefix, a->pattern) < std::tie(b->exclude, b->prefix, b->pattern);
+    });
+
+    Xxh128HashPolicy hash;
+    hash.add_word(rules.size());
+    for (Rule const * rule : rules)
+    {
+        hash.add_word(uint64_t{ rule->exclude } << 1 | uint64_t{ rule->prefix });
+        hash.add_bytes(rule->pattern.data(), rule->pattern.size());
+    }
+    return hash.finish();
+}
+
+/**
+ * Returns whether a demangled name is excluded by the rules. The name
+ * is scanned once; every rule matching at a position is reported by
+ * the state the automaton is in after it.
+ */
+bool SymbolRules::is_excluded(std::string_view name) const
+{
+    if (m_transitions.empty())
+    {
+        return false;
+    }
+
+    bool excluded = false;
+    uint32_t state = 0;
+    for (size_t i = 0; i < name.size(); ++i)
+    {
+        state = m_transitions[state * m_num_classes + m_char_class[static_cast<uint8_t>(name[i])]];
+        for (uint32_t o = m_output_offsets[state]; o < m_output_offsets[state + 1]; ++o)
+        {
+            Rule const & rule = m_rules[m_outputs[o]];
+            if (rule.prefix && rule.pattern.size() != i + 1)
+            {
+                continue;
+            }
+            if (!rule.exclude)
+            {
+                return false;
+            }
+            excluded = true;
+        }
+
+        // Without include rules the first exclude match decides
+        if (excluded && !m_has_include)
+        {
+            return true;
+        }
+    }
+
+    return excluded;
+}
+
+}
@@ -0,0 +1,99 @@
+#include "ekstazi/utils/symbol-table.hh"
+
+#include <limits>
+
+namespace ekstazi
+{
+
+/**
+ * Id returned for symbols that have not been interned.
+ */
+symbol_id const SymbolTable::invalid_id = std::numeric_limits<symbol_id>::max();
+
+/**
+ * Returns the process-wide symbol table.
+ */
+SymbolTable & SymbolTable::instance()
+{
+    static SymbolTable symbols;
+    return symbols;
+}
+
+SymbolTable::SymbolTable() :
+m_names{},
+m_ids{},
+m_guid_ids{}
+{
+
+}
+
+/**
+ * Returns the id of a name, interning it if it has not been seen yet.
+ */
+symbol_id SymbolTable::intern(std::string const & name)
+{
+    auto it = m_ids.find(name);
+    if (it != m_ids.end())
+    {
+        return it->second;
+    }
+
+    symbol_id id = m_names.size();
+    m_names.push_back(name);
+    m_ids.insert({ m_names.back(), id });
+    return id;
+}
+
+/**
+ * Interns a name and registers it under the given LLVM GUID.
+ */
+symbol_id SymbolTable::intern(uint64_t guid, std::string const & name)
+{
+    symbol_id id = intern(name);
+    m_guid_ids[guid] = id;
+    return id;
+}
+
+/**
+ * Returns the id of a name, or invalid_id if it was never interned.
+ */
+symbol_id SymbolTable::find(std::string const & name) const
+{
+    auto it = m_ids.find(name);
+    if (it == m_ids.end())
+    {
+        return invalid_id;
+    }
+    return it->second;
+}
+
+/**
+ * Returns the id registered for a GUID, or invalid_id if there is none.
+ */
+symbol_id SymbolTable::find_guid(uint64_t guid) const
+{
+    auto it = m_guid_ids.find(guid);
+    if (it == m_guid_ids.end())
+    {
+        return invalid_id;
+    }
+    return it->second;
+}
+
+/**
+ * Returns the name of an interned symbol.
+ */
+std::string const & SymbolTable::name(symbol_id id) const
+{
+    return m_names[id];
+}
+
+/**
+ * Returns the number of interned symbols.
+ */
+uint32_t SymbolTable::size() const
+{
+    return m_names.size();
+}
+
+}
@@ -0,0 +1,137 @@
+#include "ekstazi/utils/thread-pool.hh"
+
+#include <algorithm>
+
+namespace ekstazi
+{
+
+/**
+ * Starts the given number of worker threads. A pool of size 0 or 1
+ * runs all work on the calling thread.
+ */
+ThreadPool::ThreadPool(uint32_t num_threads) :
+m_workers{},
+m_tasks{},
+m_mutex{},
+m_task_available{},
+m_tasks_done{},
+m_pending{ 0 },
+m_stop{ false }
+{
+    if (num_threads <= 1)
+    {
+        return;
+    }
+
+    for (uint32_t i = 0; i < num_threads; ++i)
+    {
+        m_workers.emplace_back(&ThreadPool::work, this);
+    }
+}
+
+ThreadPool::~ThreadPool()
+{
+    {
+        std::lock_guard<std::mutex> lock{ m_mutex };
+        m_stop = true;
+    }
+    m_task_available.notify_all();
+
+    for (std::thread & worker : m_workers)
+    {
+        worker.join();
+    }
+}
+
+/**
+ * Returns the number of worker threads.
+ */
+uint32_t ThreadPool::size() const
+{
+    return std::max<uint32_t>(m_workers.size(), 1);
+}
+
+/**
+ * Submits a task to be run by one of the workers.
+ */
+void ThreadPool::submit(std::function<void()> task)
+{
+    if (m_workers.empty())
+    {
+        task();
+        return;
+    }
+
+    {
+        std::lock_guard<std::mutex> lock{ m_mutex };
+        m_tasks.push(std::move(task));
+        ++m_pending;
+    }
+    m_task_available.notify_one();
+}
+
+/**
+ * Waits until all submitted tasks have finished.
+ */
+void ThreadPool::wait()
+{
+    std::unique_lock<std::mutex> lock{ m_mutex };
+    m_tasks_done.wait(lock, [this] { return m_pending == 0; });
+}
+
+/**
+ * Calls fn(begin, end) on disjoint chunks covering [0, n) across the
+ * workers and waits for all chunks to finish. A few chunks per worker
+ * even out chunks that take longer than others.
+ */
+void ThreadPool::parallel_for(size_t n, std::function<void(size_t, size_t)> const & fn, size_t grain)
+{
+    if (m_workers.empty() || n <= grain)
+    {
+        if (n > 0)
+        {
+            fn(0, n);
+        }
+        return;
+    }
+
+    size_t num_chunks = std::min<size_t>(m_workers.size() * 4, (n + grain - 1) / grain);
+    size_t chunk_size = (n + num_chunks - 1) / num_chunks;
+    for (size_t begin = 0; begin < n; begin += chunk_size)
+    {
+        size_t end = std::min(n, begin + chunk_size);
+        submit([&fn, begin, end] { fn(begin, end); });
+    }
+    wait();
+}
+
+/**
+ * Main loop of a worker thread.
+ */
+void ThreadPool::work()
+{
+    while (true)
+    {
+        std::function<void()> task;
+        {
+            std::unique_lock<std::mutex> lock{ m_mutex };
+            m_task_available.wait(lock, [this] { return m_stop || !m_tasks.empty(); });
+            if (m_stop && m_tasks.empty())
+            {
+                return;
+            }
+            task = std::move(m_tasks.front());
+            m_tasks.pop();
+        }
+
+        task();
+
+        {
+            std::lock_guard<std::mutex> lock{ m_mutex };
+            --m_pending;
+        }
+        m_tasks_done.notify_all();
+    }
+}
+
+}
@@ -0,0 +1,163 @@
+#include "ekstazi/vtable/virtual-targets.hh"
+
+#include "ekstazi/llvm/string-ref.hh"
+
+#include <unordered_set>
+
+using namespace llvm;
+
+namespace ekstazi
+{
+
+VirtualTargetCache::VirtualTargetCache() :
+m_vtables{ nullptr },
+m_type_hierarchy{ nullptr },
+m_closures{},
+m_class_closures{},
+m_type_closures{},
+m_unresolved_type_ids{},
+m_targets{},
+m_no_targets{}
+{
+
+}
+
+/**
+ * Collects, for every type identifier, the address points compatible
+ * with it. The closures of the classes are only collected when they are first
+ * called through, since each takes a traversal of the type hierarchy.
+ */
+VirtualTargetCache::VirtualTargetCache(VTableMap const & vtables, TypeHierarchy & type_hierarchy) :
+VirtualTargetCache()
+{
+    m_vtables = &vtables;
+    m_type_hierarchy = &type_hierarchy;
+
+    for (auto const & p : vtables)
+    {
+        for (std::pair<std::string, uint32_t> const & type_id : p.second->get_type_ids())
+        {
+            auto it = m_type_closures.emplace(type_id.first, m_closures.size());
+            if (it.second)
+            {
+                m_closures.emplace_back();
+            }
+            m_closures[it.first->second].push_back(&p.second->get_address_point_vfuns(type_id.second));
+        }
+        for (std::string const & type_id : p.second->get_unresolved_type_ids())
+        {
+            m_unresolved_type_ids.insert(type_id);
+        }
+    }
+}
+
+/**
+ * Returns the functions a virtual call through the given slot of the
+ * class' vtable may dispatch to.
+ */
+std::vector<Function*> const & VirtualTargetCache::get_targets(symbol_id class_id, uint64_t index)
+{
+    if (m_vtables == nullptr)
+    {
+        return m_no_targets;
+    }
+
+    auto it = m_vtables->find(class_id);
+    if (it == m_vtables->end() || index >= it->second->get_vfuns().size())
+    {
+        return m_no_targets;
+    }
+    return get_closure_targets(get_class_closure(class_id, it->second.get()), index);
+}
+
+/**
+ * Returns the closure of a class' own vtable followed by the vtables of
+ * all classes derived from it, collecting it on first use.
+ */
+uint32_t VirtualTargetCache::get_class_closure(symbol_id class_id, VTable const * vtable)
+{
+    auto it = m_class_closures.find(class_id);
+    if (it != m_class_closures.end())
+    {
+        return it->second;
+    }
+
+    uint32_t closure_index = m_closures.size();
+    m_class_closures[class_id] = closure_index;
+    m_closures.emplace_back();
+    std::vector<std::vector<Function*> const *> & closure = m_closures.back();
+    closure.push_back(&vtable->get_vfuns());
+
+    for (symbol_id derived_type : m_type_hierarchy->get_derived_types(class_id))
+    {
+        auto derived = m_vtables->find(derived_type);
+        if (derived != m_vtables->end() && derived_type != class_id)
+        {
+            closure.push_back(&derived->second->get_vfuns());
+        }
+    }
+    return closure_index;
+}
+
+/**
+ * Returns whether any vtable is compatible with the type identifier,
+ * and the address points of all compatible vtables are known.
+ */
+bool VirtualTargetCache::has_type_id(std::string const & type_id) const
+{
+    return m_type_closures.find(type_id) != m_type_closures.end() &&
+           m_unresolved_type_ids.find(type_id) == m_unresolved_type_ids.end();
+}
+
+/**
+ * Returns the functions a virtual call through the given slot of a
+ * vtable compatible with the type identifier may dispatch to.
+ */
+std::vector<Function*> const & VirtualTargetCache::get_targets(std::string const & type_id, uint64_t index)
+{
+    if (!has_type_id(type_id))
+    {
+        return m_no_targets;
+    }
+    auto it = m_type_closures.find(type_id);
+    return get_closure_targets(it->second, index);
+}
+
+/**
+ * Returns the targets of a call through the given slot of the entries
+ * of a closure, resolving them on first use. Entries that are too short
+ * for the slot, or hold no function at it, are skipped.
+ */
+std::vector<Function*> const & VirtualTargetCache::get_closure_targets(uint32_t closure, uint64_t index)
+{
+    uint64_t key = uint64_t{ closure } << 32 | index;
+    auto it = m_targets.find(key);
+    if (it != m_targets.end())
+    {
+        return it->second;
+    }
+
+    std::vector<Function*> & targets = m_targets[key];
+    std::unordered_set<Function*> seen;
+    for (std::vector<Function*> const * vfuns : m_closures[closure])
+    {
+        if (index >= vfuns->size() || (*vfuns)[index] == nullptr)
+        {
+            continue;
+        }
+
+        // Ignore pure virtual functions
+        Function* target = (*vfuns)[index];
+        if (to_string_view(target->getName()).find("__cxa_pure_virtual") != std::string_view::npos)
+        {
+            continue;
+        }
+        if (seen.insert(target).second)
+        {
+            targets.push_back(target);
+        }
+    }
+    return targets;
+}
+
+}
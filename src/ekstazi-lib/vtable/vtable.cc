@@ -4,8 +4,11 @@
 
 #include "llvm/IR/Constant.h"
 #include "llvm/IR/Constants.h"
+#include "llvm/IR/DataLayout.h"
 #include "llvm/IR/Instructions.h"
 #include "llvm/IR/Metadata.h"
+#include "llvm/IR/Module.h"
+#include "llvm/IR/LLVMContext.h"
 #include "llvm/Support/raw_ostream.h"
 
 using namespace llvm;
@@ -92,7 +95,8 @@ void VTable::add_entries(GlobalVariable* vt)
         return;
     }
     // Get name of virtual table type. We need to strip the prefix after demangling.
-    m_name = demangle(vt->getName());
+    StringRef vt_name = vt->getName();
+    m_name = std::string{ demangle(std::string_view{ vt_name.data(), vt_name.size() }) };
     m_name = strip_prefix_from_vtable_name(m_name);
     // errs() << "Name of vtable type: " << m_name << '\n';
 
@@ -129,6 +133,29 @@ void VTable::add_entries(GlobalVariable* vt)
     
     // errs() << "Num vtable entries: " << i << '\n';
 
+    // Type identifiers at every address point of the vtable group. Their
+    // offsets are byte offsets into the whole group, which holds the
+    // primary vtable and those of the non-primary and virtual bases.
+    SmallVector<MDNode*, 8> mds;
+    vt->getMetadata(LLVMContext::MD_type, mds);
+    for (MDNode* md : mds)
+    {
+        ConstantAsMetadata* md_offset = dyn_cast<ConstantAsMetadata>(md->getOperand(0));
+        MDString* md_type_id = dyn_cast<MDString>(md->getOperand(1));
+        if (md_offset == nullptr || md_type_id == nullptr)
+        {
+            continue;
+        }
+        ConstantInt* offset = dyn_cast<ConstantInt>(md_offset->getValue());
+        uint32_t address_point = offset != nullptr ? find_address_point(vt, offset->getZExtValue()) : UINT32_MAX;
+        if (address_point == UINT32_MAX)
+        {
+            m_unresolved_type_ids.push_back(md_type_id->getString().str());
+            continue;
+        }
+        m_type_ids.emplace_back(md_type_id->getString().str(), address_point);
+    }
+
     // for (std::string & fun : m_vfuns)
     // {
     //     errs() << fun << '\n';
@@ -145,5 +172,74 @@ std::vector<Function*> const & VTable::get_vfuns() const
     return m_vfuns;
 }
 
+std::vector<std::pair<std::string, uint32_t>> const & VTable::get_type_ids() const
+{
+    return m_type_ids;
+}
+
+std::vector<std::string> const & VTable::get_unresolved_type_ids() const
+{
+    return m_unresolved_type_ids;
+}
+
+std::vector<Function*> const & VTable::get_address_point_vfuns(uint32_t address_point) const
+{
+    return m_address_points[address_point];
+}
+
+/**
+ * Returns the index of the address point at the given byte offset into
+ * the vtable group, adding it on first use. The address point is in the
+ * vtable whose entries span the offset, and its slots run from there to
+ * the end of that vtable. An address point right after the last entry
+ * belongs to a vtable without virtual functions.
+ */
+uint32_t VTable::find_address_point(GlobalVariable* vt, uint64_t offset)
+{
+    for (uint32_t i = 0; i < m_address_point_offsets.size(); ++i)
+    {
+        if (m_address_point_offsets[i] == offset)
+        {
+            return i;
+        }
+    }
+
+    DataLayout const & data_layout = vt->getParent()->getDataLayout();
+    Constant* group = vt->getInitializer();
+    StructType* group_type = dyn_cast<StructType>(group->getType());
+    if (group_type == nullptr)
+    {
+        return UINT32_MAX;
+    }
+
+    StructLayout const * group_layout = data_layout.getStructLayout(group_type);
+    for (uint32_t i = 0; i < group_type->getNumElements(); ++i)
+    {
+        ConstantArray* vtable_arr = dyn_cast<ConstantArray>(group->getAggregateElement(i));
+        if (vtable_arr == nullptr)
+        {
+            continue;
+        }
+
+        uint64_t begin = group_layout->getElementOffset(i);
+        uint64_t entry_size = data_layout.getTypeAllocSize(vtable_arr->getType()->getElementType());
+        uint64_t num_entries = vtable_arr->getNumOperands();
+        if (offset < begin || offset > begin + num_entries * entry_size || (offset - begin) % entry_size != 0)
+        {
+            continue;
+        }
+
+        std::vector<Function*> vfuns;
+        for (uint64_t entry = (offset - begin) / entry_size; entry < num_entries; ++entry)
+        {
+            vfuns.push_back(dyn_cast<Function>(vtable_arr->getOperand(entry)->stripPointerCasts()));
+        }
+        m_address_points.push_back(std::move(vfuns));
+        m_address_point_offsets.push_back(offset);
+        return m_address_points.size() - 1;
+    }
+    return UINT32_MAX;
+}
+
 
 }
@@ -5,6 +5,7 @@
 #include "llvm/IR/BasicBlock.h"
 #include "llvm/IR/InstIterator.h"
 #include "llvm/IR/Instructions.h"
+#include "llvm/IR/IntrinsicInst.h"
 #include "llvm/IR/ValueSymbolTable.h"
 
 #include "llvm/Analysis/CallGraphSCCPass.h"
@@ -30,22 +31,30 @@
 #include <chrono>
 #include <memory>
 
-// Hash checksum implementation
-#include "sha512.h"
-
 #include "ekstazi/constants.hh"
 
 #include "ekstazi/depgraph/depgraph.hh"
+#include "ekstazi/depgraph/depgraph-log.hh"
+#include "ekstazi/depgraph/depgraph-union.hh"
 #include "ekstazi/depgraph/function.hh"
+#include "ekstazi/depgraph/test-index.hh"
+#include "ekstazi/depgraph/test-digests.hh"
+#include "ekstazi/depgraph/dispatch-summary.hh"
+#include "ekstazi/depgraph/virtual-call-pruner.hh"
 
 #include "ekstazi/type-hierarchy/type-hierarchy.hh"
 
 #include "ekstazi/test-frameworks/gtest/gtest-adapter.hh"
 
 #include "ekstazi/llvm/function-comparator.hh"
+#include "ekstazi/llvm/string-ref.hh"
 
 #include "ekstazi/vtable/vtable.hh"
+#include "ekstazi/vtable/virtual-targets.hh"
 #include "ekstazi/utils/mangle.hh"
+#include "ekstazi/utils/symbol-table.hh"
+#include "ekstazi/utils/symbol-rules.hh"
+#include "ekstazi/utils/thread-pool.hh"
 
 using namespace llvm;
 
@@ -55,6 +64,17 @@ namespace
 // Test executable name
 static cl::opt<std::string> test_exec_fname{ "test-executable", cl::desc("Specify test executable"), cl::value_desc("test filename") };
 static cl::opt<bool> opt_constructors{ "constructors", cl::desc("Enable constructor optimization"), cl::init(true) };
+static cl::opt<bool> opt_per_test_rta{ "per-test-rta", cl::desc("With the constructor optimization, make virtual calls depend only on the tests that construct the class"), cl::init(false) };
+static cl::opt<bool> opt_binary_depgraph{ "binary-depgraph", cl::desc("Save the dependency graph as a binary image instead of text"), cl::init(false) };
+static cl::opt<bool> opt_depgraph_log{ "depgraph-log", cl::desc("Append only the changes to the dependency graph to a log instead of saving the whole graph"), cl::init(false) };
+static cl::opt<unsigned> opt_depgraph_log_generations{ "depgraph-log-generations", cl::desc("Number of generations after which the dependency graph log is compacted"), cl::init(16) };
+static cl::opt<unsigned> opt_traversal_threads{ "traversal-threads", cl::desc("Number of threads used to traverse very large dependency graphs"), cl::init(1) };
+static cl::opt<bool> opt_type_metadata{ "type-metadata", cl::desc("Narrow virtual call targets with the type tests emitted for -fwhole-program-vtables"), cl::init(false) };
+static cl::opt<bool> opt_incremental_extraction{ "incremental-extraction", cl::desc("Reuse the dependencies of functions whose checksum and callees did not change since the last run"), cl::init(false) };
+static cl::opt<unsigned> opt_hash_threads{ "hash-threads", cl::desc("Number of threads used to hash all functions of the module before the call graph is walked"), cl::init(1) };
+static cl::opt<bool> opt_test_index{ "test-index", cl::desc("Select tests by looking up the function-to-test index instead of traversing the dependency graphs"), cl::init(false) };
+static cl::opt<bool> opt_test_digests{ "test-digests", cl::desc("Select tests by comparing their transitive digests with the last run instead of traversing the dependency graphs"), cl::init(false) };
+static cl::opt<bool> opt_block_changes{ "block-changes", cl::desc("Only propagate changes behind a case of a switch on an argument to the callers that may select that case"), cl::init(false) };
 
 class Ekstazi : public CallGraphSCCPass
 {
@@ -62,6 +82,11 @@ protected:
     // Ekstazi Gtest Adapter
     ekstazi::gtest::GtestAdapter gtest_adapter;
 
+    // User rules for functions to leave out of the dependency graph, and their digest,
+    // which is part of every callee signature
+    ekstazi::SymbolRules symbol_rules;
+    std::string symbol_rules_digest;
+
     // Path to the bitcode
     std::string bc_fname;
 
@@ -84,35 +109,79 @@ protected:
     std::string new_depgraph_fname;
     ekstazi::DependencyGraph new_depgraph;
 
+    ekstazi::DepgraphLog depgraph_log;
+
+    // Threads for traversing very large dependency graphs, if enabled
+    std::unique_ptr<ekstazi::ThreadPool> thread_pool;
+
+    // Function-to-test indexes of the dependency graphs
+    std::string old_test_index_fname;
+    ekstazi::TestIndex old_test_index;
+
+    std::string new_test_index_fname;
+    ekstazi::TestIndex new_test_index;
+
+    // Transitive digests of the tests
+    std::string old_test_digests_fname;
+    ekstazi::TestDigests old_test_digests;
+
+    std::string new_test_digests_fname;
+    ekstazi::TestDigests new_test_digests;
+
+    // Block-level digests of the functions that switch on an argument
+    std::string old_dispatchers_fname;
+    ekstazi::DispatchSummaryMap old_dispatchers;
+
+    std::string new_dispatchers_fname;
+    ekstazi::DispatchSummaryMap new_dispatchers;
+    std::unordered_map<ekstazi::symbol_id, Function*> dispatcher_functions;
+
     // Set of Functions
     std::string old_functions_fname;
-    std::map<std::string, ekstazi::Function> old_functions;
+    ekstazi::FunctionMap old_functions;
 
     std::string new_functions_fname;
-    std::map<std::string, ekstazi::Function> new_functions;
+    ekstazi::FunctionMap new_functions;
+
+    // Number of functions whose dependencies were reused from the old graph
+    uint32_t num_reused_functions = 0;
+
+    // Hashes of all functions computed ahead of the call graph walk, if enabled
+    std::unordered_map<Function*, uint32_t> function_hash_indices;
+    std::vector<ekstazi::FunctionComparator::FunctionHash> function_hashes;
+
+    // Digests of global variable initializers, shared by all function hashes
+    ekstazi::FunctionComparator::GlobalDigestCache<> global_digests;
 
     // Set of Constructors
     std::string old_constructors_fname;
-    std::unordered_set<std::string> old_constructors;
+    std::unordered_set<ekstazi::symbol_id> old_constructors;
 
     std::string new_constructors_fname;
-    std::unordered_set<std::string> new_constructors;
+    std::unordered_set<ekstazi::symbol_id> new_constructors;
 
     // Set of Modified Functions
     std::string modified_functions_fname;
-    std::unordered_set<std::string> modified_functions;
+    std::unordered_set<ekstazi::symbol_id> modified_functions;
+
+    // Tests selected without finding all modified functions, e.g. through the test index
+    std::string selected_tests_fname;
+    std::unordered_set<ekstazi::symbol_id> selected_tests;
 
     // Tests should be the leaf nodes of our graph
     std::string modified_tests_fname;
     std::unordered_set<std::string> modified_tests;
 
     // Virtual Tables for all classes
-    // {key, val} = {Class Name, VTable for Class}
-    std::unordered_map<std::string, std::shared_ptr<ekstazi::VTable>> vtables;
+    // {key, val} = {Class Name id, VTable for Class}
+    std::unordered_map<ekstazi::symbol_id, std::shared_ptr<ekstazi::VTable>> vtables;
+
+    // Targets of virtual calls, by class and vtable slot
+    ekstazi::VirtualTargetCache virtual_targets;
 
     // Virtual Function calls
     // { caller: {callee1}, {callee2}, etc... }
-    std::unordered_map<std::string, std::unordered_set<std::string>> virtual_call_map;
+    std::unordered_map<ekstazi::symbol_id, std::unordered_set<ekstazi::symbol_id>> virtual_call_map;
     std::vector<std::pair<Function*, Function*>> virtual_calls;
 
     // Profiling tools
@@ -195,6 +264,14 @@ public:
         // Initial indicator file filename
         count_fname = ekstazi::EKSTAZI_DIRNAME + '/' + ekstazi::COUNT_FNAME;
 
+        // User exclusion rules, shared by all modules
+        uint32_t num_symbol_rules = symbol_rules.load_file(ekstazi::EKSTAZI_DIRNAME + '/' + ekstazi::SYMBOL_RULES_FNAME);
+        if (num_symbol_rules > 0)
+        {
+            errs() << "Loaded " << num_symbol_rules << " symbol rules" << '\n';
+        }
+        symbol_rules_digest = symbol_rules.digest().to_string();
+
         new_type_hierarchy_fname = ekstazi::EKSTAZI_DIRNAME + '/' + module_name + '.' + ekstazi::TYPE_HIERARCHY_FNAME;
         old_type_hierarchy_fname = new_type_hierarchy_fname + '.' + ekstazi::OLD_SUFFIX;
 
@@ -210,29 +287,68 @@ public:
         }
         ifs.close();
 
-        new_depgraph_fname = ekstazi::EKSTAZI_DIRNAME + '/' + module_name + '.' + ekstazi::DEPGRAPH_FNAME;
+        std::string const & depgraph_basename = opt_binary_depgraph ? ekstazi::DEPGRAPH_IMAGE_FNAME : ekstazi::DEPGRAPH_FNAME;
+        new_depgraph_fname = ekstazi::EKSTAZI_DIRNAME + '/' + module_name + '.' + depgraph_basename;
         new_depgraph = ekstazi::DependencyGraph{};
 
         old_depgraph_fname = new_depgraph_fname + '.' + ekstazi::OLD_SUFFIX;
         old_depgraph = ekstazi::DependencyGraph{};
 
+        if (opt_traversal_threads > 1)
+        {
+            thread_pool.reset(new ekstazi::ThreadPool{ opt_traversal_threads });
+            new_depgraph.set_thread_pool(thread_pool.get());
+            old_depgraph.set_thread_pool(thread_pool.get());
+        }
+
         // Check for existing dependency graph
         ifs = std::ifstream{ new_depgraph_fname };
-        if (ifs)
+        if (opt_depgraph_log)
+        {
+            // The snapshot stays in place, and the old graph is rebuilt
+            // from it and the changes logged since
+            depgraph_log = ekstazi::DepgraphLog{ new_depgraph_fname, ekstazi::EKSTAZI_DIRNAME + '/' + module_name + '.' + ekstazi::DEPGRAPH_LOG_FNAME };
+            depgraph_log.load(old_depgraph);
+            old_depgraph.condense();
+        }
+        else if (ifs)
         {
             errs() << "Renaming dependency file to: " << old_depgraph_fname << '\n';
             std::rename(new_depgraph_fname.c_str(), old_depgraph_fname.c_str());
 
-            // Load the old dependency graph
+            // Load the old dependency graph. It is never modified, so we
+            // condense it right away for traversals.
             old_depgraph.load_file(old_depgraph_fname);
+            old_depgraph.condense();
+        }
+        ifs.close();
+
+        new_test_index_fname = ekstazi::EKSTAZI_DIRNAME + '/' + module_name + '.' + ekstazi::TEST_INDEX_FNAME;
+        old_test_index_fname = new_test_index_fname + '.' + ekstazi::OLD_SUFFIX;
+
+        // Check for existing test index
+        ifs = std::ifstream{ new_test_index_fname };
+        if (ifs)
+        {
+            errs() << "Renaming test index file to: " << old_test_index_fname << '\n';
+            std::rename(new_test_index_fname.c_str(), old_test_index_fname.c_str());
+
+            // Load the old test index
+            old_test_index.load_file(old_test_index_fname);
         }
         ifs.close();
 
+        // The index may be missing if the previous run predates it
+        if (opt_test_index && old_test_index.empty() && !old_depgraph.empty())
+        {
+            old_test_index.build(old_depgraph.get_condensed_graph(), ekstazi::gtest::GtestAdapter::is_test_from_bc);
+        }
+
         new_functions_fname = ekstazi::EKSTAZI_DIRNAME + '/' + module_name + '.' + ekstazi::FUNCTIONS_FNAME;
-        new_functions = std::map<std::string, ekstazi::Function>{};
+        new_functions = ekstazi::FunctionMap{};
 
         old_functions_fname = new_functions_fname + '.' + ekstazi::OLD_SUFFIX;
-        old_functions = std::map<std::string, ekstazi::Function>{};
+        old_functions = ekstazi::FunctionMap{};
 
         // Check for existing function checksums file
         ifs = std::ifstream{ new_functions_fname };
@@ -246,8 +362,47 @@ public:
         }
         ifs.close();
 
+        new_test_digests_fname = ekstazi::EKSTAZI_DIRNAME + '/' + module_name + '.' + ekstazi::TEST_DIGESTS_FNAME;
+        old_test_digests_fname = new_test_digests_fname + '.' + ekstazi::OLD_SUFFIX;
+
+        // Check for existing test digests
+        ifs = std::ifstream{ new_test_digests_fname };
+        if (ifs)
+        {
+            errs() << "Renaming test digests file to: " << old_test_digests_fname << '\n';
+            std::rename(new_test_digests_fname.c_str(), old_test_digests_fname.c_str());
+
+            // Load the old test digests
+            old_test_digests.load_file(old_test_digests_fname);
+        }
+        ifs.close();
+
+        // The digests may be missing if the previous run predates them
+        if (opt_test_digests && old_test_digests.empty() && !old_depgraph.empty())
+        {
+            old_test_digests.build(old_depgraph.get_condensed_graph(), old_functions, ekstazi::gtest::GtestAdapter::is_test_from_bc);
+        }
+
+        new_dispatchers_fname = ekstazi::EKSTAZI_DIRNAME + '/' + module_name + '.' + ekstazi::DISPATCHERS_FNAME;
+        old_dispatchers_fname = new_dispatchers_fname + '.' + ekstazi::OLD_SUFFIX;
+
+        // Check for existing dispatch summaries
+        ifs = std::ifstream{ new_dispatchers_fname };
+        if (ifs)
+        {
+            errs() << "Renaming dispatch summaries file to: " << old_dispatchers_fname << '\n';
+            std::rename(new_dispatchers_fname.c_str(), old_dispatchers_fname.c_str());
+
+            // Load the old dispatch summaries
+            old_dispatchers = ekstazi::DispatchSummary::load_file(old_dispatchers_fname);
+        }
+        ifs.close();
+
         modified_functions_fname = ekstazi::EKSTAZI_DIRNAME + "/" + module_name + "." + ekstazi::MODIFIED_FUNS_FNAME;
-        modified_functions = std::unordered_set<std::string>{};
+        modified_functions = std::unordered_set<ekstazi::symbol_id>{};
+
+        selected_tests_fname = ekstazi::EKSTAZI_DIRNAME + "/" + module_name + "." + ekstazi::SELECTED_TESTS_FNAME;
+        selected_tests = std::unordered_set<ekstazi::symbol_id>{};
 
         modified_tests_fname = ekstazi::EKSTAZI_DIRNAME + "/" + module_name + "." + ekstazi::TESTS_FNAME;
         modified_tests = std::unordered_set<std::string>{};
@@ -255,6 +410,12 @@ public:
         build_class_hierarchy(CG.getModule());
 
         build_vtables(CG.getModule());
+        virtual_targets = ekstazi::VirtualTargetCache{ vtables, new_type_hierarchy };
+
+        if (opt_hash_threads > 1)
+        {
+            hash_functions(CG.getModule());
+        }
 
         timer_initialization.stop();
         // errs() << "Time for initialization: " << timer.get_recent_elapsed_time() << " ms\n";
@@ -279,6 +440,15 @@ public:
             // Append to the set of functions
             add_to_function_set(caller);
 
+            // Unchanged functions keep their direct dependencies from the old graph.
+            // Indirect calls are still resolved, since the class hierarchy may have changed.
+            uint64_t callee_hash = compute_callee_hash(cgn);
+            bool reused = opt_incremental_extraction && reuse_call_dependencies(caller, callee_hash);
+            if (reused)
+            {
+                ++num_reused_functions;
+            }
+
             // errs() << "Caller: " << caller_name << '\n';
 
             for (CallGraphNode::CallRecord const & cr : *cgn)
@@ -305,6 +475,37 @@ public:
                     {
                         call_value = ii->getCalledValue();
                     }
+                    // With type metadata, the call may load its target with llvm.type.checked.load
+                    if (opt_type_metadata)
+                    {
+                        if (ExtractValueInst* evi = dyn_cast<ExtractValueInst>(call_value->stripPointerCasts()))
+                        {
+                            IntrinsicInst* checked_load = dyn_cast<IntrinsicInst>(evi->getAggregateOperand());
+                            if (checked_load && checked_load->getIntrinsicID() == Intrinsic::type_checked_load)
+                            {
+                                ConstantInt* offset = dyn_cast<ConstantInt>(checked_load->getArgOperand(1));
+                                if (!offset)
+                                {
+                                    continue;
+                                }
+                                uint64_t index = offset->getZExtValue() / caller->getParent()->getDataLayout().getPointerSize();
+
+                                // Types with internal linkage and unresolved type identifiers
+                                // are resolved through the type hierarchy instead
+                                std::string type_id = get_type_id(checked_load->getArgOperand(2));
+                                if (virtual_targets.has_type_id(type_id))
+                                {
+                                    add_virtual_call(caller, virtual_targets.get_targets(type_id, index));
+                                }
+                                else
+                                {
+                                    FunctionType* call_type = dyn_cast<FunctionType>(call_value->getType()->getPointerElementType());
+                                    add_virtual_call(caller, virtual_targets.get_targets(get_this_class_id(call_type), index));
+                                }
+                                continue;
+                            }
+                        }
+                    }
                     // If this is a virtual call, the preceding instruction has to be a load
                     if (LoadInst* li = dyn_cast<LoadInst>(call_value))
                     {
@@ -324,151 +525,38 @@ public:
                             // errs() << *(dyn_cast<PointerType>(type)->getElementType()) << '\n';
 
                             FunctionType* call_type = dyn_cast<FunctionType>(dyn_cast<PointerType>(type)->getElementType());
-                            if (!call_type)
+                            ekstazi::symbol_id class_id = get_this_class_id(call_type);
+                            if (class_id == ekstazi::SymbolTable::invalid_id)
                             {
                                 continue;
                             }
 
-                            PointerType* vtable_type = dyn_cast<PointerType>(call_type->getParamType(0));
-                            if (!vtable_type)
-                            {
-                                continue;
-                            }
-                            // errs() << *(vtable_type->getPointerElementType()) << '\n';
-                            StructType* class_type = dyn_cast<StructType>(vtable_type->getPointerElementType());
-                            if (!class_type)
+                            // The type tested on the vtable is at least as precise as the class
+                            std::string type_id;
+                            if (opt_type_metadata)
                             {
-                                continue;
+                                type_id = find_type_test(gepi->getPointerOperand());
+                                if (!virtual_targets.has_type_id(type_id))
+                                {
+                                    type_id.clear();
+                                }
                             }
 
-                            // strip 'class.' from name
-                            std::string class_name = class_type->getStructName();
-                            // errs() << "VTable class: " << class_name << '\n';
-                            class_name.erase(0, std::string{"class."}.size());
-                            std::unordered_set<std::string> related_classes = new_type_hierarchy.get_derived_types(class_name);
-                            // errs() << "Related classes: " << related_classes.size() << '\n';
-                            // for (auto & c : related_classes)
-                            // {
-                            //     errs() << c << '\n';
-                            // }
-                            
-                            // errs() << class_name << '\n';
-
                             // Get the index of the vtable offset
                             for (Use & idx : gepi->indices())
                             {
                                 if (ConstantInt* const_idx = dyn_cast<ConstantInt>(idx))
                                 {
                                     // errs() << "VTable offset: " << const_idx->getZExtValue() << ',';
-                                    uint64_t index = const_idx->getZExtValue();
-                                    auto it = vtables.find(class_name);
-                                    if (it == vtables.end())
-                                    {
-                                        // errs() << "Not found: " << class_name << '\n';
-                                        continue;
-                                    }
-                                    std::shared_ptr<ekstazi::VTable> vtable = it->second;
-                                    // errs() << "Called class: " << vtable->get_name() << '\n';
-                                    std::vector<Function*> const & vfuns = vtable->get_vfuns();
-                                    if (index > vfuns.size() - 1)
-                                    {
-                                        // errs() << "VTable offset " << index << " is larger than vtable size: " << vfuns.size() << '\n';
-                                        continue;
-                                    }
-                                    // errs() << "Called vfunc: " << vfuns[index] << '\n';
-                                    Function* callee = vfuns[index];
-                                    // errs() << "Called vfunc: " << callee->getName() << '\n';
-                                    std::string callee_name = callee->getName();
-                                    // Ignore pure virtual functions
-                                    if (callee_name.find("__cxa_pure_virtual") == std::string::npos)
+                                    // Add dependencies to the called vfunc and to the vfuncs
+                                    // overriding it in all derived classes
+                                    if (!type_id.empty())
                                     {
-                                        add_to_function_set(callee);
-                                        // add_call_dependency(caller, callee);
-                                        if (should_add_function(caller) && should_add_function(callee))
-                                        {
-                                            std::pair<std::unordered_set<std::string>::iterator, bool> it = virtual_call_map[caller->getName()].insert(callee->getName());
-                                            if (it.second)
-                                            {
-                                                virtual_calls.push_back({ caller, callee });
-                                            }
-                                            // std::unordered_map<std::string, std::unordered_set<std::string>>::iterator it = virtual_call_map.find(caller->getName());
-                                            // if (it == virtual_call_map.end())
-                                            // {
-                                            //     virtual_call_map[caller->getName()].insert(callee->getName());
-                                            //     virtual_calls.push_back({ caller, callee });
-                                            // }
-
-                                            // else
-                                            // {
-                                            //     std::unordered_set<std::string>::iterator it_callee = it->second.find(callee->getName());
-                                            //     if (it_callee == it->second.end())
-                                            //     {
-                                            //         it->second.insert(callee->getName());
-                                            //         virtual_calls.push_back({ caller, callee });
-                                            //     }
-                                            // }
-                                            
-                                            // virtual_calls.push_back({ caller, callee });
-                                        }
+                                        add_virtual_call(caller, virtual_targets.get_targets(type_id, const_idx->getZExtValue()));
                                     }
-                                    // Add dependency to called vfunc
-                                    
-                                    // errs() << "Dependent vfuncs: " << '\n';
-                                    for (std::string const & c : related_classes)
+                                    else
                                     {
-                                        // std::string related_class_name = c.substr(std::string{"class."}.size());
-                                        std::string related_class_name = c;
-                                        auto it = vtables.find(related_class_name);
-                                        if (it == vtables.end())
-                                        {
-                                            // errs() << "Not found: " << related_class_name << '\n';
-                                            continue;
-                                        }
-                                        std::shared_ptr<ekstazi::VTable> vtable = it->second;
-                                        // errs() << "Called class: " << vtable->get_name() << '\n';
-                                        std::vector<Function*> const & derived_vfuns = vtable->get_vfuns();
-                                        if (index > derived_vfuns.size() - 1)
-                                        {
-                                            // errs() << "VTable offset " << index << " is larger than vtable size: " << vfuns.size() << '\n';
-                                            continue;
-                                        }
-                                        // errs() << "Related vfunc: " << derived_vfuns[index]->getName() << '\n';
-                                        Function* related_callee = derived_vfuns[index];
-                                        std::string callee_name = related_callee->getName();
-                                        // Ignore pure virtual functions
-                                        if (callee_name.find("__cxa_pure_virtual") == std::string::npos)
-                                        {
-                                            add_to_function_set(related_callee);
-                                            // add_call_dependency(caller, related_callee);
-                                            if (should_add_function(caller) && should_add_function(related_callee))
-                                            {
-                                                std::pair<std::unordered_set<std::string>::iterator, bool> it = virtual_call_map[caller->getName()].insert(related_callee->getName());
-                                                if (it.second)
-                                                {
-                                                    virtual_calls.push_back({ caller, related_callee });
-                                                }
-                                                // std::unordered_map<std::string, std::unordered_set<std::string>>::iterator it = virtual_call_map.find(caller->getName());
-                                                // if (it == virtual_call_map.end())
-                                                // {
-                                                //     virtual_call_map[caller->getName()].insert(related_callee->getName());
-                                                //     virtual_calls.push_back({ caller, related_callee });
-                                                // }
-
-                                                // else
-                                                // {
-                                                //     std::unordered_set<std::string>::iterator it_callee = it->second.find(related_callee->getName().str());
-                                                //     if (it_callee == it->second.end())
-                                                //     {
-                                                //         it->second.insert(related_callee->getName());
-                                                //         virtual_calls.push_back({ caller, related_callee });
-                                                //     }
-                                                // }
-                                                
-                                                
-                                            }
-                                            // virtual_calls.push_back({ caller, related_callee });
-                                            
-                                        }
+                                        add_virtual_call(caller, virtual_targets.get_targets(class_id, const_idx->getZExtValue()));
                                     }
                                 }
                             }
@@ -481,13 +569,15 @@ public:
 
                 // Append to the set of functions
                 // Make sure caller is not null and is in this module
-                if (callee->isDeclaration())
+                if (reused || callee->isDeclaration())
                 {
                     continue;
                 }
                 add_to_function_set(callee);
                 add_call_dependency(caller, callee);
             }
+
+            record_callee_signature(caller, callee_hash);
         }
 
         // Now we need to use the old call graph to see what files are different.
@@ -500,50 +590,33 @@ public:
         // errs() << "Time for all runOnSCC: " << timer.get_recent_elapsed_time() << " ms\n";
         timer_finalization.start();
 
-        // From global list of constructors, find the ones that are used by tests
-        std::unordered_set<std::string> constructed_classes;
-        // Map classes -> set of tests that construct the class
-        std::unordered_map<std::string, std::unordered_set<std::string>> class_test_map;
+        ekstazi::SymbolTable & symbols = ekstazi::SymbolTable::instance();
 
-        // Removee duplicates from direct calls.
-        new_depgraph.remove_duplicates();
+        if (opt_incremental_extraction)
+        {
+            errs() << "Reused the dependencies of " << num_reused_functions << " functions" << '\n';
+        }
 
         // Handle lazy-adding virtual calls here
         errs() << "Number of virtual calls: " << virtual_calls.size() << '\n';
 
         if (opt_constructors)
         {
-            // Find all constructors that have been called by tests.
-            for (auto & p : new_constructors)
+            // The new graph does not change until the virtual calls are added below
+            timer_depgraph.start();
+            new_depgraph.freeze();
+            ekstazi::VirtualCallPruner virtual_call_pruner{ old_depgraph.get_frozen_graph(), new_depgraph.get_frozen_graph() };
+            virtual_call_pruner.set_per_test(opt_per_test_rta);
+            timer_depgraph.stop();
+
+            for (ekstazi::symbol_id p : new_constructors)
             {
-                // errs() << "Constructor: " << p << '\n';
-                std::unordered_set<std::string> dependents;
-                timer_depgraph.start();
-                std::unordered_set<std::string> dependents_old = old_depgraph.get_all_dependents(p);
-                timer_depgraph.stop();
-                dependents.insert(dependents_old.begin(), dependents_old.end());
-                timer_depgraph.start();
-                std::unordered_set<std::string> dependents_new = new_depgraph.get_all_dependents(p);
-                timer_depgraph.stop();
-                dependents.insert(dependents_new.begin(), dependents_new.end());
-                // Search for tests
-                for (auto & fun : dependents)
-                {
-                    if (ekstazi::gtest::GtestAdapter::is_test_from_bc(fun))
-                    {
-                        std::pair<std::string, std::string> class_fun_pair = ekstazi::Function::split_class_name(p);
-                        constructed_classes.insert(class_fun_pair.first);
-                        class_test_map[class_fun_pair.first].insert(fun);
-                    }
-                }
+                // errs() << "Constructor: " << symbols.name(p) << '\n';
+                std::pair<std::string, std::string> class_fun_pair = ekstazi::Function::split_class_name(symbols.name(p), false);
+                virtual_call_pruner.add_constructor(symbols.intern(class_fun_pair.first), p);
             }
 
-            errs() << "Number of constructed classes: " << constructed_classes.size() << '\n';
-            // for (auto & p : constructed_classes)
-            // {
-            //     errs() << "Constructed class: " << p << '\n';
-            // }
-
+            std::vector<std::pair<Function*, Function*>> candidate_calls;
             for (auto & p : virtual_calls)
             {
                 Function* caller = p.first;
@@ -554,75 +627,46 @@ public:
                     continue;
                 }
                 // errs() << "Virtual call: " << caller->getName() << ", " << callee->getName() << '\n';
-                // Find class being invoked, and check if it was actually constructed in the code
-                std::pair<std::string, std::string> class_fun_pair = ekstazi::Function::split_class_name(callee->getName());
-                auto it = constructed_classes.find(class_fun_pair.first);
-                if (it == constructed_classes.end())
-                {
-                    // errs() << "Never constructed: " << class_fun_pair.first << '\n';
-                    continue;
-                }
 
                 // Check if this dependency already exists
-                if (new_depgraph.exists_dependency(ekstazi::demangle(callee->getName()), ekstazi::demangle(caller->getName())))
+                ekstazi::symbol_id caller_id = get_symbol(caller);
+                ekstazi::symbol_id callee_id = get_symbol(callee);
+                if (new_depgraph.exists_dependency(callee_id, caller_id))
                 {
                     // errs() << "Virtual call already exists: " << caller->getName() << ", " << callee->getName() << '\n';
                     continue;
                 }
 
-                // errs() << "Constructed: " << class_fun_pair.first << '\n';
-                // Now, only add the call dependency iff somewhere in the dependency graph,
-                // this corresponds to a test AND the test constructs the class of the callee.
-                std::string caller_name = ekstazi::demangle(caller->getName());
-                // errs() << "Virtual caller: " << caller_name << '\n';
-                std::unordered_set<std::string> dependents;
-                // The caller may be a test, so we insert the caller into the dependents set
-                dependents.insert(caller_name);
-                timer_depgraph.start();
-                std::unordered_set<std::string> dependents_old = old_depgraph.get_all_dependents(caller_name);
-                timer_depgraph.stop();
-                dependents.insert(dependents_old.begin(), dependents_old.end());
-                timer_depgraph.start();
-                std::unordered_set<std::string> dependents_new = new_depgraph.get_all_dependents(caller_name);
-                timer_depgraph.stop();
-                dependents.insert(dependents_new.begin(), dependents_new.end());
-                // Search for tests
-                for (auto & fun : dependents)
+                // Find class being invoked
+                std::pair<std::string, std::string> class_fun_pair = ekstazi::Function::split_class_name(callee->getName());
+                virtual_call_pruner.add_virtual_call(caller_id, callee_id, symbols.find(class_fun_pair.first));
+                candidate_calls.push_back(p);
+            }
+
+            // Only add the call dependency iff somewhere in the dependency graph,
+            // this corresponds to a test AND the test constructs the class of the callee.
+            timer_depgraph.start();
+            std::vector<uint32_t> kept_calls = virtual_call_pruner.prune(ekstazi::gtest::GtestAdapter::is_test_from_bc);
+            timer_depgraph.stop();
+            errs() << "Number of constructed classes: " << virtual_call_pruner.num_constructed_classes() << '\n';
+
+            for (uint32_t i : kept_calls)
+            {
+                // errs() << "Virtual call is used: " << candidate_calls[i].first->getName() << ", " << candidate_calls[i].second->getName() << '\n';
+                if (opt_per_test_rta)
                 {
-                    if (ekstazi::gtest::GtestAdapter::is_test_from_bc(fun))
+                    // The callee is only reachable from the tests that construct its class
+                    for (ekstazi::symbol_id test_id : virtual_call_pruner.get_live_tests(i))
                     {
-                        // See if the test actually contsructs the class
-                        auto it = class_test_map.find(class_fun_pair.first);
-                        if (it == class_test_map.end())
-                        {
-                            continue;
-                        }
-                        std::unordered_set<std::string> tests = it->second;
-                        auto it_test = tests.find(fun);
-                        if (it_test != tests.end())
-                        {
-                            // errs() << "Virtual call is used: " << caller->getName() << ", " << callee->getName() << '\n';
-                            add_call_dependency(caller, callee);
-                            continue;
-                        }
-                        // errs() << "Virtual call is unused: " << caller->getName() << ", " << callee->getName() << '\n';
+                        add_test_dependency(candidate_calls[i].first, candidate_calls[i].second, test_id);
                     }
                 }
+                else
+                {
+                    add_call_dependency(candidate_calls[i].first, candidate_calls[i].second);
+                }
             }
         }
-        
-
-        // for (auto & p : class_test_map)
-        // {
-        //     errs() << p.first << ": ";
-        //     for (auto & s : p.second)
-        //     {
-        //         errs() << s << ", ";
-        //     }
-        //     errs() << '\n';
-        // }
-
-
         else
         {
             for (auto & p : virtual_calls)
@@ -640,12 +684,66 @@ public:
                 add_call_dependency(caller, callee);
             }
         }
-        // Remove duplicate virtual calls
-        new_depgraph.remove_duplicates();
+        // The new graph is complete, so condense it for the traversals below
+        timer_depgraph.start();
+        new_depgraph.condense();
+        if (opt_test_index)
+        {
+            new_test_index.build(new_depgraph.get_condensed_graph(), ekstazi::gtest::GtestAdapter::is_test_from_bc);
+        }
+        if (opt_test_digests)
+        {
+            new_test_digests.build(new_depgraph.get_condensed_graph(), new_functions, ekstazi::gtest::GtestAdapter::is_test_from_bc);
+        }
+        timer_depgraph.stop();
 
-        // Save the old and new metadata
-        new_depgraph.save_file(new_depgraph_fname);
-        old_depgraph.save_file(old_depgraph_fname);
+        // Save the new metadata. The old dependency graph was only renamed
+        // and never modified, so it does not need to be written again.
+        if (opt_depgraph_log)
+        {
+            uint32_t num_changes = depgraph_log.append(old_depgraph, new_depgraph);
+            errs() << "Logged " << num_changes << " dependency graph changes\n";
+            if (depgraph_log.should_compact(opt_depgraph_log_generations))
+            {
+                depgraph_log.compact(old_depgraph, new_depgraph, opt_binary_depgraph);
+            }
+        }
+        else if (opt_binary_depgraph)
+        {
+            new_depgraph.save_binary_file(new_depgraph_fname);
+        }
+        else
+        {
+            new_depgraph.save_file(new_depgraph_fname);
+        }
+
+        // Remove the graphs of the other format, so the analyzers do not
+        // pick up a graph from an earlier run
+        std::string const & other_basename = opt_binary_depgraph ? ekstazi::DEPGRAPH_FNAME : ekstazi::DEPGRAPH_IMAGE_FNAME;
+        std::string const other_depgraph_fname = ekstazi::EKSTAZI_DIRNAME + '/' + module_name + '.' + other_basename;
+        std::remove(other_depgraph_fname.c_str());
+        std::remove((other_depgraph_fname + '.' + ekstazi::OLD_SUFFIX).c_str());
+
+        // Likewise a log left by an earlier run with -depgraph-log, which
+        // the analyzers would replay over the saved graph
+        if (!opt_depgraph_log)
+        {
+            std::string const depgraph_log_fname = ekstazi::EKSTAZI_DIRNAME + '/' + module_name + '.' + ekstazi::DEPGRAPH_LOG_FNAME;
+            std::remove(depgraph_log_fname.c_str());
+        }
+
+        if (opt_test_index)
+        {
+            new_test_index.save_file(new_test_index_fname);
+        }
+        if (opt_test_digests)
+        {
+            new_test_digests.save_file(new_test_digests_fname);
+        }
+        if (opt_block_changes)
+        {
+            ekstazi::DispatchSummary::save_file(new_dispatchers, new_dispatchers_fname);
+        }
 
         ekstazi::Function::save_file(new_functions, new_functions_fname);
         ekstazi::Function::save_file(old_functions, old_functions_fname);
@@ -656,7 +754,7 @@ public:
 
         errs() << "Finding modified functions..." << '\n';
         // Save the directly modified functions temporarily
-        std::unordered_set<std::string> directly_modified_functions = ekstazi::Function::get_modified_functions(old_functions, new_functions);
+        std::unordered_set<ekstazi::symbol_id> directly_modified_functions = ekstazi::Function::get_modified_functions(old_functions, new_functions);
         
         // errs() << "Directly Modified Functions: " << '\n';
         // for (std::string const & f : directly_modified_functions)
@@ -666,34 +764,83 @@ public:
 
         // Now search through the graph to find connected nodes
         // Insert all traversed nodes into our set of modified functions
+        // All directly modified functions are traversed at once.
         errs() << "Looking for changes in dependency graph..." << '\n';
-        for (std::string const & f : directly_modified_functions)
+        std::vector<ekstazi::symbol_id> modified_starts{ directly_modified_functions.begin(), directly_modified_functions.end() };
+        modified_functions.insert(modified_starts.begin(), modified_starts.end());
+
+        if (opt_block_changes && !opt_test_digests)
         {
-            modified_functions.insert(f);
             timer_depgraph.start();
-            std::unordered_set<std::string> dependents = old_depgraph.get_all_dependents(f);
+            uint32_t num_narrowed = narrow_dispatcher_changes(modified_starts);
             timer_depgraph.stop();
-            modified_functions.insert(dependents.begin(), dependents.end());
+            errs() << "Narrowed the changes of " << num_narrowed << " dispatchers to their affected callers" << '\n';
+        }
 
-            dependents = new_depgraph.get_all_dependents(f);
+        if (opt_test_digests)
+        {
+            // A test's digest covers everything it reaches, so the tests
+            // whose digest changed are exactly the affected tests.
             timer_depgraph.start();
-            modified_functions.insert(dependents.begin(), dependents.end());
+            std::vector<ekstazi::symbol_id> tests = new_test_digests.get_changed_tests(old_test_digests);
             timer_depgraph.stop();
+            selected_tests.insert(tests.begin(), tests.end());
+        }
+        else if (opt_test_index)
+        {
+            // Only the reached tests are needed to select tests, and the
+            // indexes already know which tests reach every function.
+            timer_depgraph.start();
+            std::unordered_set<ekstazi::symbol_id> tests = old_test_index.get_tests(modified_starts);
+            selected_tests.insert(tests.begin(), tests.end());
+            tests = new_test_index.get_tests(modified_starts);
+            selected_tests.insert(tests.begin(), tests.end());
+            timer_depgraph.stop();
+        }
+        else
+        {
+            // Traverse the old and new graphs together
+            timer_depgraph.start();
+            ekstazi::DepgraphUnion depgraph_union{ old_depgraph.get_frozen_graph(), new_depgraph.get_frozen_graph() };
+            depgraph_union.set_thread_pool(thread_pool.get());
+            std::vector<ekstazi::symbol_id> dependents;
+            depgraph_union.get_all_dependents(modified_starts, dependents);
+            timer_depgraph.stop();
+            modified_functions.insert(dependents.begin(), dependents.end());
         }
         // errs() << "Propagated Changes: " << '\n';
         // for (std::string const & f : modified_functions)
         // {
         //     errs() << f << '\n';
         // }
+        std::unordered_set<std::string> modified_function_names;
         std::ofstream ofs{ modified_functions_fname };
-        for (std::string const & f : modified_functions)
+        for (ekstazi::symbol_id f : modified_functions)
         {
-            ofs << f << std::endl;
+            ofs << symbols.name(f) << std::endl;
+            modified_function_names.insert(symbols.name(f));
         }
         ofs.close();
 
+        // The selected tests are saved apart, so the modified functions file only ever
+        // holds modified functions
+        if (opt_test_index || opt_test_digests)
+        {
+            ofs = std::ofstream{ selected_tests_fname };
+            for (ekstazi::symbol_id t : selected_tests)
+            {
+                ofs << symbols.name(t) << std::endl;
+                modified_function_names.insert(symbols.name(t));
+            }
+            ofs.close();
+        }
+        else
+        {
+            std::remove(selected_tests_fname.c_str());
+        }
+
         // Now we need to filter out the test functions.
-        modified_tests = gtest_adapter.get_modified_filters(modified_functions);
+        modified_tests = gtest_adapter.get_modified_filters(modified_function_names);
 
         errs() << "Modified Test Size: " << modified_tests.size() << '\n';
 
@@ -717,6 +864,7 @@ public:
         errs() << "Time for finalization: " << timer_finalization.get_total_elapsed_time() << " ms\n";
 
         errs() << "Total time spent in function hashing: " << timer_hash.get_total_elapsed_time() << " ms\n";
+        errs() << "Global variable digests cached: " << global_digests.size() << '\n';
         errs() << "Total time spent in depgraph traversal: " << timer_depgraph.get_total_elapsed_time() << " ms\n";
         return false;
     }
@@ -724,11 +872,64 @@ public:
 protected:
     std::string compute_checksum(Function* f)
     {
+        auto it = function_hash_indices.find(f);
+        if (it != function_hash_indices.end())
+        {
+            return function_hashes[it->second].to_string();
+        }
+
         timer_hash.start();
-        FunctionComparator::FunctionHash hash = ekstazi::FunctionComparator::functionHash(*f);
+        ekstazi::FunctionComparator::FunctionHash hash = ekstazi::FunctionComparator::functionHash(*f, &global_digests);
         timer_hash.stop();
         // errs() << "Finished computing checksum: " << hash << '\n';
-        return std::to_string(hash);
+        return hash.to_string();
+    }
+
+    /**
+     * Hashes all functions of the module that will be added to the function set on a
+     * thread pool. Hashing only reads the IR, so the functions are hashed concurrently.
+     *
+     * The functions are filtered up front, and every name the hash checks for gtest
+     * internals is demangled once, so the workers only take the demangle cache's
+     * shared lock and never contend on storing a name.
+     */
+    void hash_functions(Module & module)
+    {
+        timer_hash.start();
+        std::vector<Function*> functions;
+        for (Function & fun : module)
+        {
+            if (should_add_function(&fun))
+            {
+                function_hash_indices.insert({ &fun, functions.size() });
+                functions.push_back(&fun);
+            }
+            ekstazi::gtest::GtestAdapter::is_internal_function(ekstazi::to_string_view(fun.getName()));
+        }
+        for (GlobalVariable & gv : module.globals())
+        {
+            ekstazi::gtest::GtestAdapter::is_internal_function(ekstazi::to_string_view(gv.getName()));
+        }
+        function_hashes.resize(functions.size());
+
+        // Function sizes vary a lot, so the functions are submitted in small chunks
+        // that idle workers take from the shared queue, to balance the load
+        size_t const chunk_size = 64;
+        ekstazi::ThreadPool pool{ opt_hash_threads };
+        for (size_t begin = 0; begin < functions.size(); begin += chunk_size)
+        {
+            size_t end = std::min(functions.size(), begin + chunk_size);
+            pool.submit([this, &functions, begin, end]
+            {
+                for (size_t i = begin; i < end; ++i)
+                {
+                    function_hashes[i] = ekstazi::FunctionComparator::functionHash(*functions[i], &global_digests);
+                }
+            });
+        }
+        pool.wait();
+        timer_hash.stop();
+        errs() << "Hashed " << functions.size() << " functions on " << opt_hash_threads << " threads" << '\n';
     }
 
     void build_class_hierarchy(Module & module)
@@ -752,7 +953,7 @@ protected:
                 {
                     continue;
                 }
-                std::string type_name = ekstazi::demangle(vt_type_md_str->getString());
+                std::string type_name{ demangle(vt_type_md_str->getString()) };
                 // errs() << type_name << ',';
                 type_name = type_name.substr(std::string("typeinfo name for ").size());
 
@@ -765,7 +966,7 @@ protected:
                     {
                         continue;
                     }
-                    std::string super_type_name = ekstazi::demangle(super_type_md_str->getString());
+                    std::string super_type_name{ demangle(super_type_md_str->getString()) };
                     super_type_name = super_type_name.substr(std::string("typeinfo name for ").size());
                     new_type_hierarchy.add_inheritance_relationship(super_type_name, type_name);
                 }
@@ -773,10 +974,102 @@ protected:
 
             }
         }
-        new_type_hierarchy.remove_duplicates();
         new_type_hierarchy.save_file(new_type_hierarchy_fname);
     }
 
+    /**
+     * Add dependencies from a caller to all functions a virtual call may dispatch to.
+     */
+    void add_virtual_call(Function* caller, std::vector<Function*> const & callees)
+    {
+        for (Function* callee : callees)
+        {
+            add_to_function_set(callee);
+            if (should_add_function(caller) && should_add_function(callee))
+            {
+                std::pair<std::unordered_set<ekstazi::symbol_id>::iterator, bool> it = virtual_call_map[get_symbol(caller)].insert(get_symbol(callee));
+                if (it.second)
+                {
+                    virtual_calls.push_back({ caller, callee });
+                }
+            }
+        }
+    }
+
+    /**
+     * Get the type identifier of a type metadata operand, or an empty string if the
+     * type has internal linkage and thus no identifier.
+     */
+    static std::string get_type_id(Value* arg)
+    {
+        if (MetadataAsValue* mav = dyn_cast<MetadataAsValue>(arg))
+        {
+            if (MDString* md_str = dyn_cast<MDString>(mav->getMetadata()))
+            {
+                return md_str->getString().str();
+            }
+        }
+        return std::string{};
+    }
+
+    /**
+     * Find the llvm.type.test of a loaded vtable pointer, which clang emits before
+     * virtual calls with -fwhole-program-vtables, and get its type identifier. The test
+     * takes the vtable pointer cast to i8*.
+     */
+    static std::string find_type_test(Value* vtable)
+    {
+        std::vector<Value*> worklist{ vtable->stripPointerCasts() };
+        for (size_t i = 0; i < worklist.size(); ++i)
+        {
+            for (User* user : worklist[i]->users())
+            {
+                if (IntrinsicInst* ii = dyn_cast<IntrinsicInst>(user))
+                {
+                    if (ii->getIntrinsicID() == Intrinsic::type_test)
+                    {
+                        return get_type_id(ii->getArgOperand(1));
+                    }
+                }
+                else if (isa<BitCastInst>(user))
+                {
+                    worklist.push_back(user);
+                }
+            }
+        }
+        return std::string{};
+    }
+
+    /**
+     * Get the id of the class of the this parameter of a virtual function type, or
+     * SymbolTable::invalid_id if the type has no such parameter.
+     */
+    static ekstazi::symbol_id get_this_class_id(FunctionType* call_type)
+    {
+        if (!call_type || call_type->getNumParams() == 0)
+        {
+            return ekstazi::SymbolTable::invalid_id;
+        }
+
+        PointerType* this_type = dyn_cast<PointerType>(call_type->getParamType(0));
+        if (!this_type)
+        {
+            return ekstazi::SymbolTable::invalid_id;
+        }
+        // errs() << *(this_type->getPointerElementType()) << '\n';
+        StructType* class_type = dyn_cast<StructType>(this_type->getPointerElementType());
+        if (!class_type || !class_type->hasName())
+        {
+            return ekstazi::SymbolTable::invalid_id;
+        }
+
+        // strip 'class.' from name
+        std::string class_name = class_type->getStructName();
+        // errs() << "VTable class: " << class_name << '\n';
+        class_name.erase(0, std::string{"class."}.size());
+        return ekstazi::SymbolTable::instance().find(class_name);
+    }
+
     /**
      * Build the vtables for the module.
      */
@@ -788,7 +1081,7 @@ protected:
             {
                 std::shared_ptr<ekstazi::VTable> vtable = std::make_shared<ekstazi::VTable>();
                 vtable->add_entries(&gv);
-                vtables.insert({ vtable->get_name(), vtable });
+                vtables.insert({ ekstazi::SymbolTable::instance().intern(vtable->get_name()), vtable });
                 // vtables.add_vtable(&gv);
             }
         }
@@ -843,15 +1136,19 @@ protected:
         }
 
         // Don't add internal gtest functions
-        if (ekstazi::gtest::GtestAdapter::is_internal_function(fun->getName()))
+        if (ekstazi::gtest::GtestAdapter::is_internal_function(ekstazi::to_string_view(fun->getName())))
         {
             return false;
         }
- 
-        std::string const & fun_name = ekstazi::demangle(fun->getName().str());
 
-        if (fun_name.find("std::") != std::string::npos ||
-            fun_name.find("__gnu_cxx::") != std::string::npos)
+        // Don't add standard library functions
+        if (ekstazi::is_std_name(ekstazi::to_string_view(fun->getName())))
+        {
+            return false;
+        }
+
+        // Don't add functions excluded by the user
+        if (!symbol_rules.empty() && symbol_rules.is_excluded(demangle(fun->getName())))
         {
             return false;
         }
@@ -871,10 +1168,10 @@ protected:
             return;
         }
  
-        std::string const & fun_name = ekstazi::demangle(fun->getName().str());
+        ekstazi::symbol_id fun_id = get_symbol(fun);
 
         // Don't add duplicates
-        std::map<std::string, ekstazi::Function>::iterator it = new_functions.find(fun_name);
+        ekstazi::FunctionMap::iterator it = new_functions.find(fun_id);
         if (it != new_functions.end())
         {
             return;
@@ -882,18 +1179,223 @@ protected:
 
         std::string const & fun_fname = fun->getParent()->getSourceFileName();
         std::string fun_checksum = compute_checksum(fun);
-        ekstazi::Function fun_ekstazi{ fun_name, fun_fname, fun_checksum };
-        new_functions.insert({ fun_ekstazi.name(), fun_ekstazi });
+        ekstazi::Function fun_ekstazi{ fun_id, fun_fname, fun_checksum };
+        new_functions.insert({ fun_id, fun_ekstazi });
+
+        if (opt_block_changes)
+        {
+            timer_hash.start();
+            ekstazi::DispatchSummary summary = ekstazi::FunctionComparator::dispatchSummary(*fun, &global_digests);
+            timer_hash.stop();
+            if (!summary.empty())
+            {
+                new_dispatchers.insert({ fun_id, summary });
+                dispatcher_functions.insert({ fun_id, fun });
+            }
+        }
 
         // If the function is a constructor, add it to the constructor set
         if (ekstazi::Function::is_constructor(fun->getName()))
         {
             // std::pair<std::string, std::string> p = ekstazi::Function::split_class_name(fun->getName());
-            new_constructors.insert(fun_ekstazi.name());
+            new_constructors.insert(fun_id);
             // new_constructors.insert({ fun_ekstazi.name(), fun_ekstazi });
         }
     }
 
+    /**
+     * Replaces the modified dispatchers among the traversal starts by the callers they
+     * affect. A dispatcher qualifies if its entry block did not change and all its uses
+     * are direct calls. A direct caller is then affected only if one of its calls passes
+     * a non-constant argument, or a constant whose case changed. Any other dependent in
+     * the old or new graph, e.g. a caller that was removed, is always affected.
+     *
+     * The dispatchers stay in the modified functions but are not traversed from, while
+     * the affected callers are added to both.
+     *
+     * @return the number of dispatchers whose changes were narrowed.
+     */
+    uint32_t narrow_dispatcher_changes(std::vector<ekstazi::symbol_id> & modified_starts)
+    {
+        uint32_t num_narrowed = 0;
+        std::unordered_set<ekstazi::symbol_id> starts;
+        for (ekstazi::symbol_id fun_id : modified_starts)
+        {
+            auto old_it = old_dispatchers.find(fun_id);
+            auto new_it = new_dispatchers.find(fun_id);
+            if (old_it == old_dispatchers.end() || new_it == new_dispatchers.end() ||
+                old_it->second.entry() != new_it->second.entry())
+            {
+                starts.insert(fun_id);
+                continue;
+            }
+
+            ekstazi::DispatchSummary const & old_summary = old_it->second;
+            ekstazi::DispatchSummary const & new_summary = new_it->second;
+            Function* fun = dispatcher_functions[fun_id];
+
+            // Check the argument at every call site
+            bool only_direct_calls = !fun->hasAddressTaken();
+            std::unordered_set<ekstazi::symbol_id> direct_callers;
+            std::unordered_set<ekstazi::symbol_id> affected_callers;
+            for (User* user : fun->users())
+            {
+                if (!only_direct_calls)
+                {
+                    break;
+                }
+
+                Value* arg = nullptr;
+                if (CallInst* call_inst = dyn_cast<CallInst>(user))
+                {
+                    only_direct_calls = call_inst->getCalledFunction() == fun;
+                    arg = call_inst->getArgOperand(new_summary.arg_no());
+                }
+                else if (InvokeInst* invoke_inst = dyn_cast<InvokeInst>(user))
+                {
+                    only_direct_calls = invoke_inst->getCalledFunction() == fun;
+                    arg = invoke_inst->getArgOperand(new_summary.arg_no());
+                }
+                else
+                {
+                    only_direct_calls = false;
+                    break;
+                }
+
+                Function* caller = cast<Instruction>(user)->getFunction();
+                if (!should_add_function(caller))
+                {
+                    continue;
+                }
+
+                ekstazi::symbol_id caller_id = get_symbol(caller);
+                direct_callers.insert(caller_id);
+                ConstantInt* value = dyn_cast<ConstantInt>(arg);
+                if (value == nullptr || !new_summary.same_case(old_summary, value->getZExtValue()))
+                {
+                    affected_callers.insert(caller_id);
+                }
+            }
+
+            if (!only_direct_calls)
+            {
+                starts.insert(fun_id);
+                continue;
+            }
+
+            for (ekstazi::CsrGraph const * graph : { &old_depgraph.get_frozen_graph(), &new_depgraph.get_frozen_graph() })
+            {
+                uint32_t index = graph->index_of(fun_id);
+                if (index == ekstazi::CsrGraph::invalid_index)
+                {
+                    continue;
+                }
+
+                for (uint32_t i = graph->begin(index); i < graph->begin(index + 1); ++i)
+                {
+                    ekstazi::symbol_id dependent = graph->symbol_of(graph->edges()[i]);
+                    if (direct_callers.count(dependent) == 0 || affected_callers.count(dependent) > 0)
+                    {
+                        starts.insert(dependent);
+                        modified_functions.insert(dependent);
+                    }
+                }
+            }
+            ++num_narrowed;
+        }
+
+        modified_starts.assign(starts.begin(), starts.end());
+        return num_narrowed;
+    }
+
+    /**
+     * Computes a hash of the direct callees of a function from their GUIDs, without
+     * demangling them. The order of the calls does not matter.
+     */
+    static uint64_t compute_callee_hash(CallGraphNode* cgn)
+    {
+        uint64_t hash = 0;
+        for (CallGraphNode::CallRecord const & cr : *cgn)
+        {
+            Function* callee = cr.second->getFunction();
+            if (callee != nullptr && !callee->isDeclaration())
+            {
+                // Mix every GUID before adding it, so similar GUIDs do not cancel out
+                uint64_t guid = callee->getGUID() * uint64_t{ 0x9E3779B97F4A7C15 };
+                hash += guid ^ (guid >> 32);
+            }
+        }
+        return hash;
+    }
+
+    /**
+     * Returns the callee signature of a function: the hash of its callees, the number of
+     * its dependencies and the digest of the symbol rules, as "hash:count:rules". The
+     * rules decide which callees become dependencies, so changing them invalidates the
+     * signatures of all functions.
+     */
+    std::string get_callee_signature(uint64_t callee_hash, size_t num_dependencies) const
+    {
+        return std::to_string(callee_hash) + ':' + std::to_string(num_dependencies) + ':' + symbol_rules_digest;
+    }
+
+    /**
+     * Records the callee signature of a function whose direct dependencies were added.
+     */
+    void record_callee_signature(Function* caller, uint64_t callee_hash)
+    {
+        if (!should_add_function(caller))
+        {
+            return;
+        }
+
+        ekstazi::symbol_id caller_id = get_symbol(caller);
+        ekstazi::AdjacencyList const & dependencies = new_depgraph.get_reverse_adjacency_list();
+        auto it = dependencies.find(caller_id);
+        size_t num_dependencies = it == dependencies.end() ? 0 : it->second.size();
+        new_functions.at(caller_id).set_callee_signature(get_callee_signature(callee_hash, num_dependencies));
+    }
+
+    /**
+     * Copies the direct dependencies of a function from the old graph, if its checksum and
+     * callee signature did not change. The dependencies are only reused if the old graph has
+     * exactly as many as recorded: functions that also got virtual call or test dependencies
+     * in the last run are extracted again, so those are decided anew.
+     *
+     * @return true if the dependencies were reused.
+     */
+    bool reuse_call_dependencies(Function* caller, uint64_t callee_hash)
+    {
+        if (!should_add_function(caller))
+        {
+            return false;
+        }
+
+        ekstazi::symbol_id caller_id = get_symbol(caller);
+        ekstazi::FunctionMap::const_iterator old_it = old_functions.find(caller_id);
+        if (old_it == old_functions.end() || old_it->second.checksum() != new_functions.at(caller_id).checksum())
+        {
+            return false;
+        }
+
+        ekstazi::AdjacencyList const & old_dependencies = old_depgraph.get_reverse_adjacency_list();
+        auto it = old_dependencies.find(caller_id);
+        size_t num_dependencies = it == old_dependencies.end() ? 0 : it->second.size();
+        if (old_it->second.callee_signature() != get_callee_signature(callee_hash, num_dependencies))
+        {
+            return false;
+        }
+
+        if (it != old_dependencies.end())
+        {
+            for (ekstazi::symbol_id callee_id : it->second)
+            {
+                new_depgraph.add_dependency(callee_id, caller_id);
+            }
+        }
+        return true;
+    }
+
     /**
      * Adds a dependency to the ekstazi dependency graph.
      * 
@@ -910,13 +1412,49 @@ protected:
         }
 
         // Add the dependency to the dependency graph
-        std::string const caller_name = ekstazi::demangle(caller->getName().str());
-        std::string const callee_name = ekstazi::demangle(callee->getName().str());
+        new_depgraph.add_dependency(get_symbol(callee), get_symbol(caller));
+    }
 
-        // if (caller_name.find("TestBody") != std::string::npos)
-        //     errs() << caller_name << ", " << callee_name << '\n';
-        
-        new_depgraph.add_dependency(callee_name, caller_name);
+    /**
+     * Add a dependency from a test to the callee of a virtual call it may dispatch.
+     */
+    void add_test_dependency(Function* caller, Function* callee, ekstazi::symbol_id test_id)
+    {
+        // Only handle functions in this module
+        if (!should_add_function(caller) || !should_add_function(callee))
+        {
+            return;
+        }
+
+        ekstazi::symbol_id callee_id = get_symbol(callee);
+        if (callee_id != test_id)
+        {
+            new_depgraph.add_dependency(callee_id, test_id);
+        }
+    }
+
+    /**
+     * Returns the symbol id of a function. Functions are looked up by their
+     * GUID first, so each function is only demangled the first time it is seen.
+     */
+    ekstazi::symbol_id get_symbol(Function* fun)
+    {
+        ekstazi::SymbolTable & symbols = ekstazi::SymbolTable::instance();
+        ekstazi::symbol_id id = symbols.find_guid(fun->getGUID());
+        if (id != ekstazi::SymbolTable::invalid_id)
+        {
+            return id;
+        }
+        return symbols.intern(fun->getGUID(), std::string{ demangle(fun->getName()) });
+    }
+
+    /**
+     * Returns the demangled name of an IR name through the process-wide
+     * demangle cache, without copying the name first.
+     */
+    std::string_view demangle(StringRef name)
+    {
+        return ekstazi::demangle(ekstazi::to_string_view(name));
     }
     
 }; // end of struct Filename
@@ -30,9 +30,6 @@
 #include <chrono>
 #include <memory>
 
-// Hash checksum implementation
-#include "sha512.h"
-
 #include "ekstazi/constants.hh"
 
 #include "ekstazi/depgraph/depgraph.hh"
@@ -85,10 +82,10 @@ protected:
 
     // Set of Functions
     std::string old_functions_fname;
-    std::map<std::string, ekstazi::Function> old_functions;
+    ekstazi::FunctionMap old_functions;
 
     std::string new_functions_fname;
-    std::map<std::string, ekstazi::Function> new_functions;
+    ekstazi::FunctionMap new_functions;
 
     // Set of Constructors
     std::string old_constructors_fname;
@@ -196,10 +193,10 @@ public:
         ifs.close();
 
         new_functions_fname = ekstazi::EKSTAZI_DIRNAME + '/' + module_name + '.' + ekstazi::FUNCTIONS_FNAME;
-        new_functions = std::map<std::string, ekstazi::Function>{};
+        new_functions = ekstazi::FunctionMap{};
 
         old_functions_fname = new_functions_fname + '.' + ekstazi::OLD_SUFFIX;
-        old_functions = std::map<std::string, ekstazi::Function>{};
+        old_functions = ekstazi::FunctionMap{};
 
         // Check for existing function checksums file
         ifs = std::ifstream{ new_functions_fname };
@@ -475,7 +472,7 @@ public:
 
         errs() << "Finding modified functions..." << '\n';
         // Save the directly modified functions temporarily
-        std::unordered_set<std::string> directly_modified_functions = ekstazi::Function::get_modified_functions(old_functions, new_functions);
+        std::unordered_set<ekstazi::symbol_id> directly_modified_functions = ekstazi::Function::get_modified_functions(old_functions, new_functions);
         
         // errs() << "Directly Modified Functions: " << '\n';
         // for (std::string const & f : directly_modified_functions)
@@ -486,8 +483,9 @@ public:
         // Now search through the graph to find connected nodes
         // Insert all traversed nodes into our set of modified functions
         errs() << "Looking for changes in dependency graph..." << '\n';
-        for (std::string const & f : directly_modified_functions)
+        for (ekstazi::symbol_id f_id : directly_modified_functions)
         {
+            std::string const & f = ekstazi::SymbolTable::instance().name(f_id);
             modified_functions.insert(f);
             std::unordered_set<std::string> dependents = old_depgraph.get_all_dependents(f);
             modified_functions.insert(dependents.begin(), dependents.end());
@@ -530,9 +528,9 @@ public:
 protected:
     std::string compute_checksum(Function* f)
     {
-        FunctionComparator::FunctionHash hash = ekstazi::FunctionComparator::functionHash(*f);
+        ekstazi::FunctionComparator::FunctionHash hash = ekstazi::FunctionComparator::functionHash(*f);
         // errs() << "Finished computing checksum: " << hash << '\n';
-        return std::to_string(hash);
+        return hash.to_string();
     }
 
     void build_class_hierarchy(Module & module)
@@ -651,7 +649,7 @@ protected:
         std::string const & fun_fname = fun->getParent()->getSourceFileName();
         std::string fun_checksum = compute_checksum(fun);
         ekstazi::Function fun_ekstazi{ fun_name, fun_fname, fun_checksum };
-        new_functions.insert({ fun_ekstazi.name(), fun_ekstazi });
+        new_functions.insert({ fun_ekstazi.id(), fun_ekstazi });
 
         // If the function is a constructor, add it to the constructor set
         if (ekstazi::Function::is_constructor(fun->getName()))
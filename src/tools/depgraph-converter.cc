@@ -0,0 +1,53 @@
+
+#include "ekstazi/depgraph/depgraph.hh"
+#include "ekstazi/depgraph/depgraph-image.hh"
+
+#include <string>
+#include <fstream>
+#include <iostream>
+
+using namespace ekstazi;
+
+/**
+ * Converts a dependency graph between the text format and the binary
+ * image format. The output format is the opposite of the input format.
+ */
+int main(int argc, char** argv)
+{
+    if (argc != 3)
+    {
+        std::cerr << "Incorrect number of inputs. Expected 2 but got " << argc - 1 << std::endl;
+        std::cerr << "Usage: " << argv[0] << " <input depgraph> <output depgraph>" << std::endl;
+        exit(1);
+    }
+    std::string input_fname = argv[1];
+    std::string output_fname = argv[2];
+
+    std::ifstream ifs{input_fname};
+    if (!ifs)
+    {
+        std::cerr << "File not found: " << input_fname << std::endl;
+        exit(1);
+    }
+    ifs.close();
+
+    DependencyGraph depgraph{};
+    if (DepgraphImage::is_image(input_fname))
+    {
+        if (!depgraph.load_binary_file(input_fname))
+        {
+            std::cerr << "Invalid dependency graph image: " << input_fname << std::endl;
+            exit(1);
+        }
+        depgraph.save_file(output_fname);
+    }
+    else
+    {
+        depgraph.load_file(input_fname);
+        if (!depgraph.save_binary_file(output_fname))
+        {
+            std::cerr << "Could not write dependency graph image: " << output_fname << std::endl;
+            exit(1);
+        }
+    }
+}
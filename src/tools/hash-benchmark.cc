@@ -0,0 +1,131 @@
+#include "ekstazi/utils/hash-policy.hh"
+
+#include <string>
+#include <vector>
+#include <chrono>
+#include <random>
+#include <iostream>
+#include <iomanip>
+
+using namespace ekstazi;
+
+namespace
+{
+
+/**
+ * Input resembling what a function hash is fed: runs of small words
+ * (opcodes and integer constants) and byte strings of a given size
+ * (constant arrays and strings).
+ */
+struct Workload
+{
+    std::string name;
+    std::vector<uint64_t> words;
+    std::vector<std::string> strings;
+    uint32_t words_per_string;
+};
+
+Workload make_workload(std::string const & name, size_t num_words, size_t num_strings, size_t string_size)
+{
+    std::mt19937_64 rng{ 42 };
+    Workload workload{ name, {}, {}, 0 };
+    for (size_t i = 0; i < num_words; ++i)
+    {
+        workload.words.push_back(rng() % 512);
+    }
+    for (size_t i = 0; i < num_strings; ++i)
+    {
+        std::string s(string_size, '\0');
+        for (char & c : s)
+        {
+            c = static_cast<char>(rng());
+        }
+        workload.strings.push_back(s);
+    }
+    workload.words_per_string = num_strings == 0 ? 0 : num_words / num_strings;
+    return workload;
+}
+
+/**
+ * Hashes the workload with a policy until the minimum time has passed.
+ *
+ * @return the throughput in MB/s.
+ */
+template <typename HashPolicy>
+double run(Workload const & workload, Hash128 & hash)
+{
+    size_t bytes = workload.words.size() * sizeof(uint64_t);
+    for (std::string const & s : workload.strings)
+    {
+        bytes += s.size();
+    }
+
+    auto const min_duration = std::chrono::milliseconds{ 200 };
+    auto start = std::chrono::steady_clock::now();
+    auto elapsed = std::chrono::steady_clock::duration::zero();
+    size_t iterations = 0;
+    while (elapsed < min_duration)
+    {
+        HashPolicy policy{};
+        size_t next_string = 0;
+        for (size_t i = 0; i < workload.words.size(); ++i)
+        {
+            policy.add_word(workload.words[i]);
+            if (workload.words_per_string != 0 && (i + 1) % workload.words_per_string == 0 &&
+                next_string < workload.strings.size())
+            {
+                std::string const & s = workload.strings[next_string++];
+                policy.add_bytes(s.data(), s.size());
+            }
+        }
+        for (; next_string < workload.strings.size(); ++next_string)
+        {
+            std::string const & s = workload.strings[next_string];
+            policy.add_bytes(s.data(), s.size());
+        }
+        hash = policy.finish();
+
+        ++iterations;
+        elapsed = std::chrono::steady_clock::now() - start;
+    }
+
+    double seconds = std::chrono::duration<double>(elapsed).count();
+    return bytes * iterations / seconds / (1024 * 1024);
+}
+
+}
+
+/**
+ * Compares the throughput of the hash policies of the function hash.
+ */
+int main(int argc, char** argv)
+{
+    if (argc != 1)
+    {
+        std::cerr << "Usage: " << argv[0] << std::endl;
+        exit(1);
+    }
+
+    std::vector<Workload> workloads{
+        make_workload("small function", 64, 0, 0),
+        make_workload("large function", 16384, 0, 0),
+        make_workload("short strings", 4096, 256, 16),
+        make_workload("long strings", 4096, 64, 1024),
+        make_workload("constant table", 16, 1, 1 << 20),
+    };
+
+    std::cout << std::left << std::setw(20) << "workload"
+              << std::right << std::setw(16) << "mix64 MB/s"
+              << std::setw(16) << "xxh128 MB/s" << std::endl;
+    for (Workload const & workload : workloads)
+    {
+        Hash128 mix64_hash;
+        Hash128 xxh128_hash;
+        double mix64 = run<Mix64HashPolicy>(workload, mix64_hash);
+        double xxh128 = run<Xxh128HashPolicy>(workload, xxh128_hash);
+        std::cout << std::left << std::setw(20) << workload.name
+                  << std::right << std::fixed << std::setprecision(1)
+                  << std::setw(16) << mix64
+                  << std::setw(16) << xxh128 << std::endl;
+    }
+}
@@ -12,6 +12,7 @@
 
 #include "ekstazi/constants.hh"
 #include "ekstazi/depgraph/depgraph.hh"
+#include "ekstazi/depgraph/depgraph-log.hh"
 #include "ekstazi/depgraph/function.hh"
 #include "ekstazi/type-hierarchy/type-hierarchy.hh"
 #include "ekstazi/test-frameworks/gtest/gtest-adapter.hh"
@@ -44,8 +45,25 @@ public:
     void analyze_results()
     {
         // Load metadata first
-        m_old_degraph.load_file(m_ekstazi_dir + '/' + m_module_name + '.' + DEPGRAPH_FNAME + '.' + OLD_SUFFIX);
-        m_new_degraph.load_file(m_ekstazi_dir + '/' + m_module_name + '.' + DEPGRAPH_FNAME);
+        // Prefer the binary image if the pass was run with -binary-depgraph
+        std::string depgraph_fname = m_ekstazi_dir + '/' + m_module_name + '.' + DEPGRAPH_IMAGE_FNAME;
+        if (!std::ifstream{ depgraph_fname })
+        {
+            depgraph_fname = m_ekstazi_dir + '/' + m_module_name + '.' + DEPGRAPH_FNAME;
+        }
+
+        // With -depgraph-log the file above is only the base snapshot, and
+        // both graphs are rebuilt from it and the log
+        std::string depgraph_log_fname = m_ekstazi_dir + '/' + m_module_name + '.' + DEPGRAPH_LOG_FNAME;
+        if (std::ifstream{ depgraph_log_fname })
+        {
+            DepgraphLog{ depgraph_fname, depgraph_log_fname }.load(m_old_degraph, m_new_degraph);
+        }
+        else
+        {
+            m_old_degraph.load_file(depgraph_fname + '.' + OLD_SUFFIX);
+            m_new_degraph.load_file(depgraph_fname);
+        }
         
         m_old_functions = Function::load_file(m_ekstazi_dir + '/' + m_module_name + '.' + FUNCTIONS_FNAME + '.' + OLD_SUFFIX);
         m_new_functions = Function::load_file(m_ekstazi_dir + '/' + m_module_name + '.' + FUNCTIONS_FNAME);
@@ -58,6 +76,15 @@ public:
             m_modified_functions.insert(line);
         }
         ifs.close();
+
+        // Tests selected through the test index or test digests are not in the modified functions
+        std::unordered_set<std::string> selected_tests;
+        ifs = std::ifstream{ m_ekstazi_dir + '/' + m_module_name + '.' + SELECTED_TESTS_FNAME };
+        while (std::getline(ifs, line))
+        {
+            selected_tests.insert(line);
+        }
+        ifs.close();
         
         m_old_type_hierarchy.load_file(m_ekstazi_dir + '/' + m_module_name + '.' + TYPE_HIERARCHY_FNAME + '.' + OLD_SUFFIX);
         m_new_type_hierarchy.load_file(m_ekstazi_dir + '/' + m_module_name + '.' + TYPE_HIERARCHY_FNAME);
@@ -67,10 +94,12 @@ public:
         // gtest_adapter.register_tests(new_functions);
 
         // Now we need to filter out the test functions.
-        std::unordered_map<std::string, std::shared_ptr<ekstazi::gtest::Test>> modified_tests = m_gtest_adapter.get_modified_tests(m_modified_functions);
+        std::unordered_set<std::string> modified_functions_fun{ m_modified_functions };
+        modified_functions_fun.insert(selected_tests.begin(), selected_tests.end());
+        std::unordered_map<std::string, std::shared_ptr<ekstazi::gtest::Test>> modified_tests = m_gtest_adapter.get_modified_tests(modified_functions_fun);
         std::cout << "num_tests_fun_test: " << modified_tests.size() << std::endl;
 
-        modified_tests = m_gtest_adapter.get_modified_tests_sel_case(m_modified_functions);
+        modified_tests = m_gtest_adapter.get_modified_tests_sel_case(modified_functions_fun);
         std::cout << "num_tests_fun_case: " << modified_tests.size() << std::endl;
 
         // Now use class-level modularity. We add all functions to m_modified_functions
@@ -94,22 +123,24 @@ public:
                 // If class name is a class, then add all functions belonging to class to the modified functions set.
                 for (auto & p : m_old_functions)
                 {
-                    if (p.first.find(class_name) != std::string::npos)
+                    if (p.second.name().find(class_name) != std::string::npos)
                     {
-                        modified_functions_class.insert(p.first);
+                        modified_functions_class.insert(p.second.name());
                     }
                 }
                 for (auto & p : m_new_functions)
                 {
-                    if (p.first.find(class_name) != std::string::npos)
+                    if (p.second.name().find(class_name) != std::string::npos)
                     {
-                        modified_functions_class.insert(p.first);
+                        modified_functions_class.insert(p.second.name());
                     }
                 }
             }
             
         }
 
+        modified_functions_class.insert(selected_tests.begin(), selected_tests.end());
+
         // std::cerr << m_modified_functions.size() << ", " << modified_functions_class.size() << std::endl;
 
         modified_tests = m_gtest_adapter.get_modified_tests(modified_functions_class);
@@ -136,8 +167,8 @@ protected:
     DependencyGraph m_old_degraph;
     DependencyGraph m_new_degraph;
 
-    std::map<std::string, Function> m_old_functions;
-    std::map<std::string, Function> m_new_functions;
+    FunctionMap m_old_functions;
+    FunctionMap m_new_functions;
     std::unordered_set<std::string> m_modified_functions;
 
     TypeHierarchy m_old_type_hierarchy;
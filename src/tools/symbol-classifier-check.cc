@@ -0,0 +1,244 @@
+/**
+ * Checks the classifiers that decide from a mangled name whether a symbol
+ * belongs to the standard library (is_std_name) or to googletest's
+ * internals (GtestAdapter::is_internal_function) against the demangling
+ * implementation they replace.
+ *
+ * The built-in table of mangled names is always checked, against both
+ * the expected classes and the demangling implementation. Any files
+ * given are read as lists of mangled names, one per line (e.g. the output
+ * of nm --just-symbols), and checked against the demangling
+ * implementation only. Names the demangler rejects are skipped, since the
+ * demangling implementation saw them as they are: the classifiers may
+ * still recognize them from their nested name.
+ *
+ * Usage: symbol-classifier-check [names-file...]
+ *
+ * Exits with a non-zero status on any mismatch.
+ */
+
+#include "ekstazi/utils/mangle.hh"
+#include "ekstazi/test-frameworks/gtest/gtest-adapter.hh"
+
+#include <string>
+#include <string_view>
+#include <iostream>
+#include <fstream>
+#include <cstdlib>
+#include <cxxabi.h>
+
+using namespace ekstazi;
+
+namespace
+{
+
+/**
+ * A mangled name with its expected classes.
+ */
+struct Case
+{
+    std::string_view name;
+    bool is_std;
+    bool is_internal;
+};
+
+/**
+ * Names that exercise every branch of the classifiers: the std prefixes
+ * and abbreviations, std types in parameters, names that only look like
+ * std, the testing:: members decided from the nested name, and function
+ * template specializations whose demangled form starts with a return type.
+ */
+Case const cases[] = {
+    // std::vector<int, std::allocator<int> >::push_back(int const&)
+    { "_ZNSt6vectorIiSaIiEE9push_backERKi", true, false },
+    // std::vector<int, std::allocator<int> >::size() const
+    { "_ZNKSt6vectorIiSaIiEE4sizeEv", true, false },
+    // std::remove_reference<int&>::type&& std::move<int&>(int&)
+    { "_ZSt4moveIRiEONSt16remove_referenceIT_E4typeEOS2_", true, false },
+    // std::basic_string<char, ...>::basic_string()
+    { "_ZNSsC1Ev", true, false },
+    // std::ostream::operator<<(int)
+    { "_ZNSolsEi", true, false },
+    // __gnu_cxx::new_allocator<int>::allocate(unsigned long, void const*)
+    { "_ZN9__gnu_cxx13new_allocatorIiE8allocateEmPKv", true, false },
+    // foo(std::vector<int, std::allocator<int> > const&)
+    { "_Z3fooRKSt6vectorIiSaIiEE", true, false },
+    // foo(std::string const&)
+    { "_Z3fooRKSs", true, false },
+    // mystd::foo(), which contains "std::" once demangled
+    { "_ZN5mystd3fooEv", true, false },
+    // foo::bar()
+    { "_ZN3foo3barEv", false, false },
+    // Parser::parse()
+    { "_ZN6Parser5parseEv", false, false },
+    // Test::Stdless(), which contains "St" but not "std::"
+    { "_ZN4Test7StdlessEv", false, false },
+    // work()
+    { "_Z4workv", false, false },
+    // Not a mangled name
+    { "main", false, false },
+
+    // testing::internal::UnitTestImpl::RunAllTests()
+    { "_ZN7testing8internal12UnitTestImpl11RunAllTestsEv", false, true },
+    // testing::internal::Format() const
+    { "_ZNK7testing8internal6FormatEv", false, true },
+    // testing::internal::TestFactoryImpl<FooTest_Bar_Test>::CreateTest()
+    { "_ZN7testing8internal15TestFactoryImplI16FooTest_Bar_TestE10CreateTestEv", false, true },
+    // testing::AssertionResult testing::internal::EqHelper::Compare<int, int>(...)
+    { "_ZN7testing8internal8EqHelper7CompareIiiEENS_15AssertionResultEPKcS5_RKT_RKT0_", false, true },
+    // testing::Message::Message()
+    { "_ZN7testing7MessageC1Ev", false, true },
+    // testing::Test::Run()
+    { "_ZN7testing4Test3RunEv", false, true },
+    // testing::TestPartResult::TestPartResult()
+    { "_ZN7testing14TestPartResultC2Ev", false, true },
+    // testing::UnitTest::GetInstance()
+    { "_ZN7testing8UnitTest11GetInstanceEv", false, true },
+    // testing::AssertionResult::AssertionResult(testing::AssertionResult const&)
+    { "_ZN7testing15AssertionResultC2ERKS0_", false, true },
+    // testing::AssertionResult::message() const
+    { "_ZNK7testing15AssertionResult7messageEv", false, true },
+    // testing::AssertionSuccess()
+    { "_ZN7testing16AssertionSuccessEv", false, true },
+    // testing::internal::EqMatcher<int> testing::Eq<int>(int)
+    { "_ZN7testing2EqIiEENS_8internal9EqMatcherIT_EES3_", false, true },
+    // testing::TestInfo* testing::Probe<int>(), internal only by its return type
+    { "_ZN7testing5ProbeIiEEPNS_8TestInfoEv", false, true },
+    // testing::Environment* testing::Probe<int>()
+    { "_ZN7testing5ProbeIiEEPNS_11EnvironmentEv", false, false },
+    // testing::Environment::SetUp()
+    { "_ZN7testing11Environment5SetUpEv", false, false },
+    // testing::Matcher<int>::Matcher(int)
+    { "_ZN7testing7MatcherIiEC2Ei", false, false },
+    // RunAllTests(testing::internal::UnitTestImpl*), not in namespace testing
+    { "_Z11RunAllTestsPN7testing8internal12UnitTestImplE", false, true },
+    // FooTest_Bar_Test::TestBody()
+    { "_ZN16FooTest_Bar_Test8TestBodyEv", false, false },
+};
+
+/**
+ * Demangles a name without going through the DemangleCache. If the name
+ * is rejected, the demangled name is the name itself.
+ *
+ * @return whether or not the name was demangled.
+ */
+bool demangle_uncached(std::string_view name, std::string & demangled)
+{
+    int status = 0;
+    std::string mangled{ name };
+    char * result = abi::__cxa_demangle(mangled.c_str(), nullptr, nullptr, &status);
+    if (status != 0 || result == nullptr)
+    {
+        demangled = mangled;
+        return false;
+    }
+
+    demangled = result;
+    std::free(result);
+    return true;
+}
+
+/**
+ * The demangling implementation of is_std_name.
+ */
+bool reference_is_std_name(std::string const & demangled)
+{
+    return demangled.find("std::") != std::string::npos ||
+           demangled.find("__gnu_cxx::") != std::string::npos;
+}
+
+/**
+ * The demangling implementation of GtestAdapter::is_internal_function.
+ */
+bool reference_is_internal_function(std::string const & demangled)
+{
+    return
+        demangled.find("testing::internal") != std::string::npos ||
+        demangled.find("testing::Assertion") == 0 ||
+        demangled.find("testing::Message") == 0 ||
+        demangled.find("testing::Test") == 0 ||
+        demangled.find("testing::UnitTest") == 0;
+}
+
+/**
+ * Reports a mismatch between two classifications of a name.
+ *
+ * @return whether or not they match.
+ */
+bool check(std::string_view name, std::string_view what, bool actual, bool expected)
+{
+    if (actual != expected)
+    {
+        std::cout << "Mismatch: " << what << '(' << name << ") is " << actual << ", expected " << expected << std::endl;
+        return false;
+    }
+    return true;
+}
+
+/**
+ * Checks both classifiers against the demangling implementation.
+ *
+ * @return whether or not all of them match.
+ */
+bool check_against_reference(std::string_view name, std::string const & demangled)
+{
+    bool ok = check(name, "is_std_name", is_std_name(name), reference_is_std_name(demangled));
+    return check(name, "is_internal_function", gtest::GtestAdapter::is_internal_function(name), reference_is_internal_function(demangled)) && ok;
+}
+
+}
+
+int main(int argc, char* argv[])
+{
+    size_t num_names = 0;
+    size_t num_rejected = 0;
+    size_t num_mismatches = 0;
+
+    for (Case const & c : cases)
+    {
+        std::string demangled;
+        demangle_uncached(c.name, demangled);
+        bool ok = check(c.name, "is_std_name", is_std_name(c.name), c.is_std);
+        ok = check(c.name, "is_internal_function", gtest::GtestAdapter::is_internal_function(c.name), c.is_internal) && ok;
+        ok = check(c.name, "reference is_std_name", reference_is_std_name(demangled), c.is_std) && ok;
+        ok = check(c.name, "reference is_internal_function", reference_is_internal_function(demangled), c.is_internal) && ok;
+        ++num_names;
+        num_mismatches += ok ? 0 : 1;
+    }
+
+    for (int i = 1; i < argc; ++i)
+    {
+        std::ifstream ifs{ argv[i] };
+        if (!ifs)
+        {
+            std::cerr << "Could not open " << argv[i] << std::endl;
+            return 1;
+        }
+
+        std::string line;
+        std::string demangled;
+        while (std::getline(ifs, line))
+        {
+            if (line.empty())
+            {
+                continue;
+            }
+            if (!demangle_uncached(line, demangled))
+            {
+                ++num_rejected;
+                continue;
+            }
+            ++num_names;
+            num_mismatches += check_against_reference(line, demangled) ? 0 : 1;
+        }
+    }
+
+    // The classifiers only demangle what they cannot decide, through the
+    // cache, so its size counts the names they could not decide
+    std::cout << "Names checked: " << num_names << std::endl;
+    std::cout << "Names rejected by the demangler: " << num_rejected << std::endl;
+    std::cout << "Names demangled by the classifiers: " << DemangleCache::instance().size() << std::endl;
+    std::cout << "Mismatches: " << num_mismatches << std::endl;
+
+    return num_mismatches == 0 ? 0 : 1;
+}